@@ -1,304 +1,4715 @@
+#define _POSIX_C_SOURCE 200809L
 #include "amount_set_str.h"
 #include <stdlib.h>
 #include <assert.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdio.h>
+#include <float.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#define AS_INDEX_INITIAL_CAPACITY 16
+#define AS_MAX_LEVEL 16
+#define AS_LEVEL_MASK 3
+#define AS_RANDOM_SEED 2463534242u
+#define AS_FNV_OFFSET_BASIS 2166136261u
+#define AS_FNV_PRIME 16777619u
+#define AS_ARENA_ALIGNMENT 8
+#define AS_ARENA_INITIAL_BLOCK_SIZE 4096
+#define AS_ARENA_MAX_BLOCK_SIZE (1 << 20)
+#define AS_ARENA_SIZE_CLASSES 128
+#define AS_PREFIX_WORDS 2
+#define AS_PREFIX_LENGTH (AS_PREFIX_WORDS * sizeof(uint64_t))
+#define AS_SCAN_UNROLL 4
+#define AS_SMALL_CAPACITY 16
+#define AS_SMALL_MIN_SIZE (AS_SMALL_CAPACITY / 2) // A larger store shrinks back to small at this size
+#define AS_SMALL_INITIAL_BLOB_SIZE 64
+#define AS_FILE_MAGIC "ASSNAPSH"
+#define AS_FILE_MAGIC_LENGTH 8
+#define AS_FILE_VERSION 1
+#define AS_FILE_BYTE_ORDER 0x01020304u
+#define AS_FNV64_OFFSET_BASIS 14695981039346656037ull
+#define AS_FNV64_PRIME 1099511628211ull
+#define AS_FILTER_BLOCK_WORDS 8 // 512 bits, a cache line
+#define AS_FILTER_BLOCK_BITS (AS_FILTER_BLOCK_WORDS * 64)
+#define AS_FILTER_BLOCK_SHIFT 23 // Keeps the top 9 bits of a 32-bit position, one of AS_FILTER_BLOCK_BITS
+#define AS_FILTER_MAX_HASHES 16
+#define AS_FILTER_MIN_CAPACITY 64
+#define AS_FILTER_DELETED_SHARE 4 // The filter is rebuilt once a quarter of its capacity was deleted
+#define AS_HANDLES_INITIAL_CAPACITY 16
+#define AS_STREAM_BUFFER_SIZE (1 << 20)
+#define AS_EXACT_DIGITS 15 // Decimal digits that always fit in a double's mantissa
+#define AS_EXACT_POWERS 23 // Powers of ten that are exact doubles, 1e0 to 1e22
+#define AS_FORMAT_MAX_DECIMALS 9
+#define AS_FORMAT_MAX_LENGTH 32 // Longest amount written, as by "%.17g"
+#define AS_MAX_THREADS 64
+#define AS_PARALLEL_MIN_RUN 4096 // Elements per thread below which sorts use fewer threads
+#define AS_PARALLEL_MIN_COPY (1 << 20) // Bytes per thread below which copies use a single thread
+#define AS_KEEP_FIRST_ONLY 1
+#define AS_KEEP_SECOND_ONLY 2
+#define AS_KEEP_BOTH 4
+
+// Counters of asGetStats, compiled in only with AS_STATS. Disabled counters still
+// evaluate (and discard) their value, so that local counts don't trigger warnings.
+#ifdef AS_STATS
+#define AS_STATS_ADD(store, counter, value) __atomic_add_fetch(&(store)->stats.counter, (value), __ATOMIC_RELAXED)
+#define AS_STATS_MAX(store, counter, value) asStatsMax(&(store)->stats.counter, (value))
+#else
+#define AS_STATS_ADD(store, counter, value) ((void)(value))
+#define AS_STATS_MAX(store, counter, value) ((void)(value))
+#endif
 
 typedef struct AmountSetNode_t *AmountSetNode;
 struct AmountSetNode_t
 {
-    double amount;
-    char *element;
-    AmountSetNode next;
-};
+    double amount;
+    uint64_t prefix[AS_PREFIX_WORDS]; // First characters of the element packed big-endian, zero padded,
+                                      // so comparing them as integers orders like strcmp
+    size_t length;
+    unsigned int hash;
+    int level;
+    unsigned int generation; // Raised when the node is freed, so that handles to it know their element is gone
+    AmountSetNode next[]; // Forward pointers of the skip list, next[0] is the sorted chain,
+                          // followed by the forward pointers and spans of the amount order
+                          // (see asNodeByAmount, asNodeSpans) and the element's characters
+};
+
+/** A chunk of memory nodes are carved from, blocks of a set are chained from the newest. **/
+typedef struct AmountSetBlock_t *AmountSetBlock;
+struct AmountSetBlock_t
+{
+    AmountSetBlock next;
+    size_t capacity;
+    size_t used;
+    double data[]; // double for alignment, holds nodes of any size
+};
+
+/**
+ * Node allocator owned by a set.
+ * Freed nodes are kept in free lists by size (in AS_ARENA_ALIGNMENT units) for reuse,
+ * nodes larger than the largest size class are only reclaimed when the set is cleared.
+ **/
+typedef struct AmountSetArena_t
+{
+    AmountSetBlock blocks;
+    size_t next_block_size;
+    AmountSetNode free_lists[AS_ARENA_SIZE_CLASSES];
+} AmountSetArena;
+
+/** A single slot of the open-addressing hash index. An empty slot has a NULL node. **/
+typedef struct AmountSetSlot_t
+{
+    unsigned int hash;
+    AmountSetNode node;
+} AmountSetSlot;
+
+/**
+ * Array representation of a frozen store (see asFreeze), or of a small store,
+ * in a single allocation.
+ * Element i is blob + offsets[i], offsets[size] is the blob's size.
+ * A small store is changed in place, its arrays have room for capacity elements
+ * and blob_capacity characters.
+ **/
+typedef struct AmountSetArray_t
+{
+    void *memory; // NULL if the store keeps its elements in nodes
+    size_t mapped_size; // Size of the file mapping at memory, 0 if memory was allocated
+    int capacity; // Number of elements a small store has room for, 0 if the store is frozen
+    size_t blob_capacity;
+    double *amounts;
+    uint64_t *offsets;
+    uint32_t *by_amount; // Positions of the elements in the amount order
+    char *blob;
+} AmountSetArray;
+
+/**
+ * The elements of a set and their indexes.
+ * A store is shared by a set and its copies until one of them changes, the
+ * changing set then gets a private copy of the store (copy-on-write).
+ * A frozen store keeps its elements in arrays, its skip lists and index are empty.
+ * A small store (up to AS_SMALL_CAPACITY elements) keeps them in arrays too, and
+ * has no skip lists, index or arena at all.
+ **/
+typedef struct AmountSetStore_t *AmountSetStore;
+/** Running aggregates of a store's amounts, kept up to date by every change. **/
+typedef struct AmountSetAggregate_t
+{
+    double total;
+    double compensation; // The low-order part of the total lost by its additions, see asAggregateAdd
+    int positive; // Elements whose amount is above 0
+} AmountSetAggregate;
+
+struct AmountSetStore_t
+{
+    int references; // Accessed atomically, copies may be used by other threads
+    int size;
+    int level;
+    unsigned int random_state;
+    AmountSetNode header;
+    AmountSetSlot *index;
+    int index_capacity;
+    int index_used;
+    AmountSetArena arena;
+    AmountSetArray array;
+    AmountSetNode finger[AS_MAX_LEVEL]; // Preceding nodes found by the last search for a change
+    long finger_hits;
+    long finger_misses;
+    unsigned long serial; // Unique among the stores, so that handles know which store they found their element in
+    long moves; // Elements of a small store shifted, handles find their element again after it changes
+    AmountSetAggregate aggregate;
+    AmountSetNode amount_last; // Last node of the amount order, the header if there are none
+#ifdef AS_STATS
+    AmountSetStats stats; // Accessed atomically, like references
+#endif
+};
+
+/** A recorded change, whose element is copied to a buffer reused by later changes. **/
+typedef struct AmountSetJournalEntry_t
+{
+    AmountSetChange change;
+    char *element;
+    size_t element_capacity;
+} AmountSetJournalEntry;
+
+/**
+ * Bounded log of a set's changes, see asEnableJournal.
+ * The change with sequence number s is kept in entries[s % capacity] until it is overwritten.
+ **/
+typedef struct AmountSetJournal_t *AmountSetJournal;
+struct AmountSetJournal_t
+{
+    AmountSetJournalEntry *entries;
+    int capacity;
+    long sequence; // Of the last change
+    long first_sequence; // Changes before it were dropped, even if they are still in entries
+};
+
+/**
+ * Blocked Bloom filter of a set's elements, see asEnableFilter.
+ * All the bits of an element are in a single block of a cache line. Deleted
+ * elements keep their bits until the filter is rebuilt.
+ **/
+typedef struct AmountSetFilter_t *AmountSetFilter;
+struct AmountSetFilter_t
+{
+    uint64_t *blocks; // block_count * AS_FILTER_BLOCK_WORDS words
+    size_t block_count;
+    int hashes; // Bits set for every element
+    double false_positive_rate;
+    int capacity; // Elements added before the filter is rebuilt larger
+    int added;
+    int deleted; // Elements deleted since the filter was built, their bits are still set
+    bool stale; // Elements were added without updating the filter, it may miss them
+};
+
+/**
+ * A set's reference to one of its elements, see asFindHandle.
+ * The element's node is kept while the store's serial and the node's generation
+ * stay the same, its position in an array store while the store's serial and
+ * moves do. Otherwise the element is found again by its copy.
+ **/
+struct AmountSetHandle_t
+{
+    AmountSet set;
+    AmountSetHandle next; // Next handle in the same chain of the set's handle table
+    char *element;
+    size_t length;
+    unsigned int hash;
+    unsigned long serial;
+    unsigned int generation; // Of the node
+    long moves; // Of an array store
+    AmountSetNode node; // NULL in an array store
+    int position;
+};
+
+struct AmountSet_t
+{
+    AmountSetStore store;
+    AmountSetNode current_node;
+    int current_position; // Internal iterator of a frozen store, -1 if undefined
+    AmountSetJournal journal; // NULL if changes aren't recorded
+    AmountSetFilter filter; // NULL if lookups aren't filtered
+    AmountSetHandle *handles; // Hash table of chains of handles by their element's hash, NULL if none were found
+    int handles_capacity; // Number of chains, a power of 2
+    int handles_count;
+};
+
+/** A position in a store of either representation, used to walk its elements in order. **/
+typedef struct AmountSetCursor_t
+{
+    AmountSetStore store;
+    AmountSetNode node;
+    int position;
+} AmountSetCursor;
+
+/** An element and its amount, used to sort input arrays. **/
+typedef struct AmountSetPair_t
+{
+    const char *element;
+    double amount;
+} AmountSetPair;
+
+/**
+ * Start of a binary snapshot file, followed by the arrays of a frozen store as
+ * laid out in memory (see asArrayLayout). The checksum covers everything after
+ * the header.
+ **/
+typedef struct AmountSetFileHeader_t
+{
+    char magic[AS_FILE_MAGIC_LENGTH];
+    uint32_t byte_order; // AS_FILE_BYTE_ORDER as written by the saving machine
+    uint32_t version;
+    uint64_t size;
+    uint64_t blob_size;
+    uint64_t checksum;
+} AmountSetFileHeader;
+
+/** Reads a stream in large blocks and splits them into lines, see asLoadStream. **/
+typedef struct AmountSetReader_t
+{
+    FILE *stream;
+    char *buffer;
+    size_t capacity;
+    size_t start; // The first byte not returned as a line yet
+    size_t end;   // The end of the bytes read into the buffer
+    bool finished;
+} AmountSetReader;
+
+/**
+ * A part of a parallel sort or copy, run by one thread: sorting a run in
+ * place, merging two adjacent runs of source into target, or copying bytes.
+ **/
+typedef struct AmountSetTask_t
+{
+    char *source;
+    char *target; // NULL to sort the first run of source in place
+    size_t first_count; // Elements of the first run, or bytes to copy if compare is NULL
+    size_t second_count;
+    size_t width;
+    int (*compare)(const void *, const void *);
+} AmountSetTask;
+
+/** A position in a frozen store and its amount, used to sort positions by amount. **/
+typedef struct AmountSetRanked_t
+{
+    double amount;
+    uint32_t position;
+} AmountSetRanked;
+
+/** Marks index slots whose node was deleted, so that probing continues past them. **/
+static struct AmountSetNode_t as_tombstone;
+#define AS_TOMBSTONE (&as_tombstone)
+
+/** Serial number of the last created store. **/
+static unsigned long as_store_serial;
+
+/**
+ * asStoreCreate: Allocates a new empty store, referenced once.
+ *
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new store otherwise.
+ * **/
+static AmountSetStore asStoreCreate();
+
+/**
+ * asStoreCreateSmall: Allocates a new empty small store, referenced once.
+ *
+ * @param blob_capacity The number of characters (including terminators) to make room for.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new store otherwise.
+ * **/
+static AmountSetStore asStoreCreateSmall(size_t blob_capacity);
+
+/**
+ * asStoreIsFrozen: Checks if a store is frozen.
+ *
+ * @param store The store to check.
+ * @return
+ *      true if the store is frozen, false if it keeps its elements in nodes or is small.
+ * **/
+static bool asStoreIsFrozen(AmountSetStore store);
+
+/**
+ * asStoreIsSmall: Checks if a store is small.
+ *
+ * @param store The store to check.
+ * @return
+ *      true if the store keeps its elements in changeable arrays.
+ * **/
+static bool asStoreIsSmall(AmountSetStore store);
+
+/**
+ * asCreateFromStore: Allocates a new set for a store.
+ *
+ * @param store The set's store, released if the allocation fails. May be NULL.
+ * @return
+ *      NULL - if store is NULL or an allocation failed.
+ *      The new set otherwise.
+ * **/
+static AmountSet asCreateFromStore(AmountSetStore store);
+
+/**
+ * asStoreClone: Creates a private copy of a store, referenced once.
+ *
+ * Runs in linear time, as the nodes are appended in their sorted order.
+ *
+ * @param store The store to copy.
+ * @param cursor A node of the store, replaced by the corresponding node of the
+ *      copy. May point to NULL.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new store otherwise.
+ * **/
+static AmountSetStore asStoreClone(AmountSetStore store, AmountSetNode *cursor);
+
+/**
+ * asStoreRelease: Drops a reference to a store, freeing it if it was the last one.
+ *
+ * @param store The store to release. If store is NULL nothing will be done.
+ * **/
+static void asStoreRelease(AmountSetStore store);
+
+/**
+ * asPrepareWrite: Makes sure a set's store is not shared before the set is changed.
+ *
+ * If the store is shared with copies of the set, the set gets a private copy
+ * of the store, and its iterator is moved to the copy.
+ *
+ * @param set The set about to be changed.
+ * @return
+ *      AS_OUT_OF_MEMORY - if copying the store failed, the set is unchanged.
+ *      AS_SUCCESS - if the set's store is private.
+ * **/
+static AmountSetResult asPrepareWrite(AmountSet set);
+
+/**
+ * asNodeSize: Returns the number of bytes a node takes in the arena.
+ *
+ * @param level The number of forward pointers of the node.
+ * @param length The length of the node's element.
+ * @return
+ *      The node's size, rounded up to AS_ARENA_ALIGNMENT.
+ * **/
+static size_t asNodeSize(int level, size_t length);
+
+/**
+ * asNodeElement: Returns the element stored inline at the end of a node.
+ *
+ * @param node The node whose element is requested.
+ * @return
+ *      The node's element, and not a copy of it.
+ * **/
+static char *asNodeElement(AmountSetNode node);
+
+/**
+ * asNodeByAmount: Returns the forward pointers of a node in the amount order.
+ *
+ * The amount order is a second skip list over the same nodes and levels,
+ * ordered by descending amount and then by element.
+ *
+ * @param node The node whose forward pointers are requested.
+ * @return
+ *      An array of the node's level forward pointers.
+ * **/
+static AmountSetNode *asNodeByAmount(AmountSetNode node);
+
+/**
+ * asNodeSpans: Returns the spans of a node's forward pointers in the amount order.
+ *
+ * The span of a level is the number of nodes its forward pointer skips over,
+ * including the node it points to. A NULL forward pointer spans to the last node.
+ *
+ * @param node The node whose spans are requested.
+ * @return
+ *      An array of the node's level spans.
+ * **/
+static int *asNodeSpans(AmountSetNode node);
+
+/**
+ * asCreateNode: Allocates a node from the store's arena and copies an element into it.
+ *
+ * The node's forward pointers are uninitialized and its amount is 0.
+ *
+ * @param store The store whose arena the node is allocated from.
+ * @param level The number of forward pointers of the node.
+ * @param element The element to store in the node.
+ * @param length The element's length.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new node otherwise.
+ * **/
+static AmountSetNode asCreateNode(AmountSetStore store, int level, const char *element, size_t length);
+
+/**
+ * asFreeNode: Frees a specific node's resources.
+ *
+ * The node's memory will be returned to the store's arena for reuse,
+ * Adjacent nodes and the set's pointer will be untouched.
+ *
+ * @param store - The store whose arena the node was allocated from.
+ * @param node - The AmountSetNode to be released.
+ *
+ *
+ * **/
+static void asFreeNode(AmountSetStore store, AmountSetNode node);
+
+/**
+ * asInsertNode: Adds a new node to the store at its sorted position.
+ *
+ * The element must not already be in the store.
+ *
+ * @param store The store to insert into.
+ * @param element The element to add.
+ * @param length The element's length.
+ * @param hash The element's hash, as returned by asHashElement.
+ * @param amount The element's initial amount.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the store is unchanged.
+ *      AS_SUCCESS - if the node was inserted.
+ * **/
+static AmountSetResult asInsertNode(AmountSetStore store, const char *element, size_t length,
+                                    unsigned int hash, double amount);
+
+/**
+ * asAppendNode: Adds a new node after the last node of the store.
+ *
+ * Used to build a set from elements that are already sorted, without searching.
+ * The element must be larger than all of the store's elements, and must not
+ * already be in the store. The node is left out of the amount order, see
+ * asAmountIndexBuild.
+ *
+ * @param store The store to append to.
+ * @param last_nodes An array of AS_MAX_LEVEL nodes holding the last node of every
+ *      level (the store's header for empty levels), updated by the function.
+ * @param element The element to add.
+ * @param length The element's length.
+ * @param hash The element's hash, as returned by asHashElement.
+ * @param amount The element's amount.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the store is unchanged.
+ *      AS_SUCCESS - if the node was appended.
+ * **/
+static AmountSetResult asAppendNode(AmountSetStore store, AmountSetNode *last_nodes, const char *element,
+                                    size_t length, unsigned int hash, double amount);
+
+/**
+ * asArenaAllocate: Allocates memory from a set's arena.
+ *
+ * Reuses a freed allocation of the same size if there is one, otherwise carves
+ * the memory from the newest block, chaining a new block if it is full.
+ *
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes to allocate, a multiple of AS_ARENA_ALIGNMENT.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The allocated memory otherwise.
+ * **/
+static void *asArenaAllocate(AmountSetArena *arena, size_t size);
+
+/**
+ * asHashElement: Computes the FNV-1a hash of an element, and its length.
+ *
+ * @param element The element to hash.
+ * @param out_length The variable to return the element's length in.
+ * @return
+ *      The hash of the element.
+ * **/
+static unsigned int asHashElement(const char *element, size_t *out_length);
+
+/**
+ * asIndexFind: Finds the node containing a specific element using the hash index.
+ *
+ * The iterator is untouched.
+ *
+ * @param store The store to search in.
+ * @param element The element to match.
+ * @param hash The element's hash, as returned by asHashElement.
+ * @param length The element's length.
+ * @return
+ *      NULL - if the element doesn't exist in the store.
+ *      The node containing the element otherwise.
+ * **/
+static AmountSetNode asIndexFind(AmountSetStore store, const char *element, unsigned int hash, size_t length);
+
+/**
+ * asIndexInsert: Adds a node to the hash index, growing the index if needed.
+ *
+ * @param store The store whose index is updated.
+ * @param node The node to add, must not already be in the index.
+ * @return
+ *      AS_OUT_OF_MEMORY - if growing the index failed, the index is unchanged.
+ *      AS_SUCCESS - if the node was added.
+ * **/
+static AmountSetResult asIndexInsert(AmountSetStore store, AmountSetNode node);
+
+/**
+ * asIndexRemove: Removes a node from the hash index, leaving a tombstone in its slot.
+ *
+ * @param store The store whose index is updated.
+ * @param node The node to remove, must be in the index.
+ * **/
+static void asIndexRemove(AmountSetStore store, AmountSetNode node);
+
+/**
+ * asIndexResize: Rebuilds the hash index with a new capacity, dropping all tombstones.
+ *
+ * @param store The store whose index is rebuilt.
+ * @param capacity The new capacity, must be a power of 2 larger than the store's size.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the index is unchanged.
+ *      AS_SUCCESS - if the index was rebuilt.
+ * **/
+static AmountSetResult asIndexResize(AmountSetStore store, int capacity);
+
+/**
+ * asIndexReserve: Grows the hash index so that it can hold a number of elements without resizing.
+ *
+ * @param store The store whose index is grown.
+ * @param size The number of elements the index should hold.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the index is unchanged.
+ *      AS_SUCCESS - if the index is large enough.
+ * **/
+static AmountSetResult asIndexReserve(AmountSetStore store, int size);
+
+/**
+ * asElementPrefix: Packs the first AS_PREFIX_LENGTH characters of an element into words.
+ *
+ * @param element The element to pack.
+ * @param length The element's length.
+ * @param prefix An array of AS_PREFIX_WORDS words to return the packed prefix in.
+ * **/
+static void asElementPrefix(const char *element, size_t length, uint64_t *prefix);
+
+/**
+ * asCompareNode: Compares a node's element with an element.
+ *
+ * Compares the cached prefixes first, the characters past the prefix are only
+ * read if the prefixes are equal.
+ *
+ * @param node The node whose element is compared.
+ * @param element The element to compare to.
+ * @param length The element's length.
+ * @param prefix The element's packed prefix, see asElementPrefix.
+ * @return
+ *      The result of strcmp on the node's element and the element.
+ * **/
+static int asCompareNode(AmountSetNode node, const char *element, size_t length, const uint64_t *prefix);
+
+/**
+ * asSearchCompare: Compares a node's element with an element during a search, see asCompareNode.
+ *
+ * Counts the node as visited, and counts comparisons that read past the cached prefix.
+ *
+ * @param store The store being searched.
+ * @param node The node whose element is compared.
+ * @param element The element to compare to.
+ * @param length The element's length.
+ * @param prefix The element's packed prefix, see asElementPrefix.
+ * @param visited The number of nodes visited by the search, incremented.
+ * @return
+ *      The result of strcmp on the node's element and the element.
+ * **/
+static int asSearchCompare(AmountSetStore store, AmountSetNode node, const char *element, size_t length,
+                           const uint64_t *prefix, long *visited);
+
+/**
+ * asComparePairs: Compares two AmountSetPairs by their elements, for qsort.
+ *
+ * @param first The first pair.
+ * @param second The second pair.
+ * @return
+ *      The result of strcmp on the pairs' elements.
+ * **/
+static int asComparePairs(const void *first, const void *second);
+
+/**
+ * asRandomLevel: Draws the level of a new node, each level is kept with probability 1/4.
+ *
+ * @param store The store whose random state is advanced.
+ * @return
+ *      A level between 1 and AS_MAX_LEVEL.
+ * **/
+static int asRandomLevel(AmountSetStore store);
+
+/**
+ * asFindPrecedingNodes: Find, on every level, the last node whose element is smaller than a specific element.
+ *
+ * Starts from the store's finger if the element is larger than the finger's element
+ * (or the finger is the header), climbing only as many levels as the distance
+ * requires, and from the top level of the header otherwise. The result becomes the store's finger, so it must be called
+ * only on a store that is about to be changed. The iterator is untouched.
+ * Levels above the store's current level get the store's header.
+ *
+ * @param store The store to search in.
+ * @param element The element to match.
+ * @param length The element's length.
+ * @param preceding_nodes An array of AS_MAX_LEVEL nodes to return the result in,
+ *      the store's header stands for "before the first node".
+ * **/
+static void asFindPrecedingNodes(AmountSetStore store, const char *element, size_t length,
+                                 AmountSetNode *preceding_nodes);
+
+/**
+ * asFindLowerBound: Find the first node whose element is not smaller than a specific element.
+ *
+ * Searches the skip list from the top level down, the iterator is untouched.
+ *
+ * @param store The store to search in.
+ * @param element The element to match, NULL stands for "before all elements".
+ * @return
+ *      NULL - if all of the store's elements are smaller than the element.
+ *      The first node whose element is equal to or larger than the element otherwise.
+ * **/
+static AmountSetNode asFindLowerBound(AmountSetStore store, const char *element);
+
+/**
+ * asAmountPrecedes: Checks if a node comes before a position in the amount order.
+ *
+ * @param candidate The node to check.
+ * @param amount The amount of the position.
+ * @param node The node whose element breaks ties of the position's amount.
+ * @return
+ *      true if candidate's amount is larger, or equal with a smaller element.
+ *      false otherwise.
+ * **/
+static bool asAmountPrecedes(AmountSetNode candidate, double amount, AmountSetNode node);
+
+/**
+ * asAmountFindPreceding: Find, on every level, the last node before a position in the amount order.
+ *
+ * Levels above the store's current level get the store's header.
+ *
+ * @param store The store to search in.
+ * @param amount The amount of the position.
+ * @param node The node whose element breaks ties of the position's amount.
+ * @param preceding_nodes An array of AS_MAX_LEVEL nodes to return the result in.
+ * @param ranks An array of AS_MAX_LEVEL to return the number of nodes up to and
+ *      including every preceding node in, may be NULL.
+ * **/
+static void asAmountFindPreceding(AmountSetStore store, double amount, AmountSetNode node,
+                                  AmountSetNode *preceding_nodes, int *ranks);
+
+/**
+ * asAmountIndexInsert: Links a node into the amount order by its amount.
+ *
+ * @param store The store the node belongs to.
+ * @param node The node to link.
+ * **/
+static void asAmountIndexInsert(AmountSetStore store, AmountSetNode node);
+
+/**
+ * asAmountIndexRemove: Unlinks a node from the amount order.
+ *
+ * @param store The store the node belongs to.
+ * @param node The node to unlink.
+ * @param preceding_nodes The nodes preceding the node on every level, see asAmountFindPreceding.
+ * **/
+static void asAmountIndexRemove(AmountSetStore store, AmountSetNode node, AmountSetNode *preceding_nodes);
+
+/**
+ * asAmountIndexUpdate: Changes a node's amount, moving it in the amount order if needed.
+ *
+ * A node whose position in the amount order doesn't change is not relinked.
+ *
+ * @param store The store the node belongs to.
+ * @param node The node to change.
+ * @param amount The node's new amount.
+ * **/
+static void asAmountIndexUpdate(AmountSetStore store, AmountSetNode node, double amount);
+
+/**
+ * asAmountIndexBuild: Links all nodes of a store into the amount order at once.
+ *
+ * Used after nodes were added with asAppendNode, which leaves them out of the amount order.
+ *
+ * @param store The store to index.
+ * @param ordered All nodes of the store in the amount order. If NULL, the
+ *      nodes are collected and sorted first.
+ * @return
+ *      AS_OUT_OF_MEMORY - if sorting the nodes failed, the amount order is unchanged.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asAmountIndexBuild(AmountSetStore store, AmountSetNode *ordered);
+
+/**
+ * asAmountIndexLinkAll: Links all nodes of a store into the amount order, like
+ * asAmountIndexBuild, or one node at a time if there is no memory for sorting them.
+ *
+ * @param store The store to index, none of whose nodes are in the amount order yet.
+ * **/
+static void asAmountIndexLinkAll(AmountSetStore store);
+
+/**
+ * asCompareByAmount: Compares two nodes by the amount order, for use with qsort.
+ *
+ * @param first Pointer to the first node.
+ * @param second Pointer to the second node.
+ * @return
+ *      A negative number if the first node comes first in the amount order, positive otherwise.
+ * **/
+static int asCompareByAmount(const void *first, const void *second);
+
+/**
+ * asStoreFreeze: Creates a frozen or small copy of a store, referenced once.
+ *
+ * @param store The store to copy, must not be frozen.
+ * @param small Whether to create a small store, which must have room for the store's elements.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new store otherwise.
+ * **/
+static AmountSetStore asStoreFreeze(AmountSetStore store, bool small);
+
+/**
+ * asStoreThaw: Creates a store with skip lists and an index from a frozen or small store,
+ * referenced once.
+ *
+ * @param store The frozen or small store to copy.
+ * @param position A position in the frozen store, or -1.
+ * @param cursor Where to return the node of the new store at position, NULL if position is -1.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new store otherwise.
+ * **/
+static AmountSetStore asStoreThaw(AmountSetStore store, int position, AmountSetNode *cursor);
+
+/**
+ * asArraySize: Returns the number of bytes the arrays of a frozen store take.
+ *
+ * @param size The number of elements.
+ * @param blob_size The total length of the elements, including their terminators.
+ * @return
+ *      The size of the arrays.
+ * **/
+static size_t asArraySize(size_t size, size_t blob_size);
+
+/**
+ * asArrayLayout: Points the arrays of a frozen store into a block of memory.
+ *
+ * The amounts come first, then the offsets, the amount order and the elements,
+ * so every array is aligned if the block is.
+ *
+ * @param array The arrays to set.
+ * @param memory The block, of at least asArraySize bytes.
+ * @param size The number of elements.
+ * **/
+static void asArrayLayout(AmountSetArray *array, void *memory, size_t size);
+
+/**
+ * asArrayRelease: Frees or unmaps the memory of a frozen store's arrays.
+ *
+ * @param array The arrays to release, left empty. Nothing is done if they are empty.
+ * **/
+static void asArrayRelease(AmountSetArray *array);
+
+/**
+ * asChecksum: Continues a 64 bit FNV-1a hash over a block of memory.
+ *
+ * @param checksum The hash so far, AS_FNV64_OFFSET_BASIS for the first block.
+ * @param data The block to hash.
+ * @param size The block's size.
+ * @return
+ *      The hash including the block.
+ * **/
+static uint64_t asChecksum(uint64_t checksum, const void *data, size_t size);
+
+/**
+ * asCheckFile: Checks that a mapped file is a valid binary snapshot.
+ *
+ * @param mapping The file's contents.
+ * @param file_size The file's size.
+ * @return
+ *      AS_INVALID_FILE - if the file isn't a valid snapshot.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asCheckFile(const void *mapping, size_t file_size);
+
+/**
+ * asArrayElement: Returns an element of a frozen store.
+ *
+ * @param store The frozen store.
+ * @param position The element's position.
+ * @return
+ *      The element, and not a copy of it.
+ * **/
+static char *asArrayElement(AmountSetStore store, int position);
+
+/**
+ * asArrayLowerBound: Finds the position of the first element of a frozen store
+ * that is not smaller than a specific element, with a binary search.
+ *
+ * @param store The frozen store.
+ * @param element The element to match, NULL stands for "before all elements".
+ * @return
+ *      The store's size - if all of the store's elements are smaller than the element.
+ *      The position of the first element equal to or larger than the element otherwise.
+ * **/
+static int asArrayLowerBound(AmountSetStore store, const char *element);
+
+/**
+ * asArrayFind: Finds the position of an element in a frozen store.
+ *
+ * @param store The frozen store.
+ * @param element The element to find.
+ * @return
+ *      -1 - if the element isn't in the store.
+ *      The element's position otherwise.
+ * **/
+static int asArrayFind(AmountSetStore store, const char *element);
+
+/**
+ * asCursorLowerBound: Places a cursor at the first element not smaller than a specific element.
+ *
+ * @param store The store to walk.
+ * @param element The element to match, NULL stands for "before all elements".
+ * @param cursor The cursor to place.
+ * **/
+static void asCursorLowerBound(AmountSetStore store, const char *element, AmountSetCursor *cursor);
+
+/**
+ * asCursorValid: Checks if a cursor didn't pass the last element of its store.
+ *
+ * @param cursor The cursor to check.
+ * @return
+ *      true if the cursor is at an element, false otherwise.
+ * **/
+static bool asCursorValid(const AmountSetCursor *cursor);
+
+/**
+ * asCursorNext: Advances a valid cursor to the next element.
+ *
+ * @param cursor The cursor to advance.
+ * **/
+static void asCursorNext(AmountSetCursor *cursor);
+
+/**
+ * asCursorElement: Returns the element at a valid cursor.
+ *
+ * @param cursor The cursor.
+ * @param out_length Where to return the element's length.
+ * @return
+ *      The element, and not a copy of it.
+ * **/
+static char *asCursorElement(const AmountSetCursor *cursor, size_t *out_length);
+
+/**
+ * asCursorAmount: Returns the amount of the element at a valid cursor.
+ *
+ * @param cursor The cursor.
+ * @return
+ *      The element's amount.
+ * **/
+static double asCursorAmount(const AmountSetCursor *cursor);
+
+/**
+ * asCompareRanked: Compares ranked positions by descending amount and then by position.
+ *
+ * @param first Pointer to the first AmountSetRanked.
+ * @param second Pointer to the second AmountSetRanked.
+ * @return
+ *      A negative number if the first position comes first in the amount order,
+ *      a positive number if the second does, and 0 if they are equal.
+ * **/
+static int asCompareRanked(const void *first, const void *second);
+
+/**
+ * asAggregateAdd: Adds an amount to a running total, with Neumaier's
+ * compensated summation.
+ *
+ * The low-order part lost by every addition is added to the compensation, so
+ * that the total and its compensation together stay accurate however many
+ * amounts are added and subtracted.
+ *
+ * @param aggregate The aggregate whose total is updated.
+ * @param amount The amount to add.
+ * **/
+static void asAggregateAdd(AmountSetAggregate *aggregate, double amount);
+
+/**
+ * asAggregateChange: Updates the aggregates of a store for an element whose amount changed.
+ *
+ * @param aggregate The aggregate to update.
+ * @param old_amount The element's amount before the change, 0 for a new element.
+ * @param new_amount The element's amount after the change, 0 for a deleted element.
+ * **/
+static void asAggregateChange(AmountSetAggregate *aggregate, double old_amount, double new_amount);
+
+/**
+ * asAggregateScan: Computes the aggregates of an array of amounts.
+ *
+ * @param aggregate The aggregate to set.
+ * @param amounts The amounts.
+ * @param size The number of amounts.
+ * **/
+static void asAggregateScan(AmountSetAggregate *aggregate, const double *amounts, int size);
+
+/**
+ * asStoreCopyStats: Copies the counters of a store to a store replacing it.
+ *
+ * @param new_store The store whose counters are set.
+ * @param store The store the counters are copied from.
+ * **/
+static void asStoreCopyStats(AmountSetStore new_store, AmountSetStore store);
+
+/**
+ * asStoreMemory: Returns the number of bytes of memory a store holds.
+ *
+ * Walks the store's arena blocks, a mapped snapshot file isn't counted.
+ *
+ * @param store The store to measure.
+ * @return
+ *      The number of bytes allocated for the store and its elements.
+ * **/
+static size_t asStoreMemory(AmountSetStore store);
+
+/**
+ * asStatsSearch: Counts a finished search of a store.
+ *
+ * @param store The store that was searched.
+ * @param visited The number of nodes the search visited.
+ * **/
+static void asStatsSearch(AmountSetStore store, long visited);
+
+#ifdef AS_STATS
+/**
+ * asStatsMax: Atomically raises a maximum counter to a value.
+ *
+ * @param maximum The counter.
+ * @param value The value to raise it to, if it's larger.
+ * **/
+static void asStatsMax(long *maximum, long value);
+#endif
+
+/**
+ * asExpand: Moves the elements of a set's frozen or small store into nodes.
+ *
+ * Keeps the internal iterator at its element.
+ *
+ * @param set The set whose store is replaced.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the set is unchanged.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asExpand(AmountSet set);
+
+/**
+ * asFrozenCheck: Checks whether a change of a set with a frozen store would fail,
+ * so that a failing change doesn't thaw the set.
+ *
+ * @param set The set about to be changed.
+ * @param type AS_CHANGE_REGISTER, AS_CHANGE_AMOUNT or AS_CHANGE_DELETE.
+ * @param element The element to change.
+ * @param amount The change of the element's amount, for AS_CHANGE_AMOUNT.
+ * @param create Whether AS_CHANGE_AMOUNT registers a missing element first.
+ * @return
+ *      The result of the public function doing the change, if it would fail.
+ *      AS_SUCCESS - if the store isn't frozen, or the change would succeed.
+ * **/
+static AmountSetResult asFrozenCheck(AmountSet set, AmountSetChangeType type, const char *element, double amount,
+                                     bool create);
+
+/**
+ * asShrink: Moves the elements of a set's store into a small store, if there are few enough.
+ *
+ * Does nothing if the store is not private, or has more than AS_SMALL_MIN_SIZE
+ * elements, or an allocation fails. The internal iterator becomes undefined.
+ *
+ * @param set The set whose store may be replaced.
+ * **/
+static void asShrink(AmountSet set);
+
+/**
+ * asSmallReserve: Makes room in the blob of a small store.
+ *
+ * @param store The small store.
+ * @param blob_size The number of characters the blob has to hold.
+ * @return
+ *      AS_OUT_OF_MEMORY - if growing the blob failed, the store is unchanged.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asSmallReserve(AmountSetStore store, size_t blob_size);
+
+/**
+ * asSmallInsert: Inserts an element into a small store at its sorted position.
+ *
+ * @param store The small store, which must have room for another element.
+ * @param position The element's position, as returned by asArrayLowerBound.
+ * @param element The element to add.
+ * @param length The element's length.
+ * @param amount The element's initial amount.
+ * @return
+ *      AS_OUT_OF_MEMORY - if growing the blob failed, the store is unchanged.
+ *      AS_SUCCESS - if the element was inserted.
+ * **/
+static AmountSetResult asSmallInsert(AmountSetStore store, int position, const char *element, size_t length,
+                                     double amount);
+
+/**
+ * asSmallRemove: Removes the element at a position of a small store.
+ *
+ * @param store The small store.
+ * @param position The element's position.
+ * **/
+static void asSmallRemove(AmountSetStore store, int position);
+
+/**
+ * asSmallOrder: Sorts the amount order of a small store, with an insertion sort,
+ * and recounts its aggregates.
+ *
+ * @param store The small store.
+ * **/
+static void asSmallOrder(AmountSetStore store);
+
+/**
+ * asSmallChange: Changes the element of a set with a small store.
+ *
+ * Does the work of asRegister, asChangeAmount, asUpsertAmount and asDelete.
+ * Adding an element must leave the store with at most AS_SMALL_CAPACITY elements.
+ *
+ * @param set The set to change.
+ * @param type AS_CHANGE_REGISTER, AS_CHANGE_AMOUNT or AS_CHANGE_DELETE.
+ * @param element The element to change.
+ * @param amount The change of the element's amount, for AS_CHANGE_AMOUNT.
+ * @param create Whether AS_CHANGE_AMOUNT registers a missing element first.
+ * @param out_created Where to return whether the element was registered, may be NULL.
+ * @return
+ *      The result of the public function doing the change.
+ * **/
+static AmountSetResult asSmallChange(AmountSet set, AmountSetChangeType type, const char *element, double amount,
+                                     bool create, bool *out_created);
+
+/**
+ * asSmallMakeRoom: Moves the elements of a full small store into nodes before an element is added.
+ *
+ * @param set The set about to be changed.
+ * @param element The element about to be added, nothing is done if it's already in the set.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the set is unchanged.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asSmallMakeRoom(AmountSet set, const char *element);
+
+/**
+ * asRecordChange: Records a successful change of a set in its journal and its
+ * filter, if it has them.
+ *
+ * If the element can't be copied the recorded changes are dropped instead,
+ * the change itself is kept.
+ *
+ * @param set The changed set.
+ * @param type The kind of change.
+ * @param element The changed element, NULL for AS_CHANGE_CLEAR.
+ * @param length The element's length.
+ * @param amount The change of the element's amount, 0 unless type is AS_CHANGE_AMOUNT.
+ * **/
+static void asRecordChange(AmountSet set, AmountSetChangeType type, const char *element, size_t length,
+                           double amount);
+
+/**
+ * asRecordReset: Drops the recorded changes of a set whose change can't be
+ * recorded, and marks its filter for rebuilding.
+ *
+ * The next change gets a new sequence number, so that reading from any
+ * sequence number before it fails.
+ *
+ * @param set The changed set.
+ * **/
+static void asRecordReset(AmountSet set);
+
+/**
+ * asJournalDestroy: Frees a journal and the elements of its changes.
+ *
+ * @param journal The journal to free. If journal is NULL nothing will be done.
+ * **/
+static void asJournalDestroy(AmountSetJournal journal);
+
+/**
+ * asFilterCreate: Allocates an empty filter with room for a number of elements.
+ *
+ * @param false_positive_rate The share of missing elements the filter should let through.
+ * @param size The number of elements the filter starts with, it has room for twice as many.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new filter otherwise.
+ * **/
+static AmountSetFilter asFilterCreate(double false_positive_rate, int size);
+
+/**
+ * asFilterBuild: Creates a filter of the elements of a store.
+ *
+ * @param store The store whose elements are added.
+ * @param false_positive_rate The share of missing elements the filter should let through.
+ * @return
+ *      NULL - if an allocation failed.
+ *      The new filter otherwise.
+ * **/
+static AmountSetFilter asFilterBuild(AmountSetStore store, double false_positive_rate);
+
+/**
+ * asFilterDestroy: Frees a filter.
+ *
+ * @param filter The filter to free. If filter is NULL nothing will be done.
+ * **/
+static void asFilterDestroy(AmountSetFilter filter);
+
+/**
+ * asFilterReset: Clears all the bits of a filter.
+ *
+ * @param filter The filter to clear.
+ * @param capacity The number of elements to make room for before rebuilding,
+ *      0 keeps the current capacity.
+ * **/
+static void asFilterReset(AmountSetFilter filter, int capacity);
+
+/**
+ * asFilterMix: Spreads the bits of an element's hash and length over 64 bits.
+ *
+ * @param hash The element's hash, as returned by asHashElement.
+ * @param length The element's length.
+ * @return
+ *      The mixed hash.
+ * **/
+static uint64_t asFilterMix(unsigned int hash, size_t length);
+
+/**
+ * asFilterAdd: Sets the bits of an element in a filter.
+ *
+ * @param filter The filter to add to.
+ * @param hash The element's hash, as returned by asHashElement.
+ * @param length The element's length.
+ * **/
+static void asFilterAdd(AmountSetFilter filter, unsigned int hash, size_t length);
+
+/**
+ * asFilterMayContain: Checks if all the bits of an element are set in a filter.
+ *
+ * @param filter The filter to check.
+ * @param hash The element's hash, as returned by asHashElement.
+ * @param length The element's length.
+ * @return
+ *      false if the element was never added to the filter, true if it may have been.
+ * **/
+static bool asFilterMayContain(AmountSetFilter filter, unsigned int hash, size_t length);
+
+/**
+ * asFilterRefresh: Rebuilds a set's filter if it is stale, or worn out by
+ * added or deleted elements.
+ *
+ * If the filter can't be rebuilt it is kept, a stale filter is then bypassed
+ * by lookups until a later change rebuilds it.
+ *
+ * @param set The changed set.
+ * **/
+static void asFilterRefresh(AmountSet set);
+
+/**
+ * asFilterRejects: Checks if a set's filter proves an element is missing from
+ * the set. Only reads the filter, it is rebuilt by the changes of the set.
+ *
+ * @param set The set to check.
+ * @param hash The element's hash, as returned by asHashElement.
+ * @param length The element's length.
+ * @return
+ *      true if the element is not in the set, false if the set has no filter
+ *      or the element may be in it.
+ * **/
+static bool asFilterRejects(AmountSet set, unsigned int hash, size_t length);
+
+/**
+ * asHandlesGrow: Doubles the number of chains of a set's handle table, or
+ * allocates the table if the set has none.
+ *
+ * @param set The set whose handle table grows.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the table is unchanged.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asHandlesGrow(AmountSet set);
+
+/**
+ * asHandleResolve: Finds the element of a handle in its set's current store,
+ * unless its node or position is still known.
+ *
+ * @param handle The handle to resolve.
+ * @return
+ *      true if the element is in the set, false otherwise.
+ * **/
+static bool asHandleResolve(AmountSetHandle handle);
+
+/**
+ * asReaderNextLine: Returns the next line of a stream, without its line break.
+ *
+ * The line stays in the reader's buffer until the next call, and the byte
+ * after it may be overwritten, to terminate a part of the line.
+ *
+ * @param reader The reader of the stream.
+ * @param out_line Where to return the line, NULL at the end of the stream.
+ * @param out_length Where to return the line's length.
+ * @return
+ *      AS_OUT_OF_MEMORY - if a line didn't fit the buffer and growing it failed.
+ *      AS_IO_ERROR - if reading the stream failed.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asReaderNextLine(AmountSetReader *reader, char **out_line, size_t *out_length);
+
+/**
+ * asParseLine: Splits a line into an element and its amount.
+ *
+ * The amount follows the last run of spaces or tabs of the line, and the
+ * element is what comes before that run. The element is terminated in place.
+ *
+ * @param line The line, without its line break. The byte after it is overwritten.
+ * @param length The line's length.
+ * @param out_element Where to return the element, NULL for a blank line.
+ * @param out_amount Where to return the amount.
+ * @return
+ *      AS_INVALID_FILE - if the line has no amount, or it isn't a finite number.
+ *      AS_INSUFFICIENT_AMOUNT - if the amount is negative.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asParseLine(char *line, size_t length, char **out_element, double *out_amount);
+
+/**
+ * asParseAmount: Parses a decimal number.
+ *
+ * Numbers of up to 15 digits without an exponent are computed exactly as the
+ * quotient of two exact doubles, anything else is left to strtod. Both give
+ * the double nearest to the number.
+ *
+ * @param text The number, followed by a byte that can be overwritten.
+ * @param length The number's length.
+ * @param out_amount Where to return the number.
+ * @return
+ *      false - if the text isn't a finite number.
+ *      true - otherwise.
+ * **/
+static bool asParseAmount(char *text, size_t length, double *out_amount);
+
+/**
+ * asFormatAmount: Writes an amount in decimal, so that asParseAmount reads it back exactly.
+ *
+ * Amounts that are a number of up to 15 digits and 9 decimals are written
+ * with the fewest decimals that read back exactly, without calling printf.
+ * Other amounts are written as by "%.17g".
+ *
+ * @param amount The amount to write.
+ * @param out Where to write the amount, at least AS_FORMAT_MAX_LENGTH bytes.
+ * @return
+ *      The number of bytes written, without a terminating null.
+ * **/
+static size_t asFormatAmount(double amount, char *out);
+
+/**
+ * asBuildFromArrays: Creates a set from arrays of elements and amounts, see asCreateFromArrays.
+ *
+ * @param elements The elements to add.
+ * @param amounts The amounts of the elements, NULL for amounts of 0.
+ * @param size The number of elements.
+ * @param threads The number of threads sorting the elements and amounts.
+ * @param outSet Where to return the new set.
+ * @return
+ *      As returned by asCreateFromArrays.
+ * **/
+static AmountSetResult asBuildFromArrays(const char *const *elements, const double *amounts, int size, int threads,
+                                         AmountSet *outSet);
+
+/**
+ * asRunTasks: Runs tasks on threads of their own, the first on the calling thread.
+ *
+ * A task whose thread can't be started is run on the calling thread instead.
+ *
+ * @param tasks The tasks to run.
+ * @param count The number of tasks, at most AS_MAX_THREADS.
+ * **/
+static void asRunTasks(AmountSetTask *tasks, int count);
+
+/**
+ * asRunTask: Runs a single task, as the start routine of its thread.
+ *
+ * @param task The task to run.
+ * @return
+ *      NULL.
+ * **/
+static void *asRunTask(void *task);
+
+/**
+ * asParallelSort: Sorts an array like qsort, with threads sorting runs of it
+ * and merging them in pairs.
+ *
+ * Arrays of fewer than AS_PARALLEL_MIN_RUN elements per thread are sorted by
+ * fewer threads. Falls back to qsort for arrays of fewer than two such runs, or
+ * if there is no memory for merging.
+ * Stable between the runs, so equal elements may end up in any order like with qsort.
+ *
+ * @param base The array to sort.
+ * @param count The number of elements.
+ * @param width The size of an element.
+ * @param compare The comparison function, as for qsort.
+ * @param threads The number of threads to use.
+ * **/
+static void asParallelSort(void *base, size_t count, size_t width, int (*compare)(const void *, const void *),
+                           int threads);
+
+/**
+ * asParallelCopy: Copies memory like memcpy, with threads copying parts of it.
+ *
+ * @param target Where to copy to.
+ * @param source What to copy.
+ * @param size The number of bytes.
+ * @param threads The number of threads to use.
+ * **/
+static void asParallelCopy(void *target, const void *source, size_t size, int threads);
+
+/**
+ * asCombineSets: Builds a set from the elements of two sets in a single ordered pass.
+ *
+ * @param first The first set.
+ * @param second The second set.
+ * @param combine The function combining the amounts of elements in both sets,
+ *      NULL keeps the first set's amount.
+ * @param keep Which elements to keep, a combination of AS_KEEP_FIRST_ONLY,
+ *      AS_KEEP_SECOND_ONLY and AS_KEEP_BOTH.
+ * @param outSet Where to return the new set, NULL replaces the contents of the first set.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, nothing is changed.
+ *      AS_INSUFFICIENT_AMOUNT - if a combined amount is negative, nothing is changed.
+ *      AS_SUCCESS - if the set was built successfully.
+ * **/
+static AmountSetResult asCombineSets(AmountSet first, AmountSet second, AmountSetCombiner combine,
+                                     int keep, AmountSet *outSet);
+
+AmountSet asCreate()
+{
+    return asCreateFromStore(asStoreCreateSmall(AS_SMALL_INITIAL_BLOB_SIZE));
+}
+
+void asDestroy(AmountSet set)
+{
+    if (!set)
+        return;
+
+    asJournalDestroy(set->journal);
+    asFilterDestroy(set->filter);
+    for (int i = 0; i < set->handles_capacity; i++)
+    {
+        while (set->handles[i])
+        {
+            AmountSetHandle next = set->handles[i]->next;
+            free(set->handles[i]->element);
+            free(set->handles[i]);
+            set->handles[i] = next;
+        }
+    }
+    free(set->handles);
+
+    asStoreRelease(set->store);
+    free(set);
+}
+
+AmountSet asCopy(AmountSet set)
+{
+    if (!set)
+        return NULL;
+
+    AmountSet new_set = malloc(sizeof(*new_set));
+    if (!new_set)
+        return NULL;
+
+    __atomic_add_fetch(&set->store->references, 1, __ATOMIC_RELAXED);
+    new_set->store = set->store;
+    new_set->current_node = NULL;
+    new_set->current_position = -1;
+    new_set->journal = NULL;
+    new_set->filter = NULL;
+    new_set->handles = NULL;
+    new_set->handles_capacity = 0;
+    new_set->handles_count = 0;
+    return new_set;
+}
+
+AmountSet asCopyParallel(AmountSet set, int threads)
+{
+    if (!set || threads < 1)
+        return NULL;
+
+    AmountSetStore store = set->store;
+    if (!store->array.memory || asStoreIsSmall(store))
+    {
+        // Nodes are carved from a single arena, a private copy is made by one thread
+        AmountSet new_set = asCopy(set);
+        if (new_set && asPrepareWrite(new_set) != AS_SUCCESS)
+        {
+            asDestroy(new_set);
+            return NULL;
+        }
+
+        return new_set;
+    }
+
+    AmountSet new_set = asCreateFromStore(asStoreCreate());
+    size_t array_size = asArraySize(store->size, store->array.offsets[store->size]);
+    void *memory = new_set ? malloc(array_size) : NULL;
+    if (!memory)
+    {
+        asDestroy(new_set);
+        return NULL;
+    }
+
+    // The arrays are laid out the same way in memory and in snapshot files
+    asParallelCopy(memory, store->array.amounts, array_size, threads);
+    AmountSetStore new_store = new_set->store;
+    asStoreCopyStats(new_store, store);
+    new_store->array.memory = memory;
+    asArrayLayout(&new_store->array, memory, store->size);
+    new_store->size = store->size;
+    new_store->aggregate = store->aggregate;
+    return new_set;
+}
+
+AmountSetResult asCreateFromArrays(const char *const *elements, const double *amounts, int size, AmountSet *outSet)
+{
+    return asBuildFromArrays(elements, amounts, size, 1, outSet);
+}
+
+AmountSetResult asCreateFromArraysParallel(const char *const *elements, const double *amounts, int size, int threads,
+                                           AmountSet *outSet)
+{
+    if (threads < 1)
+        return AS_NULL_ARGUMENT;
+
+    return asBuildFromArrays(elements, amounts, size, threads, outSet);
+}
+
+int asGetSize(AmountSet set)
+{
+    if (!set)
+        return -1;
+
+    return set->store->size;
+}
+
+bool asContains(AmountSet set, const char *element)
+{
+    if (!set || !element)
+        return false;
+
+    AS_STATS_ADD(set->store, lookups, 1);
+    size_t length = 0;
+    unsigned int hash = 0;
+    if (set->filter || !set->store->array.memory)
+    {
+        hash = asHashElement(element, &length);
+        if (asFilterRejects(set, hash, length))
+            return false;
+    }
+
+    if (set->store->array.memory)
+        return asArrayFind(set->store, element) >= 0;
+
+    return asIndexFind(set->store, element, hash, length) != NULL;
+}
+
+AmountSetResult asGetAmount(AmountSet set, const char *element, double *outAmount)
+{
+    if (!set || !element || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    AS_STATS_ADD(set->store, lookups, 1);
+    size_t length = 0;
+    unsigned int hash = 0;
+    if (set->filter || !set->store->array.memory)
+    {
+        hash = asHashElement(element, &length);
+        if (asFilterRejects(set, hash, length))
+            return AS_ITEM_DOES_NOT_EXIST;
+    }
+
+    if (set->store->array.memory)
+    {
+        int position = asArrayFind(set->store, element);
+        if (position < 0)
+            return AS_ITEM_DOES_NOT_EXIST;
+
+        *outAmount = set->store->array.amounts[position];
+        return AS_SUCCESS;
+    }
+
+    AmountSetNode node = asIndexFind(set->store, element, hash, length);
+    if (!node)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    *outAmount = node->amount;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asRegister(AmountSet set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AS_STATS_ADD(set->store, registers, 1);
+    // A frozen set is thawed only for a change that will be done
+    AmountSetResult frozen_result = asFrozenCheck(set, AS_CHANGE_REGISTER, element, 0, false);
+    if (frozen_result != AS_SUCCESS)
+        return frozen_result;
+
+    if (asThaw(set) != AS_SUCCESS || asSmallMakeRoom(set, element) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    if (asStoreIsSmall(set->store))
+        return asSmallChange(set, AS_CHANGE_REGISTER, element, 0, false, NULL);
+
+    size_t length;
+    unsigned int hash = asHashElement(element, &length);
+    if (asIndexFind(set->store, element, hash, length))
+        return AS_ITEM_ALREADY_EXISTS;
+
+    if (asPrepareWrite(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    set->current_node = NULL;
+    AmountSetResult operation_result = asInsertNode(set->store, element, length, hash, 0);
+    if (operation_result == AS_SUCCESS)
+        asRecordChange(set, AS_CHANGE_REGISTER, element, length, 0);
+
+    return operation_result;
+}
+
+AmountSetResult asUpsertAmount(AmountSet set, const char *element, const double amount, bool *outCreated)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    if (outCreated)
+        *outCreated = false;
+
+    AS_STATS_ADD(set->store, upserts, 1);
+    AmountSetResult frozen_result = asFrozenCheck(set, AS_CHANGE_AMOUNT, element, amount, true);
+    if (frozen_result != AS_SUCCESS)
+        return frozen_result;
+
+    if (asThaw(set) != AS_SUCCESS || asSmallMakeRoom(set, element) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    if (asStoreIsSmall(set->store))
+        return asSmallChange(set, AS_CHANGE_AMOUNT, element, amount, true, outCreated);
+
+    size_t length;
+    unsigned int hash = asHashElement(element, &length);
+    AmountSetNode node = asIndexFind(set->store, element, hash, length);
+    if ((node ? node->amount : 0) + amount < 0)
+        return AS_INSUFFICIENT_AMOUNT;
+
+    AmountSetStore store = set->store;
+    if (asPrepareWrite(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    if (node)
+    {
+        // The node is searched again only if the store was just copied
+        if (set->store != store)
+            node = asIndexFind(set->store, element, hash, length);
+        asAmountIndexUpdate(set->store, node, node->amount + amount);
+        asRecordChange(set, AS_CHANGE_AMOUNT, element, length, amount);
+        return AS_SUCCESS;
+    }
+
+    set->current_node = NULL;
+    AmountSetResult operation_result = asInsertNode(set->store, element, length, hash, amount);
+    if (operation_result != AS_SUCCESS)
+        return operation_result;
+
+    asRecordChange(set, AS_CHANGE_REGISTER, element, length, 0);
+    asRecordChange(set, AS_CHANGE_AMOUNT, element, length, amount);
+    if (outCreated)
+        *outCreated = true;
+
+    return AS_SUCCESS;
+}
+
+AmountSetResult asChangeAmount(AmountSet set, const char *element, const double amount)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AS_STATS_ADD(set->store, changes, 1);
+    AmountSetResult frozen_result = asFrozenCheck(set, AS_CHANGE_AMOUNT, element, amount, false);
+    if (frozen_result != AS_SUCCESS)
+        return frozen_result;
+
+    if (asThaw(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    if (asStoreIsSmall(set->store))
+        return asSmallChange(set, AS_CHANGE_AMOUNT, element, amount, false, NULL);
+
+    size_t length;
+    unsigned int hash = asHashElement(element, &length);
+    AmountSetNode node = asIndexFind(set->store, element, hash, length);
+    if (!node)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    if (node->amount + amount < 0)
+        return AS_INSUFFICIENT_AMOUNT;
+
+    AmountSetStore store = set->store;
+    if (asPrepareWrite(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    // The node is searched again only if the store was just copied
+    if (set->store != store)
+        node = asIndexFind(set->store, element, hash, length);
+    asAmountIndexUpdate(set->store, node, node->amount + amount);
+    asRecordChange(set, AS_CHANGE_AMOUNT, element, length, amount);
+    return AS_SUCCESS;
+}
+
+AmountSetResult asDelete(AmountSet set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AS_STATS_ADD(set->store, deletes, 1);
+    AmountSetResult frozen_result = asFrozenCheck(set, AS_CHANGE_DELETE, element, 0, false);
+    if (frozen_result != AS_SUCCESS)
+        return frozen_result;
+
+    if (asThaw(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    if (asStoreIsSmall(set->store))
+        return asSmallChange(set, AS_CHANGE_DELETE, element, 0, false, NULL);
+
+    size_t length;
+    unsigned int hash = asHashElement(element, &length);
+    AmountSetStore store = set->store;
+    AmountSetNode node = asIndexFind(store, element, hash, length);
+    if (!node)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    if (asPrepareWrite(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    // The node is searched again only if the store was just copied
+    if (set->store != store)
+    {
+        store = set->store;
+        node = asIndexFind(store, element, hash, length);
+    }
+
+    AmountSetNode preceding_nodes[AS_MAX_LEVEL];
+    asFindPrecedingNodes(store, element, length, preceding_nodes);
+    for (int i = 0; i < node->level; i++)
+    {
+        assert(preceding_nodes[i]->next[i] == node);
+        preceding_nodes[i]->next[i] = node->next[i];
+    }
+
+    while (store->level > 1 && store->header->next[store->level - 1] == NULL)
+        store->level--;
+
+    asAmountFindPreceding(store, node->amount, node, preceding_nodes, NULL);
+    asAmountIndexRemove(store, node, preceding_nodes);
+    asIndexRemove(store, node);
+    asFreeNode(store, node);
+    set->current_node = NULL;
+    store->size--;
+    asRecordChange(set, AS_CHANGE_DELETE, element, length, 0);
+    asShrink(set);
+    return AS_SUCCESS;
+}
+
+AmountSetResult asClear(AmountSet set)
+{
+    if (!set)
+        return AS_NULL_ARGUMENT;
+
+    set->current_node = NULL;
+    set->current_position = -1;
+    // A shared store is left to the copies, a private one is freed
+    AmountSetStore new_store = asStoreCreateSmall(AS_SMALL_INITIAL_BLOB_SIZE);
+    if (!new_store)
+        return AS_OUT_OF_MEMORY;
+
+    asStoreCopyStats(new_store, set->store);
+    asStoreRelease(set->store);
+    set->store = new_store;
+    asRecordChange(set, AS_CHANGE_CLEAR, NULL, 0, 0);
+    return AS_SUCCESS;
+}
+
+char *asGetFirst(AmountSet set)
+{
+    if (!set)
+        return NULL;
+
+    if (set->store->array.memory)
+    {
+        set->current_position = set->store->size > 0 ? 0 : -1;
+        return set->current_position >= 0 ? asArrayElement(set->store, 0) : NULL;
+    }
+
+    if (!(set->store->header->next[0]))
+        return NULL;
+
+    set->current_node = set->store->header->next[0];
+    return asNodeElement(set->current_node);
+}
+
+char *asGetNext(AmountSet set)
+{
+    if (!set)
+        return NULL;
+
+    if (set->store->array.memory)
+    {
+        if (set->current_position < 0 || set->current_position + 1 >= set->store->size)
+            return NULL;
+
+        return asArrayElement(set->store, ++set->current_position);
+    }
+
+    if (!(set->current_node))
+        return NULL;
+
+    if (set->current_node->next[0] != NULL)
+        set->current_node = set->current_node->next[0];
+    else
+        return NULL;
+
+    return asNodeElement(set->current_node);
+}
+
+AmountSetResult asGetRange(AmountSet set, const char *low, const char *high,
+                           AmountSetVisitor visitor, void *context)
+{
+    if (!set || !visitor)
+        return AS_NULL_ARGUMENT;
+
+    AS_STATS_ADD(set->store, range_queries, 1);
+    AmountSetCursor cursor;
+    for (asCursorLowerBound(set->store, low, &cursor); asCursorValid(&cursor); asCursorNext(&cursor))
+    {
+        char *element = asCursorElement(&cursor, NULL);
+        if (high && strcmp(element, high) > 0)
+            break;
+
+        if (!visitor(element, asCursorAmount(&cursor), context))
+            break;
+    }
+
+    return AS_SUCCESS;
+}
+
+AmountSetResult asGetPrefix(AmountSet set, const char *prefix, AmountSetVisitor visitor, void *context)
+{
+    if (!set || !prefix || !visitor)
+        return AS_NULL_ARGUMENT;
+
+    AS_STATS_ADD(set->store, range_queries, 1);
+    size_t prefix_length = strlen(prefix);
+    AmountSetCursor cursor;
+    for (asCursorLowerBound(set->store, prefix, &cursor); asCursorValid(&cursor); asCursorNext(&cursor))
+    {
+        size_t length;
+        char *element = asCursorElement(&cursor, &length);
+        if (length < prefix_length || memcmp(element, prefix, prefix_length) != 0)
+            break;
+
+        if (!visitor(element, asCursorAmount(&cursor), context))
+            break;
+    }
+
+    return AS_SUCCESS;
+}
+
+int asCountRange(AmountSet set, const char *low, const char *high)
+{
+    if (!set)
+        return -1;
+
+    AS_STATS_ADD(set->store, range_queries, 1);
+    if (set->store->array.memory)
+    {
+        int begin = asArrayLowerBound(set->store, low);
+        int end = high ? asArrayLowerBound(set->store, high) : set->store->size;
+        if (high && end < set->store->size && strcmp(asArrayElement(set->store, end), high) == 0)
+            end++;
+
+        return end > begin ? end - begin : 0;
+    }
+
+    int count = 0;
+    for (AmountSetNode node = asFindLowerBound(set->store, low); node != NULL; node = node->next[0])
+    {
+        if (high && strcmp(asNodeElement(node), high) > 0)
+            break;
+
+        count++;
+    }
+
+    return count;
+}
+
+char *asIteratorBegin(AmountSet set, AmountSetIterator *iterator)
+{
+    if (!iterator)
+        return NULL;
+
+    iterator->set = set;
+    if (set && set->store->array.memory)
+    {
+        // A frozen store's iterator points at the element's amount
+        iterator->position = set->store->size > 0 ? set->store->array.amounts : NULL;
+        return iterator->position ? asArrayElement(set->store, 0) : NULL;
+    }
+
+    iterator->position = set ? set->store->header->next[0] : NULL;
+    return iterator->position ? asNodeElement(iterator->position) : NULL;
+}
+
+char *asIteratorNext(AmountSetIterator *iterator)
+{
+    if (!iterator || !iterator->position)
+        return NULL;
+
+    AmountSetStore store = iterator->set->store;
+    if (store->array.memory)
+    {
+        int position = (double *)iterator->position - store->array.amounts + 1;
+        iterator->position = position < store->size ? store->array.amounts + position : NULL;
+        return iterator->position ? asArrayElement(store, position) : NULL;
+    }
+
+    AmountSetNode node = iterator->position;
+    iterator->position = node->next[0];
+    return iterator->position ? asNodeElement(iterator->position) : NULL;
+}
+
+bool asIteratorEnd(const AmountSetIterator *iterator)
+{
+    return !iterator || !iterator->position;
+}
+
+AmountSetResult asIteratorGetAmount(const AmountSetIterator *iterator, double *outAmount)
+{
+    if (!iterator || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    if (!iterator->position)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    if (iterator->set->store->array.memory)
+        *outAmount = *(double *)iterator->position;
+    else
+        *outAmount = ((AmountSetNode)iterator->position)->amount;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asMerge(AmountSet first, AmountSet second, AmountSetCombiner combine, AmountSet *outSet)
+{
+    if (!first || !second || !combine)
+        return AS_NULL_ARGUMENT;
+
+    return asCombineSets(first, second, combine, AS_KEEP_FIRST_ONLY | AS_KEEP_SECOND_ONLY | AS_KEEP_BOTH, outSet);
+}
+
+AmountSetResult asIntersect(AmountSet first, AmountSet second, AmountSetCombiner combine, AmountSet *outSet)
+{
+    if (!first || !second || !combine)
+        return AS_NULL_ARGUMENT;
+
+    return asCombineSets(first, second, combine, AS_KEEP_BOTH, outSet);
+}
+
+AmountSetResult asSubtract(AmountSet first, AmountSet second, AmountSet *outSet)
+{
+    if (!first || !second)
+        return AS_NULL_ARGUMENT;
+
+    return asCombineSets(first, second, NULL, AS_KEEP_FIRST_ONLY, outSet);
+}
+
+AmountSetResult asFreeze(AmountSet set)
+{
+    if (!set)
+        return AS_NULL_ARGUMENT;
+
+    if (asStoreIsFrozen(set->store))
+        return AS_SUCCESS;
+
+    AmountSetStore new_store = asStoreFreeze(set->store, false);
+    if (!new_store)
+        return AS_OUT_OF_MEMORY;
+
+    asStoreRelease(set->store);
+    set->store = new_store;
+    set->current_node = NULL;
+    set->current_position = -1;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asThaw(AmountSet set)
+{
+    if (!set)
+        return AS_NULL_ARGUMENT;
+
+    if (!asStoreIsFrozen(set->store))
+        return AS_SUCCESS;
+
+    return asExpand(set);
+}
+
+double asGetTotalAmount(AmountSet set)
+{
+    if (!set)
+        return -1;
+
+    const AmountSetAggregate *aggregate = &set->store->aggregate;
+    return set->store->size > 0 ? aggregate->total + aggregate->compensation : 0;
+}
+
+int asCountPositive(AmountSet set)
+{
+    if (!set)
+        return -1;
+
+    return set->store->aggregate.positive;
+}
+
+AmountSetResult asGetMinAmount(AmountSet set, double *outAmount)
+{
+    if (!set || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetStore store = set->store;
+    if (store->size == 0)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    // Both orders by amount are descending
+    if (store->array.memory)
+        *outAmount = store->array.amounts[store->array.by_amount[store->size - 1]];
+    else
+        *outAmount = store->amount_last->amount;
+
+    return AS_SUCCESS;
+}
+
+AmountSetResult asGetMaxAmount(AmountSet set, double *outAmount)
+{
+    if (!set || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetStore store = set->store;
+    if (store->size == 0)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    if (store->array.memory)
+        *outAmount = store->array.amounts[store->array.by_amount[0]];
+    else
+        *outAmount = asNodeByAmount(store->header)[0]->amount;
+
+    return AS_SUCCESS;
+}
+
+AmountSetResult asGetFingerStats(AmountSet set, long *outHits, long *outMisses)
+{
+    if (!set || !outHits || !outMisses)
+        return AS_NULL_ARGUMENT;
+
+    *outHits = set->store->finger_hits;
+    *outMisses = set->store->finger_misses;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asSaveBinary(AmountSet set, const char *path)
+{
+    if (!set || !path)
+        return AS_NULL_ARGUMENT;
+
+    // The file holds the frozen representation, which a frozen copy shares if the set is frozen
+    AmountSet frozen = asCopy(set);
+    if (!frozen || asFreeze(frozen) != AS_SUCCESS)
+    {
+        asDestroy(frozen);
+        return AS_OUT_OF_MEMORY;
+    }
+
+    AmountSetArray *array = &frozen->store->array;
+    AmountSetFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AS_FILE_MAGIC, AS_FILE_MAGIC_LENGTH);
+    header.byte_order = AS_FILE_BYTE_ORDER;
+    header.version = AS_FILE_VERSION;
+    header.size = frozen->store->size;
+    header.blob_size = array->offsets[header.size];
+
+    size_t payload_size = asArraySize(header.size, header.blob_size);
+    header.checksum = asChecksum(AS_FNV64_OFFSET_BASIS, array->amounts, payload_size);
+
+    FILE *file = fopen(path, "wb");
+    bool written = file && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(array->amounts, 1, payload_size, file) == payload_size;
+    if (file && fclose(file) != 0)
+        written = false;
+
+    asDestroy(frozen);
+    return written ? AS_SUCCESS : AS_IO_ERROR;
+}
+
+AmountSetResult asOpenMapped(const char *path, AmountSet *outSet)
+{
+    if (!path || !outSet)
+        return AS_NULL_ARGUMENT;
+
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0)
+        return AS_IO_ERROR;
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        return AS_IO_ERROR;
+    }
+
+    size_t file_size = status.st_size;
+    if (file_size < sizeof(AmountSetFileHeader))
+    {
+        close(descriptor);
+        return AS_INVALID_FILE;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void *mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+        return AS_IO_ERROR;
+
+    AmountSetResult operation_result = asCheckFile(mapping, file_size);
+    AmountSet new_set = operation_result == AS_SUCCESS ? asCreateFromStore(asStoreCreate()) : NULL;
+    if (!new_set)
+    {
+        munmap(mapping, file_size);
+        return operation_result == AS_SUCCESS ? AS_OUT_OF_MEMORY : operation_result;
+    }
+
+    const AmountSetFileHeader *header = mapping;
+    AmountSetArray *array = &new_set->store->array;
+    array->memory = mapping;
+    array->mapped_size = file_size;
+    asArrayLayout(array, (char *)mapping + sizeof(*header), header->size);
+    new_set->store->size = header->size;
+    asAggregateScan(&new_set->store->aggregate, array->amounts, header->size);
+
+    *outSet = new_set;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asLoadStream(AmountSet set, FILE *stream)
+{
+    if (!set || !stream)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetReader reader = {stream, malloc(AS_STREAM_BUFFER_SIZE), AS_STREAM_BUFFER_SIZE, 0, 0, false};
+    if (!reader.buffer)
+        return AS_OUT_OF_MEMORY;
+
+    // An empty set is loaded into a new store, appending elements without searching while they come sorted
+    AmountSet loaded = asGetSize(set) == 0 ? asCreateFromStore(asStoreCreate()) : NULL;
+    AmountSet target = loaded ? loaded : set;
+    bool appending = loaded != NULL;
+    AmountSetNode last_nodes[AS_MAX_LEVEL];
+    for (int level = 0; appending && level < AS_MAX_LEVEL; level++)
+        last_nodes[level] = loaded->store->header;
+
+    AmountSetResult operation_result = AS_SUCCESS;
+    while (operation_result == AS_SUCCESS)
+    {
+        char *line;
+        size_t length;
+        operation_result = asReaderNextLine(&reader, &line, &length);
+        if (operation_result != AS_SUCCESS || !line)
+            break;
+
+        char *element;
+        double amount;
+        operation_result = asParseLine(line, length, &element, &amount);
+        if (operation_result != AS_SUCCESS || !element)
+            continue;
+
+        AmountSetNode last = last_nodes[0];
+        if (appending && (last == loaded->store->header || strcmp(asNodeElement(last), element) < 0))
+        {
+            unsigned int hash = asHashElement(element, &length);
+            operation_result = asAppendNode(loaded->store, last_nodes, element, length, hash, amount);
+            continue;
+        }
+
+        // From the first element out of order on, elements are searched for
+        if (appending)
+        {
+            appending = false;
+            asAmountIndexLinkAll(loaded->store);
+        }
+
+        operation_result = asUpsertAmount(target, element, amount, NULL);
+    }
+
+    free(reader.buffer);
+    if (!loaded)
+        return operation_result;
+
+    if (appending)
+        asAmountIndexLinkAll(loaded->store);
+
+    // Hand the loaded elements to the set, and its empty store to the loaded set for freeing
+    asShrink(loaded);
+    AmountSetStore old_store = set->store;
+    asStoreCopyStats(loaded->store, old_store);
+    set->store = loaded->store;
+    set->current_node = NULL;
+    set->current_position = -1;
+    loaded->store = old_store;
+    asDestroy(loaded);
+    asRecordReset(set);
+    return operation_result;
+}
+
+AmountSetResult asDumpStream(AmountSet set, FILE *stream)
+{
+    if (!set || !stream)
+        return AS_NULL_ARGUMENT;
+
+    char *buffer = malloc(AS_STREAM_BUFFER_SIZE);
+    if (!buffer)
+        return AS_OUT_OF_MEMORY;
+
+    bool written = true;
+    size_t used = 0;
+    AmountSetCursor cursor;
+    for (asCursorLowerBound(set->store, NULL, &cursor); written && asCursorValid(&cursor); asCursorNext(&cursor))
+    {
+        size_t length;
+        char *element = asCursorElement(&cursor, &length);
+        if (used + length + AS_FORMAT_MAX_LENGTH + 2 > AS_STREAM_BUFFER_SIZE)
+        {
+            written = fwrite(buffer, 1, used, stream) == used;
+            used = 0;
+        }
+
+        // Elements too long for the buffer are written directly
+        if (length + AS_FORMAT_MAX_LENGTH + 2 > AS_STREAM_BUFFER_SIZE)
+            written = written && fwrite(element, 1, length, stream) == length;
+        else
+        {
+            memcpy(buffer + used, element, length);
+            used += length;
+        }
+
+        buffer[used++] = ' ';
+        used += asFormatAmount(asCursorAmount(&cursor), buffer + used);
+        buffer[used++] = '\n';
+    }
+
+    written = written && fwrite(buffer, 1, used, stream) == used;
+    free(buffer);
+    return written ? AS_SUCCESS : AS_IO_ERROR;
+}
+
+bool asIsFrozen(AmountSet set)
+{
+    return set && asStoreIsFrozen(set->store);
+}
+
+double asSumAmounts(AmountSet set)
+{
+    if (!set)
+        return -1;
+
+    AmountSetStore store = set->store;
+    if (!store->array.memory)
+    {
+        double sum = 0;
+        for (AmountSetNode node = store->header->next[0]; node != NULL; node = node->next[0])
+            sum += node->amount;
+
+        return sum;
+    }
+
+    // Independent partial sums let the compiler vectorize and pipeline the additions
+    const double *amounts = store->array.amounts;
+    double sums[AS_SCAN_UNROLL] = {0};
+    int i = 0;
+    for (; i + AS_SCAN_UNROLL <= store->size; i += AS_SCAN_UNROLL)
+    {
+        for (int lane = 0; lane < AS_SCAN_UNROLL; lane++)
+            sums[lane] += amounts[i + lane];
+    }
+
+    double sum = 0;
+    for (; i < store->size; i++)
+        sum += amounts[i];
+
+    for (int lane = 0; lane < AS_SCAN_UNROLL; lane++)
+        sum += sums[lane];
+
+    return sum;
+}
+
+int asCountBelow(AmountSet set, double threshold)
+{
+    if (!set)
+        return -1;
+
+    AmountSetStore store = set->store;
+    if (!store->array.memory)
+    {
+        int count = 0;
+        for (AmountSetNode node = store->header->next[0]; node != NULL; node = node->next[0])
+            count += node->amount < threshold;
+
+        return count;
+    }
+
+    const double *amounts = store->array.amounts;
+    int counts[AS_SCAN_UNROLL] = {0};
+    int i = 0;
+    for (; i + AS_SCAN_UNROLL <= store->size; i += AS_SCAN_UNROLL)
+    {
+        for (int lane = 0; lane < AS_SCAN_UNROLL; lane++)
+            counts[lane] += amounts[i + lane] < threshold;
+    }
+
+    int count = 0;
+    for (; i < store->size; i++)
+        count += amounts[i] < threshold;
+
+    for (int lane = 0; lane < AS_SCAN_UNROLL; lane++)
+        count += counts[lane];
+
+    return count;
+}
+
+int asTopK(AmountSet set, int k, const char **outElements, double *outAmounts)
+{
+    if (!set || !outElements || k < 0)
+        return -1;
+
+    AmountSetStore store = set->store;
+    if (store->array.memory)
+    {
+        int count = k < store->size ? k : store->size;
+        for (int i = 0; i < count; i++)
+        {
+            outElements[i] = asArrayElement(store, store->array.by_amount[i]);
+            if (outAmounts)
+                outAmounts[i] = store->array.amounts[store->array.by_amount[i]];
+        }
+
+        return count;
+    }
+
+    int count = 0;
+    for (AmountSetNode node = asNodeByAmount(store->header)[0]; node != NULL && count < k;
+         node = asNodeByAmount(node)[0])
+    {
+        outElements[count] = asNodeElement(node);
+        if (outAmounts)
+            outAmounts[count] = node->amount;
+
+        count++;
+    }
+
+    return count;
+}
+
+int asRankOf(AmountSet set, const char *element)
+{
+    if (!set || !element)
+        return -1;
+
+    AmountSetStore store = set->store;
+    if (store->array.memory)
+    {
+        int position = asArrayFind(store, element);
+        if (position < 0)
+            return 0;
+
+        // Binary search of the amount order for the element's amount and then the element
+        double amount = store->array.amounts[position];
+        int low = 0, high = store->size;
+        while (low < high)
+        {
+            int middle = low + (high - low) / 2;
+            int candidate = store->array.by_amount[middle];
+            double candidate_amount = store->array.amounts[candidate];
+            if (candidate_amount > amount || (candidate_amount == amount && candidate < position))
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        return low + 1;
+    }
+
+    size_t length;
+    unsigned int hash = asHashElement(element, &length);
+    AmountSetNode node = asIndexFind(store, element, hash, length);
+    if (!node)
+        return 0;
+
+    AmountSetNode preceding_nodes[AS_MAX_LEVEL];
+    int ranks[AS_MAX_LEVEL];
+    asAmountFindPreceding(set->store, node->amount, node, preceding_nodes, ranks);
+    return ranks[0] + 1;
+}
+
+AmountSetResult asEnableJournal(AmountSet set, int capacity)
+{
+    if (!set || capacity < 0)
+        return AS_NULL_ARGUMENT;
+
+    long sequence = set->journal ? set->journal->sequence : 0;
+    AmountSetJournal new_journal = NULL;
+    if (capacity > 0)
+    {
+        new_journal = malloc(sizeof(*new_journal));
+        AmountSetJournalEntry *entries = calloc(capacity, sizeof(*entries));
+        if (!new_journal || !entries)
+        {
+            free(new_journal);
+            free(entries);
+            return AS_OUT_OF_MEMORY;
+        }
+
+        new_journal->entries = entries;
+        new_journal->capacity = capacity;
+        new_journal->sequence = sequence;
+        new_journal->first_sequence = sequence + 1;
+    }
+
+    asJournalDestroy(set->journal);
+    set->journal = new_journal;
+    return AS_SUCCESS;
+}
+
+long asGetSequence(AmountSet set)
+{
+    if (!set)
+        return -1;
+
+    return set->journal ? set->journal->sequence : 0;
+}
+
+AmountSetResult asReadChangesSince(AmountSet set, long sequence, AmountSetChangeVisitor visitor, void *context)
+{
+    if (!set || !visitor)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetJournal journal = set->journal;
+    if (!journal)
+        return AS_JOURNAL_OVERFLOW;
+
+    long oldest = journal->sequence - journal->capacity + 1;
+    if (oldest < journal->first_sequence)
+        oldest = journal->first_sequence;
+
+    if (sequence < oldest - 1 || sequence > journal->sequence)
+        return AS_JOURNAL_OVERFLOW;
+
+    for (long current = sequence + 1; current <= journal->sequence; current++)
+    {
+        if (!visitor(&journal->entries[current % journal->capacity].change, context))
+            break;
+    }
+
+    return AS_SUCCESS;
+}
+
+AmountSetResult asApplyChanges(AmountSet set, const AmountSetChange *changes, int count)
+{
+    if (!set || !changes || count < 0)
+        return AS_NULL_ARGUMENT;
+
+    for (int i = 0; i < count; i++)
+    {
+        AmountSetResult operation_result = AS_SUCCESS;
+        switch (changes[i].type)
+        {
+        case AS_CHANGE_REGISTER:
+            operation_result = asRegister(set, changes[i].element);
+            break;
+        case AS_CHANGE_AMOUNT:
+            operation_result = asChangeAmount(set, changes[i].element, changes[i].amount);
+            break;
+        case AS_CHANGE_DELETE:
+            operation_result = asDelete(set, changes[i].element);
+            break;
+        case AS_CHANGE_CLEAR:
+            operation_result = asClear(set);
+            break;
+        }
+
+        if (operation_result != AS_SUCCESS)
+            return operation_result;
+    }
+
+    return AS_SUCCESS;
+}
+
+AmountSetResult asGetStats(AmountSet set, AmountSetStats *outStats)
+{
+    if (!set || !outStats)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetStore store = set->store;
+    memset(outStats, 0, sizeof(*outStats));
+#ifdef AS_STATS
+    // Counters are read one by one, a copy used by another thread may change them in between
+    const AmountSetStats *counters = &store->stats;
+    outStats->counting = true;
+    outStats->registers = __atomic_load_n(&counters->registers, __ATOMIC_RELAXED);
+    outStats->changes = __atomic_load_n(&counters->changes, __ATOMIC_RELAXED);
+    outStats->upserts = __atomic_load_n(&counters->upserts, __ATOMIC_RELAXED);
+    outStats->deletes = __atomic_load_n(&counters->deletes, __ATOMIC_RELAXED);
+    outStats->lookups = __atomic_load_n(&counters->lookups, __ATOMIC_RELAXED);
+    outStats->range_queries = __atomic_load_n(&counters->range_queries, __ATOMIC_RELAXED);
+    outStats->searches = __atomic_load_n(&counters->searches, __ATOMIC_RELAXED);
+    outStats->nodes_visited = __atomic_load_n(&counters->nodes_visited, __ATOMIC_RELAXED);
+    outStats->max_nodes_visited = __atomic_load_n(&counters->max_nodes_visited, __ATOMIC_RELAXED);
+    outStats->string_comparisons = __atomic_load_n(&counters->string_comparisons, __ATOMIC_RELAXED);
+    outStats->index_searches = __atomic_load_n(&counters->index_searches, __ATOMIC_RELAXED);
+    outStats->index_probes = __atomic_load_n(&counters->index_probes, __ATOMIC_RELAXED);
+    outStats->max_index_probes = __atomic_load_n(&counters->max_index_probes, __ATOMIC_RELAXED);
+    outStats->node_allocations = __atomic_load_n(&counters->node_allocations, __ATOMIC_RELAXED);
+    outStats->node_frees = __atomic_load_n(&counters->node_frees, __ATOMIC_RELAXED);
+    outStats->filter_rejects = __atomic_load_n(&counters->filter_rejects, __ATOMIC_RELAXED);
+    if (outStats->searches > 0)
+        outStats->average_nodes_visited = (double)outStats->nodes_visited / outStats->searches;
+#endif
+
+    for (AmountSetBlock block = store->arena.blocks; block != NULL; block = block->next)
+        outStats->blocks++;
+
+    outStats->memory_bytes = sizeof(*set) + asStoreMemory(store);
+    if (set->journal)
+    {
+        outStats->memory_bytes += sizeof(*set->journal) + set->journal->capacity * sizeof(*set->journal->entries);
+        for (int i = 0; i < set->journal->capacity; i++)
+            outStats->memory_bytes += set->journal->entries[i].element_capacity;
+    }
+
+    if (set->filter)
+        outStats->memory_bytes += sizeof(*set->filter) + set->filter->block_count * AS_FILTER_BLOCK_WORDS * sizeof(uint64_t);
+
+    outStats->memory_bytes += set->handles_capacity * sizeof(*set->handles);
+    for (int i = 0; i < set->handles_capacity; i++)
+    {
+        for (AmountSetHandle handle = set->handles[i]; handle != NULL; handle = handle->next)
+            outStats->memory_bytes += sizeof(*handle) + handle->length + 1;
+    }
+
+    outStats->mapped_bytes = store->array.mapped_size;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asEnableFilter(AmountSet set, double falsePositiveRate)
+{
+    // Written to also reject NaN
+    if (!set || !(falsePositiveRate >= 0 && falsePositiveRate < 1))
+        return AS_NULL_ARGUMENT;
+
+    AmountSetFilter new_filter = NULL;
+    if (falsePositiveRate > 0)
+    {
+        new_filter = asFilterBuild(set->store, falsePositiveRate);
+        if (!new_filter)
+            return AS_OUT_OF_MEMORY;
+    }
+
+    asFilterDestroy(set->filter);
+    set->filter = new_filter;
+    return AS_SUCCESS;
+}
+
+AmountSetHandle asFindHandle(AmountSet set, const char *element)
+{
+    if (!set || !element || !asContains(set, element))
+        return NULL;
+
+    size_t length;
+    unsigned int hash = asHashElement(element, &length);
+    for (AmountSetHandle handle = set->handles ? set->handles[hash & (set->handles_capacity - 1)] : NULL;
+         handle != NULL; handle = handle->next)
+    {
+        if (handle->hash == hash && handle->length == length && memcmp(handle->element, element, length) == 0)
+            return handle;
+    }
+
+    if (set->handles_count >= set->handles_capacity && asHandlesGrow(set) != AS_SUCCESS)
+        return NULL;
+
+    AmountSetHandle new_handle = malloc(sizeof(*new_handle));
+    char *element_copy = malloc(length + 1);
+    if (!new_handle || !element_copy)
+    {
+        free(new_handle);
+        free(element_copy);
+        return NULL;
+    }
+
+    memcpy(element_copy, element, length + 1);
+    AmountSetHandle *chain = &set->handles[hash & (set->handles_capacity - 1)];
+    new_handle->set = set;
+    new_handle->next = *chain;
+    new_handle->element = element_copy;
+    new_handle->length = length;
+    new_handle->hash = hash;
+    new_handle->serial = 0; // No store has serial 0, the element is found on first use
+    new_handle->generation = 0;
+    new_handle->moves = 0;
+    new_handle->node = NULL;
+    new_handle->position = -1;
+    *chain = new_handle;
+    set->handles_count++;
+    return new_handle;
+}
+
+void asHandleRelease(AmountSetHandle handle)
+{
+    if (!handle)
+        return;
+
+    AmountSet set = handle->set;
+    AmountSetHandle *link = &set->handles[handle->hash & (set->handles_capacity - 1)];
+    while (*link != handle)
+        link = &(*link)->next;
+
+    *link = handle->next;
+    set->handles_count--;
+    free(handle->element);
+    free(handle);
+}
+
+AmountSetResult asHandleGetAmount(AmountSetHandle handle, double *outAmount)
+{
+    if (!handle || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    if (!asHandleResolve(handle))
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    *outAmount = handle->node ? handle->node->amount : handle->set->store->array.amounts[handle->position];
+    return AS_SUCCESS;
+}
+
+AmountSetResult asHandleChangeAmount(AmountSetHandle handle, double amount)
+{
+    if (!handle)
+        return AS_NULL_ARGUMENT;
+
+    AmountSet set = handle->set;
+    AS_STATS_ADD(set->store, changes, 1);
+    AmountSetResult frozen_result = asFrozenCheck(set, AS_CHANGE_AMOUNT, handle->element, amount, false);
+    if (frozen_result != AS_SUCCESS)
+        return frozen_result;
+
+    if (asThaw(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    if (!asHandleResolve(handle))
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    double current = handle->node ? handle->node->amount : set->store->array.amounts[handle->position];
+    if (current + amount < 0)
+        return AS_INSUFFICIENT_AMOUNT;
+
+    // The store may be copied, the handle then finds its element in the copy
+    if (asPrepareWrite(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    asHandleResolve(handle);
+    if (handle->node)
+    {
+        asAmountIndexUpdate(set->store, handle->node, current + amount);
+    }
+    else
+    {
+        set->store->array.amounts[handle->position] = current + amount;
+        asSmallOrder(set->store);
+    }
+
+    asRecordChange(set, AS_CHANGE_AMOUNT, handle->element, handle->length, amount);
+    return AS_SUCCESS;
+}
+
+double asCombineSum(double firstAmount, double secondAmount)
+{
+    return firstAmount + secondAmount;
+}
+
+double asCombineMin(double firstAmount, double secondAmount)
+{
+    return firstAmount < secondAmount ? firstAmount : secondAmount;
+}
+
+double asCombineMax(double firstAmount, double secondAmount)
+{
+    return firstAmount > secondAmount ? firstAmount : secondAmount;
+}
+
+static AmountSetStore asStoreCreate()
+{
+    AmountSetStore store = malloc(sizeof(*store));
+    if (!store)
+        return NULL;
+
+    store->header = malloc(asNodeSize(AS_MAX_LEVEL, 0));
+    store->index = calloc(AS_INDEX_INITIAL_CAPACITY, sizeof(*store->index));
+    if (!store->header || !store->index)
+    {
+        free(store->header);
+        free(store->index);
+        free(store);
+        return NULL;
+    }
+
+    store->header->level = AS_MAX_LEVEL;
+    for (int level = 0; level < AS_MAX_LEVEL; level++)
+    {
+        store->header->next[level] = NULL;
+        asNodeByAmount(store->header)[level] = NULL;
+        asNodeSpans(store->header)[level] = 0;
+    }
+
+    store->references = 1;
+    store->size = 0;
+    store->level = 1;
+    store->random_state = AS_RANDOM_SEED;
+    store->index_capacity = AS_INDEX_INITIAL_CAPACITY;
+    store->index_used = 0;
+    store->arena.blocks = NULL;
+    store->arena.next_block_size = AS_ARENA_INITIAL_BLOCK_SIZE;
+    memset(store->arena.free_lists, 0, sizeof(store->arena.free_lists));
+    memset(&store->array, 0, sizeof(store->array));
+    for (int level = 0; level < AS_MAX_LEVEL; level++)
+        store->finger[level] = store->header;
+
+    store->finger_hits = 0;
+    store->finger_misses = 0;
+    store->serial = __atomic_add_fetch(&as_store_serial, 1, __ATOMIC_RELAXED);
+    store->moves = 0;
+    memset(&store->aggregate, 0, sizeof(store->aggregate));
+    store->amount_last = store->header;
+#ifdef AS_STATS
+    memset(&store->stats, 0, sizeof(store->stats));
+#endif
+    return store;
+}
+
+static AmountSetStore asStoreCreateSmall(size_t blob_capacity)
+{
+    AmountSetStore store = malloc(sizeof(*store));
+    if (!store)
+        return NULL;
+
+    // A small store has no header, index or arena
+    memset(store, 0, sizeof(*store));
+    if (blob_capacity < AS_SMALL_INITIAL_BLOB_SIZE)
+        blob_capacity = AS_SMALL_INITIAL_BLOB_SIZE;
+
+    store->array.memory = malloc(asArraySize(AS_SMALL_CAPACITY, blob_capacity));
+    if (!store->array.memory)
+    {
+        free(store);
+        return NULL;
+    }
+
+    asArrayLayout(&store->array, store->array.memory, AS_SMALL_CAPACITY);
+    store->array.capacity = AS_SMALL_CAPACITY;
+    store->array.blob_capacity = blob_capacity;
+    store->array.offsets[0] = 0;
+    store->references = 1;
+    store->level = 1;
+    store->random_state = AS_RANDOM_SEED;
+    store->arena.next_block_size = AS_ARENA_INITIAL_BLOCK_SIZE;
+    store->serial = __atomic_add_fetch(&as_store_serial, 1, __ATOMIC_RELAXED);
+    return store;
+}
+
+static bool asStoreIsFrozen(AmountSetStore store)
+{
+    return store->array.memory && store->array.capacity == 0;
+}
+
+static bool asStoreIsSmall(AmountSetStore store)
+{
+    return store->array.capacity > 0;
+}
+
+static AmountSet asCreateFromStore(AmountSetStore store)
+{
+    AmountSet new_set = store ? malloc(sizeof(*new_set)) : NULL;
+    if (!new_set)
+    {
+        asStoreRelease(store);
+        return NULL;
+    }
+
+    new_set->store = store;
+    new_set->current_node = NULL;
+    new_set->current_position = -1;
+    new_set->journal = NULL;
+    new_set->filter = NULL;
+    new_set->handles = NULL;
+    new_set->handles_capacity = 0;
+    new_set->handles_count = 0;
+    return new_set;
+}
+
+static AmountSetStore asStoreClone(AmountSetStore store, AmountSetNode *cursor)
+{
+    if (asStoreIsSmall(store))
+    {
+        // Positions are kept, so the internal iterator needs no moving
+        AmountSetStore new_store = asStoreCreateSmall(store->array.blob_capacity);
+        if (!new_store)
+            return NULL;
+
+        memcpy(new_store->array.memory, store->array.memory,
+               asArraySize(AS_SMALL_CAPACITY, store->array.blob_capacity));
+        new_store->size = store->size;
+        new_store->aggregate = store->aggregate;
+        asStoreCopyStats(new_store, store);
+        return new_store;
+    }
+
+    AmountSetStore new_store = asStoreCreate();
+    if (!new_store)
+        return NULL;
+
+    // Counted before the copying, so that its work adds to the counters
+    asStoreCopyStats(new_store, store);
+    if (asIndexReserve(new_store, store->size) != AS_SUCCESS)
+    {
+        asStoreRelease(new_store);
+        return NULL;
+    }
+
+    AmountSetNode last_nodes[AS_MAX_LEVEL];
+    for (int level = 0; level < AS_MAX_LEVEL; level++)
+        last_nodes[level] = new_store->header;
+
+    for (AmountSetNode node = store->header->next[0]; node != NULL; node = node->next[0])
+    {
+        if (asAppendNode(new_store, last_nodes, asNodeElement(node), node->length,
+                         node->hash, node->amount) != AS_SUCCESS)
+        {
+            asStoreRelease(new_store);
+            return NULL;
+        }
+
+        if (node == *cursor)
+            *cursor = last_nodes[0];
+    }
+
+    // The copy's amount order is the same, so it needs no sorting
+    AmountSetNode *ordered = malloc((store->size + 1) * sizeof(*ordered));
+    if (!ordered)
+    {
+        asStoreRelease(new_store);
+        return NULL;
+    }
+
+    int count = 0;
+    for (AmountSetNode node = asNodeByAmount(store->header)[0]; node != NULL; node = asNodeByAmount(node)[0])
+        ordered[count++] = asIndexFind(new_store, asNodeElement(node), node->hash, node->length);
+
+    asAmountIndexBuild(new_store, ordered);
+    free(ordered);
+    return new_store;
+}
+
+static void asStoreRelease(AmountSetStore store)
+{
+    if (!store || __atomic_sub_fetch(&store->references, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
+    AmountSetBlock block = store->arena.blocks;
+    while (block != NULL)
+    {
+        AmountSetBlock next_block = block->next;
+        free(block);
+        block = next_block;
+    }
+
+    asArrayRelease(&store->array);
+    free(store->header);
+    free(store->index);
+    free(store);
+}
+
+static AmountSetResult asPrepareWrite(AmountSet set)
+{
+    AmountSetStore store = set->store;
+    if (__atomic_load_n(&store->references, __ATOMIC_ACQUIRE) == 1)
+        return AS_SUCCESS;
+
+    AmountSetNode cursor = set->current_node;
+    AmountSetStore new_store = asStoreClone(store, &cursor);
+    if (!new_store)
+        return AS_OUT_OF_MEMORY;
+
+    asStoreRelease(store);
+    set->store = new_store;
+    set->current_node = cursor;
+    return AS_SUCCESS;
+}
+
+static size_t asNodeSize(int level, size_t length)
+{
+    size_t size = sizeof(struct AmountSetNode_t) + 2 * level * sizeof(AmountSetNode) + level * sizeof(int) + length + 1;
+    return (size + AS_ARENA_ALIGNMENT - 1) / AS_ARENA_ALIGNMENT * AS_ARENA_ALIGNMENT;
+}
+
+static char *asNodeElement(AmountSetNode node)
+{
+    return (char *)(asNodeSpans(node) + node->level);
+}
+
+static AmountSetNode *asNodeByAmount(AmountSetNode node)
+{
+    return node->next + node->level;
+}
+
+static int *asNodeSpans(AmountSetNode node)
+{
+    return (int *)(node->next + 2 * node->level);
+}
+
+static AmountSetNode asCreateNode(AmountSetStore store, int level, const char *element, size_t length)
+{
+    // A reused node keeps its generation, so that handles to the freed node don't take the new one for it
+    size_t size = asNodeSize(level, length);
+    bool reused = size / AS_ARENA_ALIGNMENT < AS_ARENA_SIZE_CLASSES &&
+                  store->arena.free_lists[size / AS_ARENA_ALIGNMENT] != NULL;
+    AmountSetNode node = asArenaAllocate(&store->arena, size);
+    if (!node)
+        return NULL;
+
+    if (!reused)
+        node->generation = 0;
+
+    AS_STATS_ADD(store, node_allocations, 1);
+    node->amount = 0;
+    node->length = length;
+    node->level = level;
+    asElementPrefix(element, length, node->prefix);
+    memcpy(asNodeElement(node), element, length + 1);
+    return node;
+}
+
+static void asFreeNode(AmountSetStore store, AmountSetNode node)
+{
+    if (!node)
+        return;
+
+    AS_STATS_ADD(store, node_frees, 1);
+    node->generation++;
+    size_t size_class = asNodeSize(node->level, node->length) / AS_ARENA_ALIGNMENT;
+    if (size_class >= AS_ARENA_SIZE_CLASSES)
+        return;
+
+    // The first forward pointer links the free list
+    node->next[0] = store->arena.free_lists[size_class];
+    store->arena.free_lists[size_class] = node;
+}
+
+static AmountSetResult asInsertNode(AmountSetStore store, const char *element, size_t length,
+                                    unsigned int hash, double amount)
+{
+    int level = asRandomLevel(store);
+    AmountSetNode new_node = asCreateNode(store, level, element, length);
+    if (!new_node)
+        return AS_OUT_OF_MEMORY;
+
+    new_node->hash = hash;
+    new_node->amount = amount;
+    if (asIndexInsert(store, new_node) != AS_SUCCESS)
+    {
+        asFreeNode(store, new_node);
+        return AS_OUT_OF_MEMORY;
+    }
+
+    AmountSetNode preceding_nodes[AS_MAX_LEVEL];
+    asFindPrecedingNodes(store, element, length, preceding_nodes);
+    for (; store->level < level; store->level++)
+        preceding_nodes[store->level] = store->header;
+
+    for (int i = 0; i < level; i++)
+    {
+        new_node->next[i] = preceding_nodes[i]->next[i];
+        preceding_nodes[i]->next[i] = new_node;
+    }
+
+    asAmountIndexInsert(store, new_node);
+    store->size++;
+    return AS_SUCCESS;
+}
+
+static AmountSetResult asAppendNode(AmountSetStore store, AmountSetNode *last_nodes, const char *element,
+                                    size_t length, unsigned int hash, double amount)
+{
+    int level = asRandomLevel(store);
+    AmountSetNode new_node = asCreateNode(store, level, element, length);
+    if (!new_node)
+        return AS_OUT_OF_MEMORY;
+
+    new_node->hash = hash;
+    new_node->amount = amount;
+    if (asIndexInsert(store, new_node) != AS_SUCCESS)
+    {
+        asFreeNode(store, new_node);
+        return AS_OUT_OF_MEMORY;
+    }
+
+    if (level > store->level)
+        store->level = level;
+
+    for (int i = 0; i < level; i++)
+    {
+        new_node->next[i] = NULL;
+        last_nodes[i]->next[i] = new_node;
+        last_nodes[i] = new_node;
+    }
+
+    store->size++;
+    return AS_SUCCESS;
+}
+
+static void *asArenaAllocate(AmountSetArena *arena, size_t size)
+{
+    size_t size_class = size / AS_ARENA_ALIGNMENT;
+    if (size_class < AS_ARENA_SIZE_CLASSES && arena->free_lists[size_class] != NULL)
+    {
+        AmountSetNode node = arena->free_lists[size_class];
+        arena->free_lists[size_class] = node->next[0];
+        return node;
+    }
+
+    AmountSetBlock block = arena->blocks;
+    if (block == NULL || block->capacity - block->used < size)
+    {
+        size_t capacity = arena->next_block_size;
+        if (capacity < size)
+            capacity = size;
+
+        block = malloc(sizeof(*block) + capacity);
+        if (!block)
+            return NULL;
+
+        block->next = arena->blocks;
+        block->capacity = capacity;
+        block->used = 0;
+        arena->blocks = block;
+        if (arena->next_block_size < AS_ARENA_MAX_BLOCK_SIZE)
+            arena->next_block_size *= 2;
+    }
+
+    void *allocation = (char *)block->data + block->used;
+    block->used += size;
+    return allocation;
+}
+
+static unsigned int asHashElement(const char *element, size_t *out_length)
+{
+    unsigned int hash = AS_FNV_OFFSET_BASIS;
+    const unsigned char *current = (const unsigned char *)element;
+    while (*current)
+    {
+        hash ^= *current++;
+        hash *= AS_FNV_PRIME;
+    }
+
+    *out_length = current - (const unsigned char *)element;
+    return hash;
+}
+
+static AmountSetNode asIndexFind(AmountSetStore store, const char *element, unsigned int hash, size_t length)
+{
+    unsigned int mask = store->index_capacity - 1;
+    long probes = 1;
+    for (unsigned int position = hash & mask;; position = (position + 1) & mask, probes++)
+    {
+        AmountSetSlot *slot = &store->index[position];
+        if (slot->node == NULL ||
+            (slot->hash == hash && slot->node != AS_TOMBSTONE &&
+             slot->node->length == length && memcmp(asNodeElement(slot->node), element, length) == 0))
+        {
+            AS_STATS_ADD(store, index_searches, 1);
+            AS_STATS_ADD(store, index_probes, probes);
+            AS_STATS_MAX(store, max_index_probes, probes);
+            return slot->node;
+        }
+    }
+}
+
+static AmountSetResult asIndexInsert(AmountSetStore store, AmountSetNode node)
+{
+    // Keep the index at most half full (including tombstones) so probe sequences stay short
+    if ((store->index_used + 1) * 2 > store->index_capacity)
+    {
+        int capacity = store->index_capacity;
+        if ((store->size + 1) * 2 > capacity / 2)
+            capacity *= 2;
+
+        if (asIndexResize(store, capacity) != AS_SUCCESS)
+            return AS_OUT_OF_MEMORY;
+    }
+
+    unsigned int mask = store->index_capacity - 1;
+    unsigned int position = node->hash & mask;
+    while (store->index[position].node != NULL && store->index[position].node != AS_TOMBSTONE)
+        position = (position + 1) & mask;
+
+    if (store->index[position].node == NULL)
+        store->index_used++;
+
+    store->index[position].hash = node->hash;
+    store->index[position].node = node;
+    return AS_SUCCESS;
+}
+
+static void asIndexRemove(AmountSetStore store, AmountSetNode node)
+{
+    unsigned int mask = store->index_capacity - 1;
+    unsigned int position = node->hash & mask;
+    while (store->index[position].node != node)
+    {
+        assert(store->index[position].node != NULL);
+        position = (position + 1) & mask;
+    }
+
+    store->index[position].node = AS_TOMBSTONE;
+}
+
+static AmountSetResult asIndexReserve(AmountSetStore store, int size)
+{
+    int capacity = store->index_capacity;
+    while ((size + 1) * 2 > capacity)
+        capacity *= 2;
+
+    if (capacity == store->index_capacity)
+        return AS_SUCCESS;
+
+    return asIndexResize(store, capacity);
+}
+
+static void asElementPrefix(const char *element, size_t length, uint64_t *prefix)
+{
+    for (int word = 0; word < AS_PREFIX_WORDS; word++)
+    {
+        uint64_t packed = 0;
+        for (size_t i = word * sizeof(uint64_t); i < (word + 1) * sizeof(uint64_t); i++)
+            packed = (packed << 8) | (i < length ? (unsigned char)element[i] : 0);
+
+        prefix[word] = packed;
+    }
+}
+
+static int asCompareNode(AmountSetNode node, const char *element, size_t length, const uint64_t *prefix)
+{
+    for (int word = 0; word < AS_PREFIX_WORDS; word++)
+    {
+        if (node->prefix[word] != prefix[word])
+            return node->prefix[word] < prefix[word] ? -1 : 1;
+    }
+
+    // Equal prefixes of a short element mean both end at the same character
+    if (node->length < AS_PREFIX_LENGTH)
+        return 0;
+
+    // Elements contain no '\0', so comparing the terminator of the shorter one orders them like strcmp
+    size_t compare_length = (node->length < length ? node->length : length) + 1 - AS_PREFIX_LENGTH;
+    return memcmp(asNodeElement(node) + AS_PREFIX_LENGTH, element + AS_PREFIX_LENGTH, compare_length);
+}
+
+static int asSearchCompare(AmountSetStore store, AmountSetNode node, const char *element, size_t length,
+                           const uint64_t *prefix, long *visited)
+{
+    (*visited)++;
+#ifdef AS_STATS
+    if (node->length >= AS_PREFIX_LENGTH && memcmp(node->prefix, prefix, sizeof(node->prefix)) == 0)
+        AS_STATS_ADD(store, string_comparisons, 1);
+#else
+    (void)store;
+#endif
+
+    return asCompareNode(node, element, length, prefix);
+}
+
+static int asComparePairs(const void *first, const void *second)
+{
+    return strcmp(((const AmountSetPair *)first)->element, ((const AmountSetPair *)second)->element);
+}
+
+static AmountSetResult asIndexResize(AmountSetStore store, int capacity)
+{
+    AmountSetSlot *new_index = calloc(capacity, sizeof(*new_index));
+    if (!new_index)
+        return AS_OUT_OF_MEMORY;
+
+    unsigned int mask = capacity - 1;
+    for (AmountSetNode node = store->header->next[0]; node != NULL; node = node->next[0])
+    {
+        unsigned int position = node->hash & mask;
+        while (new_index[position].node != NULL)
+            position = (position + 1) & mask;
+
+        new_index[position].hash = node->hash;
+        new_index[position].node = node;
+    }
+
+    free(store->index);
+    store->index = new_index;
+    store->index_capacity = capacity;
+    store->index_used = store->size;
+    return AS_SUCCESS;
+}
+
+static int asRandomLevel(AmountSetStore store)
+{
+    // xorshift32, one draw supplies all the coin flips needed for AS_MAX_LEVEL levels
+    unsigned int random = store->random_state;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    store->random_state = random;
+
+    int level = 1;
+    while (level < AS_MAX_LEVEL && (random & AS_LEVEL_MASK) == 0)
+    {
+        level++;
+        random >>= 2;
+    }
+
+    return level;
+}
+
+static AmountSetNode asFindLowerBound(AmountSetStore store, const char *element)
+{
+    if (!element)
+        return store->header->next[0];
+
+    size_t length = strlen(element);
+    uint64_t prefix[AS_PREFIX_WORDS];
+    asElementPrefix(element, length, prefix);
+
+    AmountSetNode node = store->header;
+    long visited = 0;
+    for (int level = store->level - 1; level >= 0; level--)
+    {
+        while (node->next[level] != NULL &&
+               asSearchCompare(store, node->next[level], element, length, prefix, &visited) < 0)
+            node = node->next[level];
+    }
+
+    asStatsSearch(store, visited);
+    return node->next[0];
+}
+
+static void asFindPrecedingNodes(AmountSetStore store, const char *element, size_t length,
+                                 AmountSetNode *preceding_nodes)
+{
+    uint64_t prefix[AS_PREFIX_WORDS];
+    asElementPrefix(element, length, prefix);
+
+    AmountSetNode *finger = store->finger;
+    AmountSetNode node = store->header;
+    int top_level = store->level - 1;
+    long visited = 0;
+    if (finger[0] == store->header || asSearchCompare(store, finger[0], element, length, prefix, &visited) < 0)
+    {
+        // The finger's nodes precede the element on every level, climb while they are too far behind
+        top_level = 0;
+        while (top_level + 1 < store->level && finger[top_level + 1]->next[top_level + 1] != NULL &&
+               asSearchCompare(store, finger[top_level + 1]->next[top_level + 1], element, length, prefix,
+                               &visited) < 0)
+            top_level++;
+
+        node = finger[top_level];
+        // A finger at the header searches from the first element, as a miss does
+        if (finger[0] == store->header)
+            store->finger_misses++;
+        else
+            store->finger_hits++;
+    }
+    else
+        store->finger_misses++;
+
+    for (int level = AS_MAX_LEVEL - 1; level > top_level; level--)
+        preceding_nodes[level] = level < store->level ? finger[level] : store->header;
+
+    for (int level = top_level; level >= 0; level--)
+    {
+        while (node->next[level] != NULL &&
+               asSearchCompare(store, node->next[level], element, length, prefix, &visited) < 0)
+            node = node->next[level];
+
+        preceding_nodes[level] = node;
+    }
+
+    asStatsSearch(store, visited);
+    memcpy(finger, preceding_nodes, sizeof(store->finger));
+}
+
+static AmountSetResult asCombineSets(AmountSet first, AmountSet second, AmountSetCombiner combine,
+                                     int keep, AmountSet *outSet)
+{
+    int result_size = first->store->size;
+    if (keep & AS_KEEP_SECOND_ONLY)
+        result_size += second->store->size;
+    else if (!(keep & AS_KEEP_FIRST_ONLY) && second->store->size < result_size)
+        result_size = second->store->size;
+
+    AmountSet new_set = asCreateFromStore(asStoreCreate());
+    AmountSetResult operation_result = new_set ? asIndexReserve(new_set->store, result_size) : AS_OUT_OF_MEMORY;
+
+    AmountSetNode last_nodes[AS_MAX_LEVEL];
+    for (int level = 0; new_set && level < AS_MAX_LEVEL; level++)
+        last_nodes[level] = new_set->store->header;
+
+    AmountSetCursor first_cursor, second_cursor;
+    asCursorLowerBound(first->store, NULL, &first_cursor);
+    asCursorLowerBound(second->store, NULL, &second_cursor);
+    while (operation_result == AS_SUCCESS && (asCursorValid(&first_cursor) || asCursorValid(&second_cursor)))
+    {
+        AmountSetNode first_node = first_cursor.node, second_node = second_cursor.node;
+        int compare_result;
+        if (!asCursorValid(&first_cursor))
+            compare_result = 1;
+        else if (!asCursorValid(&second_cursor))
+            compare_result = -1;
+        else if (first_node && second_node)
+            compare_result = asCompareNode(first_node, asNodeElement(second_node), second_node->length,
+                                           second_node->prefix);
+        else
+            compare_result = strcmp(asCursorElement(&first_cursor, NULL), asCursorElement(&second_cursor, NULL));
+
+        AmountSetCursor *cursor = compare_result <= 0 ? &first_cursor : &second_cursor;
+        size_t length;
+        char *element = asCursorElement(cursor, &length);
+        // Both sets hash elements the same way, so a stored hash is reused
+        unsigned int hash = cursor->node ? cursor->node->hash : 0;
+        double amount = asCursorAmount(cursor);
+        bool kept = (compare_result < 0 && (keep & AS_KEEP_FIRST_ONLY)) ||
+                    (compare_result > 0 && (keep & AS_KEEP_SECOND_ONLY)) ||
+                    (compare_result == 0 && (keep & AS_KEEP_BOTH));
+
+        if (compare_result == 0 && combine)
+            amount = combine(asCursorAmount(&first_cursor), asCursorAmount(&second_cursor));
+
+        if (compare_result <= 0)
+            asCursorNext(&first_cursor);
+        if (compare_result >= 0)
+            asCursorNext(&second_cursor);
+
+        if (!kept)
+            continue;
+
+        if (amount < 0)
+        {
+            operation_result = AS_INSUFFICIENT_AMOUNT;
+            break;
+        }
+
+        if (!cursor->node)
+            hash = asHashElement(element, &length);
+
+        operation_result = asAppendNode(new_set->store, last_nodes, element, length, hash, amount);
+    }
+
+    if (operation_result == AS_SUCCESS)
+        operation_result = asAmountIndexBuild(new_set->store, NULL);
+
+    if (operation_result != AS_SUCCESS)
+    {
+        asDestroy(new_set);
+        return operation_result;
+    }
+
+    asShrink(new_set);
+    if (outSet)
+    {
+        *outSet = new_set;
+        return AS_SUCCESS;
+    }
+
+    // Hand the new elements to the first set, and the old ones to the new set for freeing
+    AmountSetStore old_store = first->store;
+    asStoreCopyStats(new_set->store, old_store);
+    first->store = new_set->store;
+    first->current_node = NULL;
+    first->current_position = -1;
+    new_set->store = old_store;
+    asDestroy(new_set);
+    asRecordReset(first);
+    return AS_SUCCESS;
+}
+
+static bool asAmountPrecedes(AmountSetNode candidate, double amount, AmountSetNode node)
+{
+    if (candidate->amount != amount)
+        return candidate->amount > amount;
+
+    return asCompareNode(candidate, asNodeElement(node), node->length, node->prefix) < 0;
+}
+
+static void asAmountFindPreceding(AmountSetStore store, double amount, AmountSetNode node,
+                                  AmountSetNode *preceding_nodes, int *ranks)
+{
+    AmountSetNode current = store->header;
+    int rank = 0;
+    long visited = 0;
+    for (int level = AS_MAX_LEVEL - 1; level >= 0; level--)
+    {
+        while (level < store->level && asNodeByAmount(current)[level] != NULL)
+        {
+            visited++;
+            if (!asAmountPrecedes(asNodeByAmount(current)[level], amount, node))
+                break;
+
+            rank += asNodeSpans(current)[level];
+            current = asNodeByAmount(current)[level];
+        }
+
+        preceding_nodes[level] = current;
+        if (ranks)
+            ranks[level] = rank;
+    }
+
+    asStatsSearch(store, visited);
+}
+
+static void asAmountIndexInsert(AmountSetStore store, AmountSetNode node)
+{
+    AmountSetNode preceding_nodes[AS_MAX_LEVEL];
+    int ranks[AS_MAX_LEVEL];
+    asAmountFindPreceding(store, node->amount, node, preceding_nodes, ranks);
+
+    for (int level = 0; level < AS_MAX_LEVEL; level++)
+    {
+        int *preceding_spans = asNodeSpans(preceding_nodes[level]);
+        if (level >= node->level)
+        {
+            preceding_spans[level]++;
+            continue;
+        }
+
+        // The node splits the preceding node's span at its own rank
+        asNodeByAmount(node)[level] = asNodeByAmount(preceding_nodes[level])[level];
+        asNodeByAmount(preceding_nodes[level])[level] = node;
+        asNodeSpans(node)[level] = preceding_spans[level] - (ranks[0] - ranks[level]);
+        preceding_spans[level] = ranks[0] - ranks[level] + 1;
+    }
+
+    if (asNodeByAmount(node)[0] == NULL)
+        store->amount_last = node;
+
+    asAggregateChange(&store->aggregate, 0, node->amount);
+}
+
+static void asAmountIndexRemove(AmountSetStore store, AmountSetNode node, AmountSetNode *preceding_nodes)
+{
+    if (asNodeByAmount(node)[0] == NULL)
+        store->amount_last = preceding_nodes[0];
+
+    asAggregateChange(&store->aggregate, node->amount, 0);
+    for (int level = 0; level < AS_MAX_LEVEL; level++)
+    {
+        int *preceding_spans = asNodeSpans(preceding_nodes[level]);
+        if (asNodeByAmount(preceding_nodes[level])[level] != node)
+        {
+            preceding_spans[level]--;
+            continue;
+        }
+
+        preceding_spans[level] += asNodeSpans(node)[level] - 1;
+        asNodeByAmount(preceding_nodes[level])[level] = asNodeByAmount(node)[level];
+    }
+}
+
+static void asAmountIndexUpdate(AmountSetStore store, AmountSetNode node, double amount)
+{
+    if (amount == node->amount)
+        return;
+
+    AmountSetNode preceding_nodes[AS_MAX_LEVEL];
+    asAmountFindPreceding(store, node->amount, node, preceding_nodes, NULL);
+
+    // Keep the node in place if it still falls between its neighbours
+    AmountSetNode previous = preceding_nodes[0];
+    AmountSetNode next = asNodeByAmount(node)[0];
+    if ((previous == store->header || asAmountPrecedes(previous, amount, node)) &&
+        (next == NULL || !asAmountPrecedes(next, amount, node)))
+    {
+        asAggregateChange(&store->aggregate, node->amount, amount);
+        node->amount = amount;
+        return;
+    }
+
+    asAmountIndexRemove(store, node, preceding_nodes);
+    node->amount = amount;
+    asAmountIndexInsert(store, node);
+}
+
+static AmountSetResult asAmountIndexBuild(AmountSetStore store, AmountSetNode *ordered)
+{
+    AmountSetNode *sorted = ordered;
+    if (!sorted)
+    {
+        sorted = malloc((store->size + 1) * sizeof(*sorted));
+        if (!sorted)
+            return AS_OUT_OF_MEMORY;
+
+        int count = 0;
+        for (AmountSetNode node = store->header->next[0]; node != NULL; node = node->next[0])
+            sorted[count++] = node;
+
+        qsort(sorted, store->size, sizeof(*sorted), asCompareByAmount);
+    }
+
+    AmountSetNode last_nodes[AS_MAX_LEVEL];
+    int last_ranks[AS_MAX_LEVEL];
+    for (int level = 0; level < AS_MAX_LEVEL; level++)
+    {
+        last_nodes[level] = store->header;
+        last_ranks[level] = 0;
+    }
+
+    memset(&store->aggregate, 0, sizeof(store->aggregate));
+    for (int rank = 1; rank <= store->size; rank++)
+    {
+        AmountSetNode node = sorted[rank - 1];
+        asAggregateChange(&store->aggregate, 0, node->amount);
+        for (int level = 0; level < node->level; level++)
+        {
+            asNodeByAmount(last_nodes[level])[level] = node;
+            asNodeSpans(last_nodes[level])[level] = rank - last_ranks[level];
+            last_nodes[level] = node;
+            last_ranks[level] = rank;
+        }
+    }
+
+    for (int level = 0; level < AS_MAX_LEVEL; level++)
+    {
+        asNodeByAmount(last_nodes[level])[level] = NULL;
+        asNodeSpans(last_nodes[level])[level] = store->size - last_ranks[level];
+    }
+
+    store->amount_last = last_nodes[0];
+    if (!ordered)
+        free(sorted);
+
+    return AS_SUCCESS;
+}
+
+static void asAmountIndexLinkAll(AmountSetStore store)
+{
+    if (asAmountIndexBuild(store, NULL) == AS_SUCCESS)
+        return;
+
+    for (AmountSetNode node = store->header->next[0]; node != NULL; node = node->next[0])
+        asAmountIndexInsert(store, node);
+}
+
+static int asCompareByAmount(const void *first, const void *second)
+{
+    AmountSetNode first_node = *(const AmountSetNode *)first;
+    AmountSetNode second_node = *(const AmountSetNode *)second;
+    if (first_node == second_node)
+        return 0;
+
+    return asAmountPrecedes(first_node, second_node->amount, second_node) ? -1 : 1;
+}
+
+static AmountSetStore asStoreFreeze(AmountSetStore store, bool small)
+{
+    size_t blob_size = 0;
+    AmountSetCursor cursor;
+    for (asCursorLowerBound(store, NULL, &cursor); asCursorValid(&cursor); asCursorNext(&cursor))
+    {
+        size_t length;
+        asCursorElement(&cursor, &length);
+        blob_size += length + 1;
+    }
+
+    AmountSetStore new_store = small ? asStoreCreateSmall(blob_size) : asStoreCreate();
+    if (!new_store)
+        return NULL;
+
+    asStoreCopyStats(new_store, store);
+    int size = store->size;
+    AmountSetArray *array = &new_store->array;
+    if (!small)
+    {
+        array->memory = malloc(asArraySize(size, blob_size));
+        if (!array->memory)
+        {
+            asStoreRelease(new_store);
+            return NULL;
+        }
+
+        asArrayLayout(array, array->memory, size);
+    }
+
+    int position = 0;
+    uint64_t offset = 0;
+    for (asCursorLowerBound(store, NULL, &cursor); asCursorValid(&cursor); asCursorNext(&cursor))
+    {
+        size_t length;
+        char *element = asCursorElement(&cursor, &length);
+        array->amounts[position] = asCursorAmount(&cursor);
+        array->offsets[position++] = offset;
+        memcpy(array->blob + offset, element, length + 1);
+        offset += length + 1;
+    }
+    array->offsets[size] = offset;
+    new_store->size = size;
+    new_store->aggregate = store->aggregate;
+
+    if (small)
+    {
+        asSmallOrder(new_store);
+        return new_store;
+    }
+
+    // Sorting the contiguous amounts is faster than searching for every node of the amount order
+    AmountSetRanked *ranked = malloc((size + 1) * sizeof(*ranked));
+    if (!ranked)
+    {
+        asStoreRelease(new_store);
+        return NULL;
+    }
+
+    for (int i = 0; i < size; i++)
+    {
+        ranked[i].amount = array->amounts[i];
+        ranked[i].position = i;
+    }
+
+    qsort(ranked, size, sizeof(*ranked), asCompareRanked);
+    for (int i = 0; i < size; i++)
+        array->by_amount[i] = ranked[i].position;
+
+    free(ranked);
+    return new_store;
+}
+
+static AmountSetStore asStoreThaw(AmountSetStore store, int position, AmountSetNode *cursor)
+{
+    *cursor = NULL;
+    AmountSetStore new_store = asStoreCreate();
+    AmountSetNode *nodes = malloc((store->size + 1) * sizeof(*nodes));
+    AmountSetNode *ordered = malloc((store->size + 1) * sizeof(*ordered));
+    if (new_store)
+        asStoreCopyStats(new_store, store);
+
+    bool failed = !new_store || !nodes || !ordered || asIndexReserve(new_store, store->size) != AS_SUCCESS;
+
+    AmountSetNode last_nodes[AS_MAX_LEVEL];
+    for (int level = 0; !failed && level < AS_MAX_LEVEL; level++)
+        last_nodes[level] = new_store->header;
+
+    for (int i = 0; !failed && i < store->size; i++)
+    {
+        char *element = asArrayElement(store, i);
+        size_t length;
+        unsigned int hash = asHashElement(element, &length);
+        failed = asAppendNode(new_store, last_nodes, element, length, hash, store->array.amounts[i]) != AS_SUCCESS;
+        nodes[i] = last_nodes[0];
+    }
+
+    if (failed)
+    {
+        asStoreRelease(new_store);
+        free(nodes);
+        free(ordered);
+        return NULL;
+    }
+
+    for (int i = 0; i < store->size; i++)
+        ordered[i] = nodes[store->array.by_amount[i]];
+
+    asAmountIndexBuild(new_store, ordered);
+    if (position >= 0)
+        *cursor = nodes[position];
+
+    free(nodes);
+    free(ordered);
+    return new_store;
+}
+
+static size_t asArraySize(size_t size, size_t blob_size)
+{
+    AmountSetArray array;
+    return size * sizeof(*array.amounts) + (size + 1) * sizeof(*array.offsets) +
+           size * sizeof(*array.by_amount) + blob_size;
+}
+
+static void asArrayLayout(AmountSetArray *array, void *memory, size_t size)
+{
+    array->amounts = memory;
+    array->offsets = (uint64_t *)(array->amounts + size);
+    array->by_amount = (uint32_t *)(array->offsets + size + 1);
+    array->blob = (char *)(array->by_amount + size);
+}
+
+static void asArrayRelease(AmountSetArray *array)
+{
+    if (array->mapped_size > 0)
+        munmap(array->memory, array->mapped_size);
+    else
+        free(array->memory);
+
+    memset(array, 0, sizeof(*array));
+}
+
+static uint64_t asChecksum(uint64_t checksum, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++)
+        checksum = (checksum ^ bytes[i]) * AS_FNV64_PRIME;
+
+    return checksum;
+}
+
+static AmountSetResult asCheckFile(const void *mapping, size_t file_size)
+{
+    const AmountSetFileHeader *header = mapping;
+    if (memcmp(header->magic, AS_FILE_MAGIC, AS_FILE_MAGIC_LENGTH) != 0 ||
+        header->byte_order != AS_FILE_BYTE_ORDER || header->version != AS_FILE_VERSION ||
+        header->size > INT_MAX || header->blob_size > file_size ||
+        sizeof(*header) + asArraySize(header->size, header->blob_size) != file_size)
+        return AS_INVALID_FILE;
+
+    const char *payload = (const char *)mapping + sizeof(*header);
+    if (asChecksum(AS_FNV64_OFFSET_BASIS, payload, file_size - sizeof(*header)) != header->checksum)
+        return AS_INVALID_FILE;
+
+    // The checksum only guards against damage, the layout must still be safe to read
+    AmountSetArray array;
+    asArrayLayout(&array, (void *)payload, header->size);
+    if (array.offsets[header->size] != header->blob_size ||
+        (header->blob_size > 0 && array.blob[header->blob_size - 1] != '\0'))
+        return AS_INVALID_FILE;
+
+    for (uint64_t i = 0; i < header->size; i++)
+    {
+        if (array.offsets[i] >= array.offsets[i + 1] || array.by_amount[i] >= header->size)
+            return AS_INVALID_FILE;
+    }
+
+    return AS_SUCCESS;
+}
+
+static char *asArrayElement(AmountSetStore store, int position)
+{
+    return store->array.blob + store->array.offsets[position];
+}
+
+static int asArrayLowerBound(AmountSetStore store, const char *element)
+{
+    int low = 0, high = store->size;
+    long visited = 0;
+    while (element && low < high)
+    {
+        int middle = low + (high - low) / 2;
+        if (strcmp(asArrayElement(store, middle), element) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+
+        visited++;
+    }
+
+    AS_STATS_ADD(store, string_comparisons, visited);
+    asStatsSearch(store, visited);
+    return low;
+}
+
+static int asArrayFind(AmountSetStore store, const char *element)
+{
+    int position = asArrayLowerBound(store, element);
+    if (position < store->size && strcmp(asArrayElement(store, position), element) == 0)
+        return position;
+
+    return -1;
+}
+
+static void asCursorLowerBound(AmountSetStore store, const char *element, AmountSetCursor *cursor)
+{
+    cursor->store = store;
+    if (store->array.memory)
+    {
+        cursor->node = NULL;
+        cursor->position = asArrayLowerBound(store, element);
+    }
+    else
+    {
+        cursor->node = asFindLowerBound(store, element);
+        cursor->position = -1;
+    }
+}
+
+static bool asCursorValid(const AmountSetCursor *cursor)
+{
+    return cursor->node || (cursor->position >= 0 && cursor->position < cursor->store->size);
+}
+
+static void asCursorNext(AmountSetCursor *cursor)
+{
+    if (cursor->node)
+        cursor->node = cursor->node->next[0];
+    else
+        cursor->position++;
+}
+
+static char *asCursorElement(const AmountSetCursor *cursor, size_t *out_length)
+{
+    if (cursor->node)
+    {
+        if (out_length)
+            *out_length = cursor->node->length;
+
+        return asNodeElement(cursor->node);
+    }
+
+    if (out_length)
+    {
+        const uint64_t *offsets = cursor->store->array.offsets;
+        *out_length = offsets[cursor->position + 1] - offsets[cursor->position] - 1;
+    }
+
+    return asArrayElement(cursor->store, cursor->position);
+}
+
+static double asCursorAmount(const AmountSetCursor *cursor)
+{
+    return cursor->node ? cursor->node->amount : cursor->store->array.amounts[cursor->position];
+}
+
+static int asCompareRanked(const void *first, const void *second)
+{
+    const AmountSetRanked *first_ranked = first, *second_ranked = second;
+    if (first_ranked->amount != second_ranked->amount)
+        return first_ranked->amount > second_ranked->amount ? -1 : 1;
+
+    return (first_ranked->position > second_ranked->position) - (first_ranked->position < second_ranked->position);
+}
+
+static void asRecordChange(AmountSet set, AmountSetChangeType type, const char *element, size_t length,
+                           double amount)
+{
+    AmountSetFilter filter = set->filter;
+    if (filter && type == AS_CHANGE_REGISTER)
+        asFilterAdd(filter, asHashElement(element, &length), length);
+    else if (filter && type == AS_CHANGE_DELETE)
+        filter->deleted++;
+    else if (filter && type == AS_CHANGE_CLEAR)
+        asFilterReset(filter, 0);
+
+    if (filter)
+        asFilterRefresh(set);
+
+    AmountSetJournal journal = set->journal;
+    if (!journal)
+        return;
+
+    journal->sequence++;
+    AmountSetJournalEntry *entry = &journal->entries[journal->sequence % journal->capacity];
+    if (element && entry->element_capacity <= length)
+    {
+        char *new_element = realloc(entry->element, length + 1);
+        if (!new_element)
+        {
+            // The change keeps its sequence number, reading from before it fails
+            journal->first_sequence = journal->sequence + 1;
+            return;
+        }
+
+        entry->element = new_element;
+        entry->element_capacity = length + 1;
+    }
+
+    if (element)
+        memcpy(entry->element, element, length + 1);
+
+    entry->change.sequence = journal->sequence;
+    entry->change.type = type;
+    entry->change.element = element ? entry->element : NULL;
+    entry->change.amount = amount;
+}
+
+static void asRecordReset(AmountSet set)
+{
+    if (set->journal)
+        set->journal->first_sequence = ++set->journal->sequence + 1;
+
+    if (set->filter)
+    {
+        set->filter->stale = true;
+        asFilterRefresh(set);
+    }
+}
+
+static void asJournalDestroy(AmountSetJournal journal)
+{
+    if (!journal)
+        return;
+
+    for (int i = 0; i < journal->capacity; i++)
+        free(journal->entries[i].element);
+
+    free(journal->entries);
+    free(journal);
+}
+
+static void asStoreCopyStats(AmountSetStore new_store, AmountSetStore store)
+{
+    new_store->finger_hits = store->finger_hits;
+    new_store->finger_misses = store->finger_misses;
+#ifdef AS_STATS
+    memcpy(&new_store->stats, &store->stats, sizeof(store->stats));
+#endif
+}
+
+static size_t asStoreMemory(AmountSetStore store)
+{
+    size_t memory = sizeof(*store) + store->index_capacity * sizeof(*store->index);
+    if (store->header)
+        memory += asNodeSize(AS_MAX_LEVEL, 0);
+
+    for (AmountSetBlock block = store->arena.blocks; block != NULL; block = block->next)
+        memory += sizeof(*block) + block->capacity;
+
+    if (asStoreIsSmall(store))
+        memory += asArraySize(store->array.capacity, store->array.blob_capacity);
+    else if (store->array.memory && store->array.mapped_size == 0)
+        memory += asArraySize(store->size, store->array.offsets[store->size]);
+
+    return memory;
+}
+
+static void asStatsSearch(AmountSetStore store, long visited)
+{
+#ifndef AS_STATS
+    (void)store;
+#endif
+    AS_STATS_ADD(store, searches, 1);
+    AS_STATS_ADD(store, nodes_visited, visited);
+    AS_STATS_MAX(store, max_nodes_visited, visited);
+}
+
+#ifdef AS_STATS
+static void asStatsMax(long *maximum, long value)
+{
+    long current = __atomic_load_n(maximum, __ATOMIC_RELAXED);
+    while (current < value &&
+           !__atomic_compare_exchange_n(maximum, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+#endif
+
+static AmountSetResult asExpand(AmountSet set)
+{
+    AmountSetNode cursor;
+    AmountSetStore new_store = asStoreThaw(set->store, set->current_position, &cursor);
+    if (!new_store)
+        return AS_OUT_OF_MEMORY;
+
+    asStoreRelease(set->store);
+    set->store = new_store;
+    set->current_node = cursor;
+    set->current_position = -1;
+    return AS_SUCCESS;
+}
+
+static AmountSetResult asFrozenCheck(AmountSet set, AmountSetChangeType type, const char *element, double amount,
+                                     bool create)
+{
+    AmountSetStore store = set->store;
+    if (!asStoreIsFrozen(store))
+        return AS_SUCCESS;
+
+    int position = asArrayFind(store, element);
+    if (type == AS_CHANGE_REGISTER)
+        return position < 0 ? AS_SUCCESS : AS_ITEM_ALREADY_EXISTS;
+
+    if (position < 0 && !create)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    if (type == AS_CHANGE_AMOUNT && (position < 0 ? 0 : store->array.amounts[position]) + amount < 0)
+        return AS_INSUFFICIENT_AMOUNT;
+
+    return AS_SUCCESS;
+}
+
+static void asShrink(AmountSet set)
+{
+    AmountSetStore store = set->store;
+    if (store->array.memory || store->size > AS_SMALL_MIN_SIZE ||
+        __atomic_load_n(&store->references, __ATOMIC_ACQUIRE) != 1)
+        return;
+
+    AmountSetStore new_store = asStoreFreeze(store, true);
+    if (!new_store)
+        return;
+
+    asStoreRelease(store);
+    set->store = new_store;
+    set->current_node = NULL;
+    set->current_position = -1;
+}
+
+static AmountSetResult asSmallReserve(AmountSetStore store, size_t blob_size)
+{
+    AmountSetArray *array = &store->array;
+    if (blob_size <= array->blob_capacity)
+        return AS_SUCCESS;
+
+    size_t blob_capacity = array->blob_capacity * 2;
+    if (blob_capacity < blob_size)
+        blob_capacity = blob_size;
+
+    // The arrays before the blob are laid out by capacity, so growing the allocation keeps them in place
+    void *memory = realloc(array->memory, asArraySize(array->capacity, blob_capacity));
+    if (!memory)
+        return AS_OUT_OF_MEMORY;
+
+    array->memory = memory;
+    array->blob_capacity = blob_capacity;
+    asArrayLayout(array, memory, array->capacity);
+    return AS_SUCCESS;
+}
+
+static AmountSetResult asSmallInsert(AmountSetStore store, int position, const char *element, size_t length,
+                                     double amount)
+{
+    AmountSetArray *array = &store->array;
+    int size = store->size;
+    assert(size < array->capacity);
+    if (asSmallReserve(store, array->offsets[size] + length + 1) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
 
-struct AmountSet_t
+    uint64_t offset = array->offsets[position];
+    memmove(array->blob + offset + length + 1, array->blob + offset, array->offsets[size] - offset);
+    memcpy(array->blob + offset, element, length + 1);
+    for (int i = size; i >= position; i--)
+        array->offsets[i + 1] = array->offsets[i] + length + 1;
+
+    memmove(array->amounts + position + 1, array->amounts + position, (size - position) * sizeof(*array->amounts));
+    array->amounts[position] = amount;
+    store->size++;
+    store->moves++;
+    asSmallOrder(store);
+    return AS_SUCCESS;
+}
+
+static void asSmallRemove(AmountSetStore store, int position)
 {
-    int size;
-    AmountSetNode current_node;
-    AmountSetNode first;
-};
+    AmountSetArray *array = &store->array;
+    int size = store->size;
+    uint64_t offset = array->offsets[position];
+    uint64_t length = array->offsets[position + 1] - offset;
+    memmove(array->blob + offset, array->blob + offset + length, array->offsets[size] - offset - length);
+    for (int i = position; i < size; i++)
+        array->offsets[i] = array->offsets[i + 1] - length;
 
-/**
- * asFreeNode: Frees a specific node's resources.
- * 
- * The node's and it's element's memory will be released, 
- * Adjacent nodes and the set's pointer will be untouched. 
- * 
- * @param node - The AmountSetNode to be released.
- * 
- * 
- * **/
-static void asFreeNode(AmountSetNode node);
+    memmove(array->amounts + position, array->amounts + position + 1, (size - position - 1) * sizeof(*array->amounts));
+    store->size--;
+    store->moves++;
+    asSmallOrder(store);
+}
 
-/**
- * asFindNode: Set the iterator to the node containing a specific element.
- * 
- * Iterator value is set to the node containing the element if found,
- * The iterator is undefined if the element is not found.
- * 
- * @param set The set to search in.
- * @param element The element to match.
- * @return
- *      AS_NULL_ARGUMENT - if a NULL argument was passed,
- *      AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
- *      AS_SUCCESS - if the element was found and the node set.
- * **/
-static AmountSetResult asFindNode(AmountSet set, const char *element);
+static void asSmallOrder(AmountSetStore store)
+{
+    AmountSetArray *array = &store->array;
+    for (int i = 0; i < store->size; i++)
+    {
+        // Positions are inserted in ascending order, so equal amounts stay ordered by element
+        int j = i;
+        while (j > 0 && array->amounts[array->by_amount[j - 1]] < array->amounts[i])
+        {
+            array->by_amount[j] = array->by_amount[j - 1];
+            j--;
+        }
 
-/**
- * asFindPrecedingNode: Set the iterator to the node containing a specific element, and find the preceding node.
- * 
- * Iterator value is set to the node containing the element if found,
- * The iterator is undefined if the element is not found.
- * The preceding node pointer is set to the node preceding the node that contains the element, if found.
- * 
- * @param set The set to search in.
- * @param element The element to match.
- * @param preceding_node The variable to return the result in.
- * @return
- *      AS_NULL_ARGUMENT - if a NULL argument was passed,
- *      AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
- *      AS_SUCCESS - if the element was found and the node set.
- * **/
-static AmountSetResult asFindPrecedingNode(AmountSet set, const char *element, AmountSetNode *preceding_node);
+        array->by_amount[j] = i;
+    }
 
-AmountSet asCreate()
+    asAggregateScan(&store->aggregate, array->amounts, store->size);
+}
+
+static AmountSetResult asSmallChange(AmountSet set, AmountSetChangeType type, const char *element, double amount,
+                                     bool create, bool *out_created)
 {
-    AmountSet new_set = malloc(sizeof(*new_set));
+    size_t length = strlen(element);
+    int position = asArrayLowerBound(set->store, element);
+    bool found = position < set->store->size && strcmp(asArrayElement(set->store, position), element) == 0;
+    if (type == AS_CHANGE_REGISTER && found)
+        return AS_ITEM_ALREADY_EXISTS;
 
-    if (!new_set)
-        return NULL;
+    if (!found && !(type == AS_CHANGE_REGISTER || create))
+        return AS_ITEM_DOES_NOT_EXIST;
 
-    new_set->size = 0;
-    new_set->current_node = NULL;
-    new_set->first = NULL;
+    if (type == AS_CHANGE_AMOUNT && (found ? set->store->array.amounts[position] : 0) + amount < 0)
+        return AS_INSUFFICIENT_AMOUNT;
 
-    return new_set;
+    // The copy of a small store keeps the element at the same position
+    if (asPrepareWrite(set) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    AmountSetStore store = set->store;
+    if (type == AS_CHANGE_DELETE)
+    {
+        asSmallRemove(store, position);
+        set->current_position = -1;
+        asRecordChange(set, AS_CHANGE_DELETE, element, length, 0);
+        return AS_SUCCESS;
+    }
+
+    if (!found)
+    {
+        double initial_amount = type == AS_CHANGE_AMOUNT ? amount : 0;
+        if (asSmallInsert(store, position, element, length, initial_amount) != AS_SUCCESS)
+            return AS_OUT_OF_MEMORY;
+
+        set->current_position = -1;
+        asRecordChange(set, AS_CHANGE_REGISTER, element, length, 0);
+        if (type == AS_CHANGE_AMOUNT)
+            asRecordChange(set, AS_CHANGE_AMOUNT, element, length, amount);
+
+        if (out_created)
+            *out_created = true;
+
+        return AS_SUCCESS;
+    }
+
+    store->array.amounts[position] += amount;
+    asSmallOrder(store);
+    asRecordChange(set, AS_CHANGE_AMOUNT, element, length, amount);
+    return AS_SUCCESS;
 }
 
-void asDestroy(AmountSet set)
+static AmountSetResult asSmallMakeRoom(AmountSet set, const char *element)
 {
-    if (!set)
-        return;
+    AmountSetStore store = set->store;
+    if (!asStoreIsSmall(store) || store->size < store->array.capacity || asArrayFind(store, element) >= 0)
+        return AS_SUCCESS;
 
-    asClear(set);
-    free(set);
+    return asExpand(set);
 }
 
-AmountSet asCopy(AmountSet set)
+static AmountSetFilter asFilterCreate(double false_positive_rate, int size)
 {
-    if (!set)
+    AmountSetFilter new_filter = malloc(sizeof(*new_filter));
+    if (!new_filter)
         return NULL;
 
-    AmountSet new_set = asCreate();
-    AS_FOREACH(char *, current_element, set)
+    // Every hash halves the false positives, at about 1.5 bits per element each in blocks
+    int hashes = 1;
+    for (double rate = 0.5; rate > false_positive_rate && hashes < AS_FILTER_MAX_HASHES; rate /= 2)
+        hashes++;
+
+    int capacity = size < AS_FILTER_MIN_CAPACITY / 2 ? AS_FILTER_MIN_CAPACITY : 2 * size;
+    size_t bits = (size_t)capacity * (hashes * 3 / 2 + 1);
+    new_filter->block_count = (bits + AS_FILTER_BLOCK_BITS - 1) / AS_FILTER_BLOCK_BITS;
+    void *blocks = NULL;
+    if (posix_memalign(&blocks, AS_FILTER_BLOCK_WORDS * sizeof(uint64_t),
+                       new_filter->block_count * AS_FILTER_BLOCK_WORDS * sizeof(uint64_t)) != 0)
     {
-        if (asRegister(new_set, current_element))
-        {
-            asDestroy(new_set);
-            return NULL;
-        }
-        double amount;
-        asGetAmount(set, current_element, &amount);
-        asChangeAmount(new_set, current_element, amount);
-    };
+        free(new_filter);
+        return NULL;
+    }
 
-    set->current_node = NULL;
-    new_set->current_node = NULL;
-    return new_set;
+    new_filter->blocks = blocks;
+    new_filter->hashes = hashes;
+    new_filter->false_positive_rate = false_positive_rate;
+    asFilterReset(new_filter, capacity);
+    return new_filter;
 }
 
-int asGetSize(AmountSet set)
+static AmountSetFilter asFilterBuild(AmountSetStore store, double false_positive_rate)
 {
-    if (!set)
-        return -1;
+    AmountSetFilter new_filter = asFilterCreate(false_positive_rate, store->size);
+    if (!new_filter)
+        return NULL;
+
+    AmountSetCursor cursor;
+    for (asCursorLowerBound(store, NULL, &cursor); asCursorValid(&cursor); asCursorNext(&cursor))
+    {
+        size_t length;
+        char *element = asCursorElement(&cursor, &length);
+        unsigned int hash = cursor.node ? cursor.node->hash : asHashElement(element, &length);
+        asFilterAdd(new_filter, hash, length);
+    }
 
-    return set->size;
+    return new_filter;
 }
 
-bool asContains(AmountSet set, const char *element)
+static void asFilterDestroy(AmountSetFilter filter)
 {
-    if (!set || !element)
-        return false;
+    if (!filter)
+        return;
+
+    free(filter->blocks);
+    free(filter);
+}
 
-    AmountSetNode last_position = set->current_node;
-    AmountSetResult operation_result = asFindNode(set, element);
-    set->current_node = last_position;
+static void asFilterReset(AmountSetFilter filter, int capacity)
+{
+    memset(filter->blocks, 0, filter->block_count * AS_FILTER_BLOCK_WORDS * sizeof(uint64_t));
+    if (capacity > 0)
+        filter->capacity = capacity;
 
-    return (operation_result == AS_SUCCESS);
+    filter->added = 0;
+    filter->deleted = 0;
+    filter->stale = false;
 }
 
-AmountSetResult asGetAmount(AmountSet set, const char *element, double *outAmount)
+static uint64_t asFilterMix(unsigned int hash, size_t length)
+{
+    // Finalizer of splitmix64
+    uint64_t mixed = ((uint64_t)length << 32) | hash;
+    mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ull;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebull;
+    return mixed ^ (mixed >> 31);
+}
+
+static void asFilterAdd(AmountSetFilter filter, unsigned int hash, size_t length)
 {
-    AmountSetResult operation_result;
-    AmountSetNode last_position = set->current_node;
-    if ((operation_result = asFindNode(set, element)) == AS_SUCCESS)
+    uint64_t mixed = asFilterMix(hash, length);
+    uint64_t *block = filter->blocks + ((mixed >> 32) * filter->block_count >> 32) * AS_FILTER_BLOCK_WORDS;
+    uint32_t position = (uint32_t)mixed;
+    uint32_t step = (uint32_t)(mixed >> 16) | 1;
+    for (int i = 0; i < filter->hashes; i++, position += step)
     {
-        assert(set->current_node);
-        *outAmount = set->current_node->amount;
+        uint32_t bit = position >> AS_FILTER_BLOCK_SHIFT;
+        block[bit / 64] |= (uint64_t)1 << (bit % 64);
     }
-    set->current_node = last_position;
-    return operation_result;
+
+    filter->added++;
 }
 
-AmountSetResult asRegister(AmountSet set, const char *element)
+static bool asFilterMayContain(AmountSetFilter filter, unsigned int hash, size_t length)
 {
-    if (!set || !element)
-        return AS_NULL_ARGUMENT;
+    uint64_t mixed = asFilterMix(hash, length);
+    const uint64_t *block = filter->blocks + ((mixed >> 32) * filter->block_count >> 32) * AS_FILTER_BLOCK_WORDS;
+    uint32_t position = (uint32_t)mixed;
+    uint32_t step = (uint32_t)(mixed >> 16) | 1;
+    for (int i = 0; i < filter->hashes; i++, position += step)
+    {
+        uint32_t bit = position >> AS_FILTER_BLOCK_SHIFT;
+        if (!(block[bit / 64] & ((uint64_t)1 << (bit % 64))))
+            return false;
+    }
 
-    AmountSetNode preceding_node = NULL;
-    if (asFindPrecedingNode(set, element, &preceding_node) == AS_SUCCESS)
-        return AS_ITEM_ALREADY_EXISTS;
+    return true;
+}
 
-    AmountSetNode new_node = malloc(sizeof(*new_node));
-    if (!new_node)
+static void asFilterRefresh(AmountSet set)
+{
+    AmountSetFilter filter = set->filter;
+    if (!filter->stale && filter->added <= filter->capacity &&
+        filter->deleted <= filter->capacity / AS_FILTER_DELETED_SHARE)
+        return;
+
+    AmountSetFilter new_filter = asFilterBuild(set->store, filter->false_positive_rate);
+    if (!new_filter)
+        return;
+
+    asFilterDestroy(filter);
+    set->filter = new_filter;
+}
+
+static bool asFilterRejects(AmountSet set, unsigned int hash, size_t length)
+{
+    // A stale filter may miss elements, it is bypassed until it can be rebuilt
+    AmountSetFilter filter = set->filter;
+    if (!filter || filter->stale || asFilterMayContain(filter, hash, length))
+        return false;
+
+    AS_STATS_ADD(set->store, filter_rejects, 1);
+    return true;
+}
+
+static AmountSetResult asHandlesGrow(AmountSet set)
+{
+    int new_capacity = set->handles_capacity ? 2 * set->handles_capacity : AS_HANDLES_INITIAL_CAPACITY;
+    AmountSetHandle *new_handles = calloc(new_capacity, sizeof(*new_handles));
+    if (!new_handles)
         return AS_OUT_OF_MEMORY;
 
-    char *new_element = malloc((strlen(element) + 1) * sizeof(char));
-    if (!new_element)
+    for (int i = 0; i < set->handles_capacity; i++)
     {
-        free(new_node);
-        return AS_OUT_OF_MEMORY;
+        AmountSetHandle handle = set->handles[i];
+        while (handle)
+        {
+            AmountSetHandle next = handle->next;
+            handle->next = new_handles[handle->hash & (new_capacity - 1)];
+            new_handles[handle->hash & (new_capacity - 1)] = handle;
+            handle = next;
+        }
+    }
+
+    free(set->handles);
+    set->handles = new_handles;
+    set->handles_capacity = new_capacity;
+    return AS_SUCCESS;
+}
+
+static bool asHandleResolve(AmountSetHandle handle)
+{
+    AmountSetStore store = handle->set->store;
+    if (handle->serial == store->serial &&
+        (handle->node ? handle->node->generation == handle->generation : handle->moves == store->moves))
+    {
+        assert(handle->node ? memcmp(asNodeElement(handle->node), handle->element, handle->length + 1) == 0
+                            : strcmp(asArrayElement(store, handle->position), handle->element) == 0);
+        return true;
     }
-    strcpy(new_element, element);
-    new_node->amount = 0;
-    new_node->element = new_element;
 
-    if (preceding_node != NULL)
+    if (store->array.memory)
     {
-        new_node->next = preceding_node->next;
-        preceding_node->next = new_node;
+        handle->node = NULL;
+        handle->position = asArrayFind(store, handle->element);
+        if (handle->position < 0)
+            return false;
     }
     else
     {
-        new_node->next = set->first;
-        set->first = new_node;
+        handle->node = asIndexFind(store, handle->element, handle->hash, handle->length);
+        if (!handle->node)
+            return false;
     }
 
-    set->current_node = NULL;
-    set->size++;
-    return AS_SUCCESS;
+    // A missing element isn't kept, it may be registered without moving other elements
+    handle->serial = store->serial;
+    handle->generation = handle->node ? handle->node->generation : 0;
+    handle->moves = store->moves;
+    return true;
 }
 
-AmountSetResult asChangeAmount(AmountSet set, const char *element, const double amount)
+static AmountSetResult asBuildFromArrays(const char *const *elements, const double *amounts, int size, int threads,
+                                         AmountSet *outSet)
 {
-    if (!set || !element)
+    if (!outSet || size < 0 || (size > 0 && !elements))
         return AS_NULL_ARGUMENT;
 
-    AmountSetNode last_position = set->current_node;
-    AmountSetResult operation_result;
+    bool sorted = true;
+    for (int i = 0; i < size; i++)
+    {
+        if (!elements[i])
+            return AS_NULL_ARGUMENT;
+
+        if (amounts && amounts[i] < 0)
+            return AS_INSUFFICIENT_AMOUNT;
 
-    if ((operation_result = asFindNode(set, element)) == AS_SUCCESS)
+        if (sorted && i > 0 && strcmp(elements[i - 1], elements[i]) >= 0)
+            sorted = false;
+    }
+
+    AmountSetPair *pairs = NULL;
+    if (!sorted)
     {
-        if (set->current_node->amount + amount < 0)
-            operation_result = AS_INSUFFICIENT_AMOUNT;
+        pairs = malloc(size * sizeof(*pairs));
+        if (!pairs)
+            return AS_OUT_OF_MEMORY;
 
-        set->current_node->amount += amount;
+        for (int i = 0; i < size; i++)
+        {
+            pairs[i].element = elements[i];
+            pairs[i].amount = amounts ? amounts[i] : 0;
+        }
+        asParallelSort(pairs, size, sizeof(*pairs), asComparePairs, threads);
     }
 
-    set->current_node = last_position;
-    return operation_result;
-}
+    AmountSet new_set = asCreateFromStore(asStoreCreate());
+    AmountSetResult operation_result = new_set ? asIndexReserve(new_set->store, size) : AS_OUT_OF_MEMORY;
 
-AmountSetResult asDelete(AmountSet set, const char *element)
-{
-    if (!set || !element)
-        return AS_NULL_ARGUMENT;
+    AmountSetNode last_nodes[AS_MAX_LEVEL];
+    for (int level = 0; new_set && level < AS_MAX_LEVEL; level++)
+        last_nodes[level] = new_set->store->header;
 
-    AmountSetNode preceding_node = NULL;
+    for (int i = 0; operation_result == AS_SUCCESS && i < size; i++)
+    {
+        const char *element = sorted ? elements[i] : pairs[i].element;
+        double amount = sorted ? (amounts ? amounts[i] : 0) : pairs[i].amount;
 
-    if (asFindPrecedingNode(set, element, &preceding_node) == AS_ITEM_DOES_NOT_EXIST)
-        return AS_ITEM_DOES_NOT_EXIST;
+        // Sorted input was already checked for equal neighbours
+        if (!sorted && i > 0 && strcmp(pairs[i - 1].element, element) == 0)
+        {
+            operation_result = AS_ITEM_ALREADY_EXISTS;
+            break;
+        }
 
-    if (preceding_node != NULL)
-        preceding_node->next = set->current_node->next;
-    else
-        set->first = set->current_node->next;
+        size_t length;
+        unsigned int hash = asHashElement(element, &length);
+        operation_result = asAppendNode(new_set->store, last_nodes, element, length, hash, amount);
+    }
 
-    asFreeNode(set->current_node);
-    set->current_node = NULL;
-    set->size--;
-    return AS_SUCCESS;
-}
+    free(pairs);
+    AmountSetNode *by_amount = NULL;
+    if (operation_result == AS_SUCCESS && threads > 1)
+    {
+        by_amount = malloc((size + 1) * sizeof(*by_amount));
+        int count = 0;
+        for (AmountSetNode node = new_set->store->header->next[0]; by_amount && node != NULL; node = node->next[0])
+            by_amount[count++] = node;
 
-AmountSetResult asClear(AmountSet set)
-{
-    if (!set)
-        return AS_NULL_ARGUMENT;
+        // Without memory for the nodes the amount order is sorted by a single thread
+        if (by_amount)
+            asParallelSort(by_amount, size, sizeof(*by_amount), asCompareByAmount, threads);
+    }
+
+    if (operation_result == AS_SUCCESS)
+        operation_result = asAmountIndexBuild(new_set->store, by_amount);
 
-    AmountSetNode next_node, current_node = set->first;
-    while (current_node != NULL)
+    free(by_amount);
+    if (operation_result != AS_SUCCESS)
     {
-        next_node = current_node->next;
-        asFreeNode(current_node);
-        current_node = next_node;
+        asDestroy(new_set);
+        return operation_result;
     }
 
-    set->size = 0;
-    set->first = NULL;
-    set->current_node = NULL;
+    asShrink(new_set);
+    *outSet = new_set;
     return AS_SUCCESS;
 }
 
-char *asGetFirst(AmountSet set)
+static void asRunTasks(AmountSetTask *tasks, int count)
 {
-    if (!set || !(set->first))
-        return NULL;
+    pthread_t threads[AS_MAX_THREADS];
+    bool started[AS_MAX_THREADS];
+    for (int i = 1; i < count; i++)
+        started[i] = pthread_create(&threads[i], NULL, asRunTask, &tasks[i]) == 0;
 
-    set->current_node = set->first;
-    return set->first->element;
+    asRunTask(&tasks[0]);
+    for (int i = 1; i < count; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            asRunTask(&tasks[i]);
+    }
 }
 
-char *asGetNext(AmountSet set)
+static void *asRunTask(void *task)
 {
-    if (!set || !(set->current_node))
+    AmountSetTask *current = task;
+    if (!current->compare)
+    {
+        memcpy(current->target, current->source, current->first_count);
         return NULL;
+    }
 
-    if (set->current_node->next != NULL)
-        set->current_node = set->current_node->next;
-    else
+    if (!current->target)
+    {
+        qsort(current->source, current->first_count, current->width, current->compare);
         return NULL;
+    }
+
+    // Equal elements are taken from the first run first
+    size_t width = current->width;
+    const char *first = current->source;
+    const char *first_end = first + current->first_count * width;
+    const char *second = first_end;
+    const char *second_end = second + current->second_count * width;
+    char *target = current->target;
+    while (first < first_end && second < second_end)
+    {
+        if (current->compare(second, first) < 0)
+        {
+            memcpy(target, second, width);
+            second += width;
+        }
+        else
+        {
+            memcpy(target, first, width);
+            first += width;
+        }
+        target += width;
+    }
 
-    return set->current_node->element;
+    memcpy(target, first, first_end - first);
+    memcpy(target + (first_end - first), second, second_end - second);
+    return NULL;
 }
 
-static void asFreeNode(AmountSetNode node)
+static void asParallelSort(void *base, size_t count, size_t width, int (*compare)(const void *, const void *),
+                           int threads)
 {
-    if (!node)
+    if (threads > AS_MAX_THREADS)
+        threads = AS_MAX_THREADS;
+
+    if (count / AS_PARALLEL_MIN_RUN < (size_t)threads)
+        threads = count / AS_PARALLEL_MIN_RUN > 0 ? count / AS_PARALLEL_MIN_RUN : 1;
+
+    char *buffer = threads > 1 ? malloc(count * width) : NULL;
+    if (!buffer)
+    {
+        qsort(base, count, width, compare);
         return;
+    }
+
+    AmountSetTask tasks[AS_MAX_THREADS];
+    size_t run_size = (count + threads - 1) / threads;
+    int runs = 0;
+    for (size_t start = 0; start < count; start += run_size, runs++)
+    {
+        AmountSetTask task = {(char *)base + start * width, NULL, count - start < run_size ? count - start : run_size,
+                              0, width, compare};
+        tasks[runs] = task;
+    }
+    asRunTasks(tasks, runs);
+
+    // Every round merges pairs of adjacent runs into the other array, halving the number of runs
+    char *source = base;
+    char *target = buffer;
+    for (; run_size < count; run_size *= 2)
+    {
+        int merges = 0;
+        for (size_t start = 0; start < count; start += 2 * run_size, merges++)
+        {
+            size_t first_count = count - start < run_size ? count - start : run_size;
+            size_t second_count = count - start - first_count < run_size ? count - start - first_count : run_size;
+            AmountSetTask task = {source + start * width, target + start * width, first_count, second_count, width,
+                                  compare};
+            tasks[merges] = task;
+        }
+        asRunTasks(tasks, merges);
+
+        char *merged = target;
+        target = source;
+        source = merged;
+    }
+
+    if (source != base)
+        memcpy(base, source, count * width);
+
+    free(buffer);
+}
+
+static void asParallelCopy(void *target, const void *source, size_t size, int threads)
+{
+    if (threads > AS_MAX_THREADS)
+        threads = AS_MAX_THREADS;
+
+    if (size / AS_PARALLEL_MIN_COPY < (size_t)threads)
+        threads = size / AS_PARALLEL_MIN_COPY > 0 ? size / AS_PARALLEL_MIN_COPY : 1;
 
-    free(node->element);
-    free(node);
+    AmountSetTask tasks[AS_MAX_THREADS];
+    size_t part_size = (size + threads - 1) / threads;
+    int parts = 0;
+    for (size_t start = 0; start < size; start += part_size, parts++)
+    {
+        AmountSetTask task = {(char *)source + start, (char *)target + start,
+                              size - start < part_size ? size - start : part_size, 0, 1, NULL};
+        tasks[parts] = task;
+    }
 
-    return;
+    if (parts > 0)
+        asRunTasks(tasks, parts);
 }
 
-static AmountSetResult asFindNode(AmountSet set, const char *element)
+static AmountSetResult asReaderNextLine(AmountSetReader *reader, char **out_line, size_t *out_length)
 {
-    AmountSetNode preceding_node;
-    return asFindPrecedingNode(set, element, &preceding_node);
+    size_t searched = reader->start;
+    while (true)
+    {
+        char *line = reader->buffer + reader->start;
+        char *line_end = memchr(reader->buffer + searched, '\n', reader->end - searched);
+        if (line_end || (reader->finished && reader->start < reader->end))
+        {
+            // The last line may lack a line break, the byte after it is still in the buffer
+            *out_line = line;
+            *out_length = line_end ? (size_t)(line_end - line) : reader->end - reader->start;
+            reader->start += *out_length + (line_end != NULL);
+            return AS_SUCCESS;
+        }
+
+        if (reader->finished)
+        {
+            *out_line = NULL;
+            return AS_SUCCESS;
+        }
+
+        // Keeps the partial line, and room for a byte after it
+        memmove(reader->buffer, line, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+        searched = reader->end;
+        if (reader->end + 1 >= reader->capacity)
+        {
+            char *buffer = realloc(reader->buffer, 2 * reader->capacity);
+            if (!buffer)
+                return AS_OUT_OF_MEMORY;
+
+            reader->buffer = buffer;
+            reader->capacity *= 2;
+        }
+
+        size_t read = fread(reader->buffer + reader->end, 1, reader->capacity - reader->end - 1, reader->stream);
+        reader->end += read;
+        if (read == 0)
+        {
+            if (ferror(reader->stream))
+                return AS_IO_ERROR;
+
+            reader->finished = true;
+        }
+    }
 }
 
-static AmountSetResult asFindPrecedingNode(AmountSet set, const char *element, AmountSetNode *preceding_node)
+static AmountSetResult asParseLine(char *line, size_t length, char **out_element, double *out_amount)
 {
-    if (!set || !element)
-        return AS_NULL_ARGUMENT;
+    if (length > 0 && line[length - 1] == '\r')
+        length--;
+
+    size_t amount_start = length;
+    while (amount_start > 0 && line[amount_start - 1] != ' ' && line[amount_start - 1] != '\t')
+        amount_start--;
+
+    size_t element_end = amount_start;
+    while (element_end > 0 && (line[element_end - 1] == ' ' || line[element_end - 1] == '\t'))
+        element_end--;
+
+    *out_element = NULL;
+    if (amount_start == length)
+        return element_end == 0 ? AS_SUCCESS : AS_INVALID_FILE;
 
-    AmountSetResult operation_result = AS_ITEM_DOES_NOT_EXIST;
-    int compare_result = 1;
-    AS_FOREACH(char *, current_element, set)
+    if (amount_start == 0 || !asParseAmount(line + amount_start, length - amount_start, out_amount))
+        return AS_INVALID_FILE;
+
+    if (*out_amount < 0)
+        return AS_INSUFFICIENT_AMOUNT;
+
+    line[element_end] = '\0';
+    *out_element = line;
+    return AS_SUCCESS;
+}
+
+static const double as_powers_of_ten[AS_EXACT_POWERS] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool asParseAmount(char *text, size_t length, double *out_amount)
+{
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int decimals = -1;
+    size_t i = 0;
+    for (; i < length; i++)
     {
-        if ((compare_result = strcmp(current_element, element)) == 0)
+        if (text[i] >= '0' && text[i] <= '9')
         {
-            operation_result = AS_SUCCESS;
-            break;
+            mantissa = mantissa * 10 + (text[i] - '0');
+            digits++;
+            decimals += decimals >= 0;
         }
-        else if (compare_result > 0) // Passed the element
+        else if (text[i] == '.' && decimals < 0)
+            decimals = 0;
+        else
             break;
-        if (set->current_node != NULL)
-            *preceding_node = set->current_node;
     }
 
-    return operation_result;
-}
\ No newline at end of file
+    if (i == length && digits > 0 && digits <= AS_EXACT_DIGITS)
+    {
+        *out_amount = (double)mantissa / as_powers_of_ten[decimals > 0 ? decimals : 0];
+        return true;
+    }
+
+    // Exponents, signs and long numbers
+    text[length] = '\0';
+    char *end;
+    *out_amount = strtod(text, &end);
+    return end == text + length && *out_amount >= -DBL_MAX && *out_amount <= DBL_MAX;
+}
+
+static size_t asFormatAmount(double amount, char *out)
+{
+    for (int decimals = 0; decimals <= AS_FORMAT_MAX_DECIMALS; decimals++)
+    {
+        double scaled = amount * as_powers_of_ten[decimals];
+        if (!(scaled >= 0 && scaled < as_powers_of_ten[AS_EXACT_DIGITS]))
+            break;
+
+        // Read back as this same quotient, see asParseAmount
+        uint64_t mantissa = (uint64_t)(scaled + 0.5);
+        if ((double)mantissa / as_powers_of_ten[decimals] != amount)
+            continue;
+
+        char digits[AS_FORMAT_MAX_LENGTH];
+        int count = 0;
+        do
+        {
+            digits[count++] = '0' + mantissa % 10;
+            mantissa /= 10;
+        } while (mantissa > 0 || count <= decimals);
+
+        size_t length = 0;
+        while (count > 0)
+        {
+            if (count == decimals)
+                out[length++] = '.';
+            out[length++] = digits[--count];
+        }
+
+        return length;
+    }
+
+    return snprintf(out, AS_FORMAT_MAX_LENGTH, "%.17g", amount);
+}
+
+static void asAggregateAdd(AmountSetAggregate *aggregate, double amount)
+{
+    double total = aggregate->total + amount;
+    double total_magnitude = aggregate->total < 0 ? -aggregate->total : aggregate->total;
+    double amount_magnitude = amount < 0 ? -amount : amount;
+
+    // The rounding error of the addition is in the smaller of the two addends
+    if (total_magnitude >= amount_magnitude)
+        aggregate->compensation += (aggregate->total - total) + amount;
+    else
+        aggregate->compensation += (amount - total) + aggregate->total;
+
+    aggregate->total = total;
+}
+
+static void asAggregateChange(AmountSetAggregate *aggregate, double old_amount, double new_amount)
+{
+    if (old_amount != 0)
+        asAggregateAdd(aggregate, -old_amount);
+    if (new_amount != 0)
+        asAggregateAdd(aggregate, new_amount);
+
+    aggregate->positive += (new_amount > 0) - (old_amount > 0);
+}
+
+static void asAggregateScan(AmountSetAggregate *aggregate, const double *amounts, int size)
+{
+    memset(aggregate, 0, sizeof(*aggregate));
+    for (int i = 0; i < size; i++)
+        asAggregateChange(aggregate, 0, amounts[i]);
+}
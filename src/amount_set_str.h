@@ -11,18 +11,31 @@
  * The set has an internal iterator for external use. For all functions
  * where the state of the iterator after calling that function is not stated,
  * it is undefined. That is you cannot assume anything about it.
+ * External iterators (AmountSetIterator) can be used instead of the internal
+ * one. They only read the set, so any number of them can traverse the same set
+ * at once, and lookups never affect them.
  * The set is sorted in ascending order - iterating over the set is done in the
  * same order.
+ * Sets of up to 16 elements keep them in a single sorted array, and move them
+ * to the scalable structure when they grow past that. A set that shrinks back
+ * to 8 elements returns to the array.
  *
  * The following functions are available:
  *   asCreate           - Creates a new empty set
  *   asDestroy          - Deletes an existing set and frees all resources
  *   asCopy             - Copies an existing set
+ *   asCopyParallel     - Copies an existing set into memory of its own,
+ *                        using several threads
+ *   asCreateFromArrays - Creates a set from arrays of elements and amounts
+ *   asCreateFromArraysParallel - Creates a set from arrays of elements and
+ *                        amounts, using several threads
  *   asGetSize          - Returns the size of the set
  *   asContains         - Checks if an element exists in the set
  *   asGetAmount        - Returns the amount of an element in the set
  *   asRegister         - Add a new element into the set
  *   asChangeAmount     - Increase or decrease the amount of an element in the set
+ *   asUpsertAmount     - Change the amount of an element, registering it first
+ *                        if it is not in the set
  *   asDelete           - Delete an element completely from the set
  *   asClear            - Deletes all elements from target set
  *   asGetFirst         - Sets the internal iterator to the first element
@@ -30,11 +43,142 @@
  *   asGetNext          - Advances the internal iterator to the next element
  *                        and returns it.
  *   AS_FOREACH         - A macro for iterating over the set's elements
+ *   asIteratorBegin    - Starts an external iterator at the first element
+ *                        in the set, and returns it.
+ *   asIteratorNext     - Advances an external iterator to the next element
+ *                        and returns it.
+ *   asIteratorEnd      - Checks if an external iterator passed the last element
+ *   asIteratorGetAmount - Returns the amount of an external iterator's element
+ *   AS_FOREACH_ITERATOR - A macro for iterating over the set's elements with
+ *                        an external iterator
+ *   asGetRange         - Visits the elements between two bounds, in order
+ *   asGetPrefix        - Visits the elements starting with a prefix, in order
+ *   asCountRange       - Counts the elements between two bounds
+ *   asMerge            - Creates the union of two sets, combining amounts
+ *   asIntersect        - Creates the intersection of two sets, combining amounts
+ *   asSubtract         - Creates the elements of a set missing from another set
+ *   asCombineSum       - Combiner adding the amounts
+ *   asCombineMin       - Combiner taking the smaller amount
+ *   asCombineMax       - Combiner taking the larger amount
+ *   asTopK             - Returns the elements with the largest amounts
+ *   asRankOf           - Returns the position of an element by amount
+ *   asFreeze           - Converts the set to a compact read-only representation
+ *   asThaw             - Converts a frozen set back to its changeable representation
+ *   asIsFrozen         - Checks if the set is frozen
+ *   asSumAmounts       - Returns the total amount of the set's elements
+ *   asCountBelow       - Counts the elements whose amount is below a threshold
+ *   asGetTotalAmount   - Returns the running total amount of the set's elements
+ *   asCountPositive    - Returns the number of elements whose amount is above 0
+ *   asGetMinAmount     - Returns the smallest amount in the set
+ *   asGetMaxAmount     - Returns the largest amount in the set
+ *   asGetFingerStats   - Returns how often searches started from the last change
+ *   asSaveBinary       - Writes the set to a binary snapshot file
+ *   asOpenMapped       - Opens a binary snapshot file as a frozen set, without
+ *                        reading it into memory
+ *   asLoadStream       - Adds the elements of a text stream of "element amount" lines
+ *   asDumpStream       - Writes the set as "element amount" lines to a text stream
+ *   asEnableJournal    - Starts or stops recording the set's changes
+ *   asGetSequence      - Returns the sequence number of the last recorded change
+ *   asReadChangesSince - Visits the recorded changes after a sequence number
+ *   asApplyChanges     - Applies recorded changes to another set
+ *   asGetStats         - Returns operation counters and the memory held by the set
+ *   asEnableFilter     - Starts or stops filtering lookups of missing elements
+ *   asFindHandle       - Returns a handle to an element, for changing its amount
+ *                        without searching for it
+ *   asHandleGetAmount  - Returns the amount of a handle's element
+ *   asHandleChangeAmount - Increase or decrease the amount of a handle's element
+ *   asHandleRelease    - Frees a handle before its set is destroyed
  */
 
 /** Type for defining the set */
 typedef struct AmountSet_t *AmountSet;
 
+/** Type for a reference to an element of a set, see asFindHandle */
+typedef struct AmountSetHandle_t *AmountSetHandle;
+
+/**
+ * Type for an external iterator over a set.
+ * Meant to be allocated by the caller (usually on the stack), its fields are
+ * private to the implementation.
+ */
+typedef struct AmountSetIterator_t {
+    AmountSet set;
+    void *position;
+} AmountSetIterator;
+
+/**
+ * Type of function called for every visited element in range queries.
+ * Receives the element (and not a copy of it), its amount and the context
+ * pointer given to the query. Returns true to continue to the next element,
+ * false to stop the query. It must not change the set.
+ */
+typedef bool (*AmountSetVisitor)(const char* element, double amount, void* context);
+
+/**
+ * Type of function combining the amounts of an element found in two sets.
+ * Receives the element's amount in the first set and in the second set, and
+ * returns the element's amount in the result. asCombineSum, asCombineMin and
+ * asCombineMax are provided.
+ */
+typedef double (*AmountSetCombiner)(double firstAmount, double secondAmount);
+
+/** Kinds of changes recorded in a set's journal, see asEnableJournal */
+typedef enum AmountSetChangeType_t {
+    AS_CHANGE_REGISTER,
+    AS_CHANGE_AMOUNT,
+    AS_CHANGE_DELETE,
+    AS_CHANGE_CLEAR
+} AmountSetChangeType;
+
+/**
+ * Type for a change recorded in a set's journal.
+ * The element is NULL for AS_CHANGE_CLEAR, and amount is the change of the
+ * element's amount for AS_CHANGE_AMOUNT (0 otherwise).
+ */
+typedef struct AmountSetChange_t {
+    long sequence;
+    AmountSetChangeType type;
+    const char* element;
+    double amount;
+} AmountSetChange;
+
+/**
+ * Type of function called for every visited change of a journal.
+ * Receives the change (valid until the function returns) and the context
+ * pointer given to asReadChangesSince. Returns true to continue to the next
+ * change, false to stop. It must not change the set.
+ */
+typedef bool (*AmountSetChangeVisitor)(const AmountSetChange* change, void* context);
+
+/**
+ * Type for the counters and memory footprint returned by asGetStats.
+ * The counters are only kept if the set was compiled with AS_STATS defined,
+ * otherwise they are 0 and counting is false.
+ */
+typedef struct AmountSetStats_t {
+    bool counting;
+    long registers; // Calls of asRegister
+    long changes; // Calls of asChangeAmount
+    long upserts; // Calls of asUpsertAmount
+    long deletes; // Calls of asDelete
+    long lookups; // Calls of asContains and asGetAmount
+    long range_queries; // Calls of asGetRange, asGetPrefix and asCountRange
+    long searches; // Searches through the elements in order or by amount
+    long nodes_visited; // Elements compared by those searches
+    long max_nodes_visited; // Most elements compared by a single search
+    double average_nodes_visited;
+    long string_comparisons; // Comparisons that read past the first characters of the elements
+    long index_searches; // Searches of the hash index
+    long index_probes; // Slots inspected by those searches
+    long max_index_probes; // Most slots inspected by a single search
+    long node_allocations; // Elements allocated, including reused memory
+    long node_frees;
+    long filter_rejects; // Lookups answered by the filter, see asEnableFilter
+    long blocks; // Memory blocks currently held for elements
+    size_t memory_bytes; // Memory currently held, including elements shared with copies
+    size_t mapped_bytes; // Size of the mapped snapshot file, see asOpenMapped
+} AmountSetStats;
+
 /** Type used for returning error codes from amount set functions */
 typedef enum AmountSetResult_t {
     AS_SUCCESS = 0,
@@ -42,7 +186,10 @@ typedef enum AmountSetResult_t {
     AS_NULL_ARGUMENT,
     AS_ITEM_ALREADY_EXISTS,
     AS_ITEM_DOES_NOT_EXIST,
-    AS_INSUFFICIENT_AMOUNT
+    AS_INSUFFICIENT_AMOUNT,
+    AS_IO_ERROR,
+    AS_INVALID_FILE,
+    AS_JOURNAL_OVERFLOW
 } AmountSetResult;
 
 /**
@@ -64,7 +211,11 @@ void asDestroy(AmountSet set);
 /**
  * asCopy: Creates a copy of target set.
  *
- * Iterator values for both sets are undefined after this operation.
+ * Runs in constant time: the copy shares the source's elements until either
+ * of them is changed, and the first change then copies the elements in linear
+ * time. Copies may be used and changed by different threads, as long as each
+ * set is used by one thread at a time.
+ * The source set's iterator is unchanged, the copy's iterator is undefined.
  *
  * @param set - Target set.
  * @return
@@ -73,6 +224,75 @@ void asDestroy(AmountSet set);
  */
 AmountSet asCopy(AmountSet set);
 
+/**
+ * asCopyParallel: Creates a copy of target set that doesn't share its
+ * elements with the source set.
+ *
+ * For a frozen set (see asFreeze) or a set opened with asOpenMapped, the
+ * elements are copied by up to threads threads, each copying a part of them,
+ * which makes loading a mapped snapshot into memory faster. Other sets are
+ * copied by the calling thread alone.
+ * The source set's iterator is unchanged, the copy's iterator is undefined.
+ *
+ * @param set - Target set.
+ * @param threads - The largest number of threads to use, at least 1.
+ * @return
+ *     NULL if a NULL was sent, threads is less than 1, or a memory allocation failed.
+ *     An amount set containing the same elements (and amounts) as set, otherwise.
+ */
+AmountSet asCopyParallel(AmountSet set, int threads);
+
+/**
+ * asCreateFromArrays: Creates a new amount set from arrays of elements and
+ * their amounts.
+ *
+ * Runs in linear time if the elements are sorted in ascending order, and sorts
+ * them first otherwise. The elements are copied, the arrays are not modified.
+ *
+ * @param elements - Array of size elements to add.
+ * @param amounts - Array of size amounts, amounts[i] being the amount of
+ *     elements[i]. If NULL, all elements get an amount of 0.
+ * @param size - The number of elements in the arrays, at least 0.
+ * @param outSet - Pointer to the location where the new set is returned, in
+ *     case of success. In case of failure, the contents of outSet are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument or a NULL element was passed, or
+ *         size is negative.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_ALREADY_EXISTS - if two of the elements are equal.
+ *     AS_INSUFFICIENT_AMOUNT - if one of the amounts is negative.
+ *     AS_SUCCESS - if the set was created successfully.
+ */
+AmountSetResult asCreateFromArrays(const char* const* elements, const double* amounts, int size,
+                                   AmountSet* outSet);
+
+/**
+ * asCreateFromArraysParallel: Creates a new amount set from arrays of elements
+ * and their amounts, like asCreateFromArrays, sorting with several threads.
+ *
+ * Unsorted elements, and the order of the set by amount, are sorted by up to
+ * threads threads each sorting a part of the elements, and the parts are then
+ * merged in pairs. Sets of fewer than 4096 elements per thread are sorted by
+ * fewer threads. The elements are linked into the set by the calling thread.
+ *
+ * @param elements - Array of size elements to add.
+ * @param amounts - Array of size amounts, amounts[i] being the amount of
+ *     elements[i]. If NULL, all elements get an amount of 0.
+ * @param size - The number of elements in the arrays, at least 0.
+ * @param threads - The largest number of threads to use, at least 1.
+ * @param outSet - Pointer to the location where the new set is returned, in
+ *     case of success. In case of failure, the contents of outSet are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument or a NULL element was passed,
+ *         size is negative, or threads is less than 1.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_ALREADY_EXISTS - if two of the elements are equal.
+ *     AS_INSUFFICIENT_AMOUNT - if one of the amounts is negative.
+ *     AS_SUCCESS - if the set was created successfully.
+ */
+AmountSetResult asCreateFromArraysParallel(const char* const* elements, const double* amounts, int size,
+                                           int threads, AmountSet* outSet);
+
 /**
  * asGetSize: Returns the number of elements in a set.
  *
@@ -155,6 +375,8 @@ AmountSetResult asRegister(AmountSet set, const char* element);
  *     of 0 means don't change it.
  * @return
  *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if the set shares its elements with a copy, and
+ *         copying them failed.
  *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
  *     AS_INSUFFICIENT_AMOUNT - if amount is negative and the element's amount
  *         in the set is less than the amount that needs to be decreased (i.e.,
@@ -169,6 +391,32 @@ AmountSetResult asRegister(AmountSet set, const char* element);
  */
 AmountSetResult asChangeAmount(AmountSet set, const char* element, double amount);
 
+/**
+ * asUpsertAmount: Increase or decrease the amount of an element in the set,
+ * registering the element first if it doesn't exist.
+ *
+ * Equivalent to registering the element if it isn't in the set and then
+ * changing its amount, but searches the set only once.
+ * Iterator's value is undefined after this operation if the element was
+ * registered, and unchanged otherwise.
+ *
+ * @param set - The target set.
+ * @param element - The element whose amount is changed.
+ * @param amount - How much to change the element's amount. A new element
+ *     starts with an amount of 0 before the change.
+ * @param outCreated - Pointer to the location where true is returned if the
+ *     element was registered by this call, and false otherwise. May be NULL.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set or element was passed.
+ *     AS_OUT_OF_MEMORY - if registering the element or copying elements
+ *         shared with a copy of the set failed.
+ *     AS_INSUFFICIENT_AMOUNT - if the change will result in a negative amount
+ *         for the element. Neither the amount nor the set are changed, a
+ *         missing element isn't registered.
+ *     AS_SUCCESS - if the element's amount was changed successfully.
+ */
+AmountSetResult asUpsertAmount(AmountSet set, const char* element, double amount, bool* outCreated);
+
 /**
  * asDelete: Delete an element completely from the set.
  *
@@ -179,6 +427,8 @@ AmountSetResult asChangeAmount(AmountSet set, const char* element, double amount
  * @param element - The element to delete.
  * @return
  *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if the set shares its elements with a copy, and
+ *         copying them failed.
  *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
  *     AS_SUCCESS - if the element was deleted successfully.
  */
@@ -187,12 +437,14 @@ AmountSetResult asDelete(AmountSet set, const char* element);
 /**
  * asClear: Deletes all elements from target set.
  *
- * The elements are deallocated.
+ * The elements are deallocated, unless they are still shared with a copy.
  * Iterator's value is undefined after this operation.
  *
  * @param set - Target set to delete all elements from.
  * @return
  *     AS_NULL_ARGUMENT - if a NULL pointer was sent.
+ *     AS_OUT_OF_MEMORY - if the set shares its elements with a copy, and
+ *         allocating new empty storage failed.
  *     AS_SUCCESS - Otherwise.
  */
 AmountSetResult asClear(AmountSet set);
@@ -233,4 +485,679 @@ char* asGetNext(AmountSet set);
         iterator ;                               \
         iterator = asGetNext(set))
 
+/**
+ * asIteratorBegin: Starts an external iterator at the first element in the set.
+ * The first element is the smallest element of the set (alphabetically).
+ *
+ * The set's internal iterator is unchanged. The external iterator stays valid
+ * until an element is registered into or deleted from the set, or the set is
+ * cleared or destroyed. Changing amounts does not affect it, unless it is the
+ * first change of a set that shares its elements with a copy (see asCopy) or
+ * is frozen (see asFreeze).
+ *
+ * @param set - The set to iterate over.
+ * @param iterator - The iterator to start.
+ * @return
+ *     NULL if a NULL pointer was sent or the set is empty.
+ *     The first element of the set otherwise, and not a copy of it.
+ */
+char* asIteratorBegin(AmountSet set, AmountSetIterator* iterator);
+
+/**
+ * asIteratorNext: Advances an external iterator to the next element and
+ * returns it. The iteration is in ascending order on the set's elements.
+ *
+ * @param iterator - The iterator to advance.
+ * @return
+ *     NULL if a NULL pointer was sent, the iterator already passed the last
+ *     element, or reached the end of the set.
+ *     The next element of the set otherwise, and not a copy of it.
+ */
+char* asIteratorNext(AmountSetIterator* iterator);
+
+/**
+ * asIteratorEnd: Checks if an external iterator passed the last element.
+ *
+ * @param iterator - The iterator to check.
+ * @return
+ *     true - if a NULL pointer was sent or there is no current element.
+ *     false - if the iterator is at an element of the set.
+ */
+bool asIteratorEnd(const AmountSetIterator* iterator);
+
+/**
+ * asIteratorGetAmount: Returns the amount of an external iterator's current
+ * element, without searching the set for it.
+ *
+ * @param iterator - The iterator whose element's amount is requested.
+ * @param outAmount - Pointer to the location where the amount is returned, in case
+ *     of success. In case of failure, the contents of outAmount are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the iterator has no current element.
+ *     AS_SUCCESS - if the amount was returned successfully.
+ */
+AmountSetResult asIteratorGetAmount(const AmountSetIterator* iterator, double* outAmount);
+
+/**
+ * Macro for iterating over a set with an external iterator.
+ * Declares a new element variable for the loop, the iterator must be declared
+ * by the caller.
+ */
+#define AS_FOREACH_ITERATOR(type, element, iterator, set)        \
+    for(type element = (type) asIteratorBegin(set, &(iterator)) ; \
+        element ;                                                \
+        element = asIteratorNext(&(iterator)))
+
+/**
+ * asGetRange: Visits the elements of the set between two bounds (inclusive),
+ * in ascending order.
+ *
+ * Finds the first element without scanning the set from its start.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param low - The smallest element to visit. If NULL, starts from the first element.
+ * @param high - The largest element to visit. If NULL, continues to the last element.
+ * @param visitor - Function called for every element in the range, until it
+ *     returns false.
+ * @param context - Pointer passed as is to visitor.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set or visitor was passed.
+ *     AS_SUCCESS - otherwise.
+ */
+AmountSetResult asGetRange(AmountSet set, const char* low, const char* high,
+                           AmountSetVisitor visitor, void* context);
+
+/**
+ * asGetPrefix: Visits the elements of the set starting with a prefix, in
+ * ascending order.
+ *
+ * Finds the first element without scanning the set from its start.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param prefix - The prefix to match. An empty prefix matches all elements.
+ * @param visitor - Function called for every matching element, until it
+ *     returns false.
+ * @param context - Pointer passed as is to visitor.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set, prefix or visitor was passed.
+ *     AS_SUCCESS - otherwise.
+ */
+AmountSetResult asGetPrefix(AmountSet set, const char* prefix, AmountSetVisitor visitor, void* context);
+
+/**
+ * asCountRange: Returns the number of elements of the set between two bounds
+ * (inclusive).
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param low - The smallest element to count. If NULL, starts from the first element.
+ * @param high - The largest element to count. If NULL, continues to the last element.
+ * @return
+ *     -1 if a NULL set was sent.
+ *     Otherwise the number of elements in the range.
+ */
+int asCountRange(AmountSet set, const char* low, const char* high);
+
+/**
+ * asMerge: Creates a set with the elements of both sets.
+ *
+ * Walks both sets once in order, in O(n+m) time. An element found in one of
+ * the sets keeps its amount, an element found in both gets the amounts
+ * combined. The sets' iterators are unchanged.
+ *
+ * @param first - The first set.
+ * @param second - The second set. May be the same set as first.
+ * @param combine - Function combining the amounts of elements in both sets.
+ * @param outSet - Pointer to the location where the new set is returned, in
+ *     case of success. If NULL, the result replaces the contents of first, and
+ *     first's iterator is undefined. In case of failure, the contents of
+ *     outSet and first are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set or combine was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_INSUFFICIENT_AMOUNT - if combine returned a negative amount.
+ *     AS_SUCCESS - if the sets were merged successfully.
+ */
+AmountSetResult asMerge(AmountSet first, AmountSet second, AmountSetCombiner combine, AmountSet* outSet);
+
+/**
+ * asIntersect: Creates a set with the elements found in both sets.
+ *
+ * Walks both sets once in order, in O(n+m) time, with the amounts of every
+ * element combined. The sets' iterators are unchanged.
+ *
+ * @param first - The first set.
+ * @param second - The second set. May be the same set as first.
+ * @param combine - Function combining the amounts of the elements.
+ * @param outSet - Pointer to the location where the new set is returned, in
+ *     case of success. If NULL, the result replaces the contents of first, and
+ *     first's iterator is undefined. In case of failure, the contents of
+ *     outSet and first are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set or combine was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_INSUFFICIENT_AMOUNT - if combine returned a negative amount.
+ *     AS_SUCCESS - if the sets were intersected successfully.
+ */
+AmountSetResult asIntersect(AmountSet first, AmountSet second, AmountSetCombiner combine, AmountSet* outSet);
+
+/**
+ * asSubtract: Creates a set with the elements of the first set that are not
+ * in the second set, with their amounts in the first set.
+ *
+ * Walks both sets once in order, in O(n+m) time. The sets' iterators are
+ * unchanged.
+ *
+ * @param first - The set to subtract from.
+ * @param second - The set of elements to leave out. May be the same set as first.
+ * @param outSet - Pointer to the location where the new set is returned, in
+ *     case of success. If NULL, the result replaces the contents of first, and
+ *     first's iterator is undefined. In case of failure, the contents of
+ *     outSet and first are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_SUCCESS - if the set was subtracted successfully.
+ */
+AmountSetResult asSubtract(AmountSet first, AmountSet second, AmountSet* outSet);
+
+/** asCombineSum: Combiner returning the sum of the amounts. */
+double asCombineSum(double firstAmount, double secondAmount);
+
+/** asCombineMin: Combiner returning the smaller of the amounts. */
+double asCombineMin(double firstAmount, double secondAmount);
+
+/** asCombineMax: Combiner returning the larger of the amounts. */
+double asCombineMax(double firstAmount, double secondAmount);
+
+/**
+ * asTopK: Returns the k elements of the set with the largest amounts, in
+ * descending order of amount. Elements with equal amounts are ordered
+ * alphabetically.
+ *
+ * The set keeps its elements ordered by amount, so this takes O(k) time.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param k - The maximal number of elements to return.
+ * @param outElements - Array of at least k places where the elements (and not
+ *     copies of them) are returned.
+ * @param outAmounts - Array of at least k places where the elements' amounts
+ *     are returned. May be NULL.
+ * @return
+ *     -1 if a NULL set or outElements was sent, or k is negative.
+ *     Otherwise the number of elements returned, the smaller of k and the set's size.
+ */
+int asTopK(AmountSet set, int k, const char** outElements, double* outAmounts);
+
+/**
+ * asRankOf: Returns the position of an element in the set's elements ordered
+ * as by asTopK, starting from 1 for the element with the largest amount.
+ *
+ * Takes O(log n) expected time. Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param element - The element whose rank is requested.
+ * @return
+ *     -1 if a NULL argument was sent.
+ *     0 if the element doesn't exist in the set.
+ *     Otherwise the element's rank.
+ */
+int asRankOf(AmountSet set, const char* element);
+
+/**
+ * asFreeze: Converts the set to a compact read-only representation, for sets
+ * that are read much more often than they are changed.
+ *
+ * A frozen set keeps its elements in one contiguous block: the amounts in an
+ * array, and the elements one after the other with an array of their offsets.
+ * Scans (iteration, range queries, asSumAmounts, asCountBelow) run over
+ * contiguous memory, and lookups use a binary search. Copies of a frozen set
+ * are frozen as well.
+ * Changing a frozen set thaws it first (see asThaw). Freezing takes linear
+ * time, plus sorting the amounts to record the amount order.
+ * Iterator's value is undefined after this operation, and elements returned
+ * before are no longer valid.
+ *
+ * @param set - The set to freeze.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL pointer was sent.
+ *     AS_OUT_OF_MEMORY - if an allocation failed, the set is unchanged.
+ *     AS_SUCCESS - if the set was frozen or already frozen.
+ */
+AmountSetResult asFreeze(AmountSet set);
+
+/**
+ * asThaw: Converts a frozen set back to its changeable representation, in
+ * linear time.
+ *
+ * Iterator's state is kept, but elements returned before are no longer valid.
+ *
+ * @param set - The set to thaw.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL pointer was sent.
+ *     AS_OUT_OF_MEMORY - if an allocation failed, the set is unchanged.
+ *     AS_SUCCESS - if the set was thawed or wasn't frozen.
+ */
+AmountSetResult asThaw(AmountSet set);
+
+/**
+ * asIsFrozen: Checks if the set is frozen, see asFreeze.
+ *
+ * @param set - The set to check.
+ * @return
+ *     false - if a NULL pointer was sent or the set isn't frozen.
+ *     true - if the set is frozen.
+ */
+bool asIsFrozen(AmountSet set);
+
+/**
+ * asSumAmounts: Returns the total amount of the set's elements.
+ *
+ * Runs over the amounts array of a frozen set, and over the elements in order
+ * otherwise, so the result may differ in rounding between the two.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to sum.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     Otherwise the sum of the amounts of all elements.
+ */
+double asSumAmounts(AmountSet set);
+
+/**
+ * asCountBelow: Returns the number of elements whose amount is smaller than a
+ * threshold.
+ *
+ * Runs over the amounts array of a frozen set, and over the elements otherwise.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param threshold - The amount to compare to.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     Otherwise the number of elements whose amount is smaller than threshold.
+ */
+int asCountBelow(AmountSet set, double threshold);
+
+/**
+ * asGetTotalAmount: Returns the total amount of the set's elements, in
+ * constant time.
+ *
+ * The set keeps a running total, updated by every change of an amount with
+ * compensated summation, so it stays accurate to about the last bit however
+ * many changes were made, unlike adding the amounts in order (see asSumAmounts).
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     Otherwise the sum of the amounts of all elements.
+ */
+double asGetTotalAmount(AmountSet set);
+
+/**
+ * asCountPositive: Returns the number of elements whose amount is above 0,
+ * in constant time.
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     Otherwise the number of elements whose amount is above 0.
+ */
+int asCountPositive(AmountSet set);
+
+/**
+ * asGetMinAmount: Returns the smallest amount of the set's elements, in
+ * constant time.
+ *
+ * The smallest amount is the last of the set's order by amount (see asTopK),
+ * which the set keeps track of.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param outAmount - Pointer to the location where the amount is returned, in case
+ *     of success. In case of failure, the contents of outAmount are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the set is empty.
+ *     AS_SUCCESS - if the amount was returned successfully.
+ */
+AmountSetResult asGetMinAmount(AmountSet set, double* outAmount);
+
+/**
+ * asGetMaxAmount: Returns the largest amount of the set's elements, in
+ * constant time.
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param outAmount - Pointer to the location where the amount is returned, in case
+ *     of success. In case of failure, the contents of outAmount are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the set is empty.
+ *     AS_SUCCESS - if the amount was returned successfully.
+ */
+AmountSetResult asGetMaxAmount(AmountSet set, double* outAmount);
+
+/**
+ * asGetFingerStats: Returns how often adding or deleting an element started
+ * its search from the position of the previous addition or deletion.
+ *
+ * The set remembers where it was last changed. A search for a larger element
+ * starts there and takes time logarithmic in the distance from it rather than
+ * in the set's size, so adding or deleting elements in ascending order takes
+ * amortized constant time. Lookups of single elements don't search in order and
+ * aren't counted. Copies start with the counts of the set they were made from.
+ *
+ * @param set - The set to query.
+ * @param outHits - Pointer to the location where the number of searches that
+ *     started from the previous position is returned.
+ * @param outMisses - Pointer to the location where the number of searches that
+ *     started from the first element is returned.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_SUCCESS - otherwise.
+ */
+AmountSetResult asGetFingerStats(AmountSet set, long* outHits, long* outMisses);
+
+/**
+ * asSaveBinary: Writes the set's elements and amounts to a binary snapshot
+ * file, which can be opened with asOpenMapped.
+ *
+ * The file holds the frozen representation of the set (see asFreeze): the
+ * amounts, the elements' offsets, the amount order, the elements themselves
+ * and a checksum. Numbers are written in the machine's byte order, a file is
+ * only valid on machines with the same byte order.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to save.
+ * @param path - The path of the file to create or overwrite.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_IO_ERROR - if writing the file failed, its contents are undefined.
+ *     AS_SUCCESS - if the file was written successfully.
+ */
+AmountSetResult asSaveBinary(AmountSet set, const char* path);
+
+/**
+ * asOpenMapped: Creates a frozen set from a binary snapshot file written by
+ * asSaveBinary.
+ *
+ * The file is mapped into memory and the set's elements are served from the
+ * mapping directly, without parsing or allocating per element. Opening reads
+ * the file sequentially to verify its checksum, but doesn't copy it. The file
+ * must not be changed while the set is frozen. The first change of the set
+ * copies its elements into memory (see asThaw), the file is never written.
+ *
+ * @param path - The path of the file to open.
+ * @param outSet - Pointer to the location where the new set is returned, in
+ *     case of success. In case of failure, the contents of outSet are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_IO_ERROR - if opening or mapping the file failed.
+ *     AS_INVALID_FILE - if the file is not a valid snapshot, or its checksum
+ *         doesn't match its contents.
+ *     AS_SUCCESS - if the set was opened successfully.
+ */
+AmountSetResult asOpenMapped(const char* path, AmountSet* outSet);
+
+/**
+ * asLoadStream: Adds the elements of a text stream of lines to the set, each
+ * line being an element, spaces or tabs, and the element's amount.
+ *
+ * The amount is a decimal number, which may have a fraction and an exponent.
+ * The element is what comes before the last run of spaces or tabs of the line,
+ * and may itself contain spaces. Blank lines are skipped, and a line may end
+ * with "\r\n". Every line adds its amount to its element, registering the
+ * element first if it is not in the set, as asUpsertAmount does.
+ * The stream is read in large blocks and parsed without scanf. Into an empty
+ * set, elements that come in ascending order are appended without searching,
+ * in linear time, like with asCreateFromArrays. Elements are searched for from
+ * the first one out of order on.
+ * Lines before a failing line are kept in the set, the failing line and the
+ * lines after it are not. Loading into an empty set drops the changes recorded
+ * by asEnableJournal, like asMerge into the set does.
+ * Iterator's value is undefined after this operation.
+ *
+ * @param set - The set to add the elements to.
+ * @param stream - The stream to read, up to its end.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_IO_ERROR - if reading the stream failed.
+ *     AS_INVALID_FILE - if a line has no amount, or it isn't a finite number.
+ *     AS_INSUFFICIENT_AMOUNT - if a line has a negative amount.
+ *     AS_SUCCESS - if all lines were added successfully.
+ */
+AmountSetResult asLoadStream(AmountSet set, FILE* stream);
+
+/**
+ * asDumpStream: Writes the set's elements to a text stream, one "element
+ * amount" line each, in the set's order.
+ *
+ * Amounts are written exactly: asLoadStream reads back the same amounts. Amounts
+ * with few decimals are written in plain decimal without calling printf, like
+ * "12" or "0.25", other amounts as by "%.17g". The output is written in large
+ * blocks. Elements containing line breaks, or ending with a space or a tab,
+ * don't read back as the same elements.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to write.
+ * @param stream - The stream to write to.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_IO_ERROR - if writing the stream failed, part of the lines may have
+ *         been written.
+ *     AS_SUCCESS - if all elements were written successfully.
+ */
+AmountSetResult asDumpStream(AmountSet set, FILE* stream);
+
+/**
+ * asEnableJournal: Starts recording the set's changes in a journal, so that
+ * copies of the set can be kept up to date without copying it again.
+ *
+ * Every successful asRegister, asChangeAmount, asUpsertAmount, asDelete and
+ * asClear of the set is recorded with the next sequence number, starting from
+ * 1. The journal keeps the last capacity changes, older ones are overwritten.
+ * Changes that can't be recorded as single elements (asMerge, asIntersect and
+ * asSubtract into the set) drop the recorded changes, and reading from before
+ * them fails with AS_JOURNAL_OVERFLOW.
+ * To follow the set, take a copy with asCopy together with asGetSequence, then
+ * read the changes since that sequence number from time to time and apply them
+ * to the copy with asApplyChanges. Copies of the set don't have a journal.
+ *
+ * @param set - The set whose changes are recorded.
+ * @param capacity - The number of changes to keep. 0 stops recording and
+ *     frees the journal. Calling it again with a new capacity drops the
+ *     recorded changes, the sequence numbers continue.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL pointer was sent or capacity is negative.
+ *     AS_OUT_OF_MEMORY - if an allocation failed, the journal is unchanged.
+ *     AS_SUCCESS - if the journal was started or stopped successfully.
+ */
+AmountSetResult asEnableJournal(AmountSet set, int capacity);
+
+/**
+ * asGetSequence: Returns the sequence number of the set's last recorded change.
+ *
+ * @param set - The set to query.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     0 if the set doesn't have a journal or no change was recorded yet.
+ *     Otherwise the sequence number of the last change.
+ */
+long asGetSequence(AmountSet set);
+
+/**
+ * asReadChangesSince: Visits the recorded changes of the set after a sequence
+ * number, in the order they were made.
+ *
+ * Takes time linear in the number of visited changes.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set whose journal is read.
+ * @param sequence - The sequence number of the last change already seen, 0
+ *     to read from the first change.
+ * @param visitor - Function called for every change, until it returns false.
+ * @param context - Pointer passed as is to visitor.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set or visitor was passed.
+ *     AS_JOURNAL_OVERFLOW - if some changes after sequence are no longer in the
+ *         journal (or were never recorded), or sequence is after the last
+ *         change. Nothing is visited, a copy following the set must be taken again.
+ *     AS_SUCCESS - otherwise.
+ */
+AmountSetResult asReadChangesSince(AmountSet set, long sequence, AmountSetChangeVisitor visitor, void* context);
+
+/**
+ * asApplyChanges: Makes recorded changes of another set to a set, in order.
+ *
+ * Stops at the first change that fails, the changes before it are kept.
+ * Changes made to a set with a journal are recorded in its own journal.
+ *
+ * @param set - The set to change.
+ * @param changes - The changes to apply, as read by asReadChangesSince.
+ * @param count - The number of changes.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL set or changes was passed, or count is negative.
+ *     The result of the failed change - if a change failed, as returned by
+ *         asRegister, asChangeAmount, asDelete or asClear.
+ *     AS_SUCCESS - if all changes were applied.
+ */
+AmountSetResult asApplyChanges(AmountSet set, const AmountSetChange* changes, int count);
+
+/**
+ * asGetStats: Returns the set's operation counters and the memory it holds,
+ * to find out why operations on a set are slow.
+ *
+ * Counting is compiled in only when AS_STATS is defined (make amount_set_str_stats),
+ * and costs nothing otherwise. Long searches point at unlucky skip list
+ * levels, many index probes at colliding hashes, and many string comparisons
+ * at elements sharing long prefixes.
+ * The memory footprint is always returned, and takes time linear in the
+ * number of memory blocks of the set. Copies start with the counters of the
+ * set they were made from.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @param outStats - Pointer to the location where the counters are returned.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_SUCCESS - otherwise.
+ */
+AmountSetResult asGetStats(AmountSet set, AmountSetStats* outStats);
+
+/**
+ * asEnableFilter: Starts keeping a Bloom filter of the set's elements, so that
+ * most lookups of missing elements are answered without searching the set.
+ *
+ * asContains and asGetAmount of an element that isn't in the set return
+ * right away, except for about falsePositiveRate of them. Lookups of elements
+ * in the set, and of the rest of the missing ones, search the set as before.
+ * The filter reserves room for twice the set's size when it is built, taking
+ * about 1.5 * log2(1 / falsePositiveRate) bits for each of those elements, and
+ * is most useful for frozen and mapped sets, whose searches are longest.
+ * asRegister and asUpsertAmount add to the filter. The filter is rebuilt by
+ * the change that doubles the set's size since it was built, or deletes a
+ * quarter of that size, and by asMerge, asIntersect or asSubtract into the
+ * set, so lookups only read it. Copies of the set don't have a filter.
+ *
+ * @param set - The set whose lookups are filtered.
+ * @param falsePositiveRate - The share of lookups of missing elements that
+ *     still search the set, between 0 and 1. 0 stops filtering and frees the filter.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL pointer was sent or falsePositiveRate is
+ *         negative or at least 1.
+ *     AS_OUT_OF_MEMORY - if an allocation failed, the filter is unchanged.
+ *     AS_SUCCESS - if the filter was started or stopped successfully.
+ */
+AmountSetResult asEnableFilter(AmountSet set, double falsePositiveRate);
+
+/**
+ * asFindHandle: Returns a handle to an element of the set, through which its
+ * amount is read and changed without searching for the element.
+ *
+ * The handle belongs to the set, and is freed by asHandleRelease or when the
+ * set is destroyed. Finding the same element again returns the same handle,
+ * found by the element's hash among the set's handles. Handles are meant to be
+ * found once for elements changed often. A handle keeps the element's position
+ * in the set, and only searches for it again the first time it is used after
+ * its element was deleted, the set was copied, frozen or thawed, or elements
+ * were added to or deleted from a set of up to 16 elements. Deleting other
+ * elements of a larger set doesn't make the handle search again.
+ * A handle stays valid while its element is in the set. Once the element is
+ * deleted the handle's functions return AS_ITEM_DOES_NOT_EXIST, and work
+ * again if the element is registered again. Builds without NDEBUG check that
+ * a kept position still holds the handle's element.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set containing the element.
+ * @param element - The element to find.
+ * @return
+ *     NULL if a NULL pointer was sent, the element is not in the set, or an
+ *         allocation failed.
+ *     A handle to the element otherwise.
+ */
+AmountSetHandle asFindHandle(AmountSet set, const char* element);
+
+/**
+ * asHandleGetAmount: Returns the amount of a handle's element.
+ *
+ * Takes constant time, unless the handle searches for its element again
+ * (see asFindHandle).
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param handle - The handle, as returned by asFindHandle.
+ * @param outAmount - Pointer to the location where the amount is returned, in case
+ *     of success. In case of failure, the contents of outAmount are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element was deleted from the set.
+ *     AS_SUCCESS - if the amount was returned successfully.
+ */
+AmountSetResult asHandleGetAmount(AmountSetHandle handle, double* outAmount);
+
+/**
+ * asHandleChangeAmount: Increase or decrease the amount of a handle's element,
+ * like asChangeAmount without searching for the element.
+ *
+ * The element's amount is changed in constant time, and its place in the
+ * amount order (see asTopK) is updated in logarithmic time, as by asChangeAmount.
+ * The change is recorded in the set's journal like one made by asChangeAmount.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param handle - The handle, as returned by asFindHandle.
+ * @param amount - How much to change the element's amount.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL handle was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element was deleted from the set.
+ *     AS_INSUFFICIENT_AMOUNT - if the change will result in a negative amount,
+ *         the amount is unchanged.
+ *     AS_SUCCESS - if the element's amount was changed successfully.
+ */
+AmountSetResult asHandleChangeAmount(AmountSetHandle handle, double amount);
+
+/**
+ * asHandleRelease: Frees a handle before its set is destroyed.
+ *
+ * The handle must not be used afterwards. Finding the element again returns a
+ * new handle. The set and its iterator are unchanged.
+ *
+ * @param handle - The handle to free, as returned by asFindHandle. If handle
+ *     is NULL nothing will be done.
+ */
+void asHandleRelease(AmountSetHandle handle);
+
 #endif /* AMOUNT_SET_STR_H_ */
@@ -0,0 +1,487 @@
+#define _POSIX_C_SOURCE 200809L
+#include "amount_set_str_concurrent.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define ASC_TABLE_INITIAL_CAPACITY 16
+#define ASC_READER_STRIPES 64
+#define ASC_READER_STRIPE_BITS 6
+#define ASC_CACHE_LINE 64
+#define ASC_RETIRE_BATCH 64
+#define ASC_FNV_OFFSET_BASIS 2166136261u
+#define ASC_FNV_PRIME 16777619u
+#define ASC_GOLDEN_RATIO 0x9E3779B97F4A7C15ull
+
+/** An element as seen by readers. Only the amount changes after the entry is published. **/
+typedef struct AmountSetEntry_t *AmountSetEntry;
+struct AmountSetEntry_t
+{
+    double amount; // Accessed atomically
+    size_t length;
+    unsigned int hash;
+    char element[];
+};
+
+/** Open-addressing hash table published to readers, an empty slot is NULL. **/
+typedef struct AmountSetTable_t *AmountSetTable;
+struct AmountSetTable_t
+{
+    unsigned int capacity;
+    AmountSetEntry slots[];
+};
+
+/** A count of active readers, padded so that stripes don't share cache lines. **/
+typedef struct AmountSetReaderCount_t
+{
+    unsigned long count;
+    char padding[ASC_CACHE_LINE - sizeof(unsigned long)];
+} AmountSetReaderCount;
+
+struct AmountSetConcurrent_t
+{
+    AmountSetTable table; // Published to readers, replaced when growing
+    int size;             // Read by readers
+    unsigned int epoch;
+    AmountSetReaderCount readers[2][ASC_READER_STRIPES];
+
+    // Writer side, protected by writer_lock
+    pthread_mutex_t writer_lock;
+    AmountSet ordered;
+    unsigned int table_used;
+    void **retired;
+    int retired_count;
+    int retired_capacity;
+};
+
+/** Marks table slots whose entry was deleted, so that probing continues past them. **/
+static struct AmountSetEntry_t asc_tombstone;
+#define ASC_TOMBSTONE (&asc_tombstone)
+
+/**
+ * ascHashElement: Computes the FNV-1a hash of an element, and its length.
+ *
+ * @param element The element to hash.
+ * @param out_length The variable to return the element's length in.
+ * @return
+ *      The hash of the element.
+ * **/
+static unsigned int ascHashElement(const char *element, size_t *out_length);
+
+/**
+ * ascReadBegin: Announces a reader, so that writers don't free memory it can still see.
+ *
+ * @param set The set about to be read.
+ * @return
+ *      The reader count that was incremented, to be passed to ascReadEnd.
+ * **/
+static unsigned long *ascReadBegin(AmountSetConcurrent set);
+
+/**
+ * ascReadEnd: Announces that a reader finished.
+ *
+ * @param count The reader count returned by ascReadBegin.
+ * **/
+static void ascReadEnd(unsigned long *count);
+
+/**
+ * ascTableFind: Finds the entry of an element in a table.
+ *
+ * Safe to call from readers, examines at most the table's capacity of slots.
+ *
+ * @param table The table to search in.
+ * @param element The element to match.
+ * @param hash The element's hash.
+ * @param length The element's length.
+ * @param out_entry The variable to return the entry found in the slot in, may be NULL.
+ * @return
+ *      NULL - if the element doesn't exist in the table.
+ *      The pointer to the element's slot otherwise.
+ * **/
+static AmountSetEntry *ascTableFind(AmountSetTable table, const char *element, unsigned int hash, size_t length,
+                                    AmountSetEntry *out_entry);
+
+/**
+ * ascTableInsert: Publishes a new entry to readers, growing the table if needed.
+ *
+ * Called with the writer lock held.
+ *
+ * @param set The set whose table is updated.
+ * @param entry The entry to add, must not already be in the table.
+ * @return
+ *      AS_OUT_OF_MEMORY - if growing the table failed, the table is unchanged.
+ *      AS_SUCCESS - if the entry was added.
+ * **/
+static AmountSetResult ascTableInsert(AmountSetConcurrent set, AmountSetEntry entry);
+
+/**
+ * ascRetire: Frees memory once no reader can see it anymore.
+ *
+ * Called with the writer lock held, after the memory was unlinked from the
+ * published table. Memory is freed in batches to spread the cost of waiting
+ * for readers.
+ *
+ * @param set The set the memory was unlinked from.
+ * @param memory The memory to free.
+ * **/
+static void ascRetire(AmountSetConcurrent set, void *memory);
+
+/**
+ * ascSynchronize: Waits until all readers that started before the call have finished.
+ *
+ * Called with the writer lock held. Flips the epoch twice, waiting each time for
+ * the readers counted under the previous parity to drain, so that readers that
+ * keep arriving can't starve the writer.
+ *
+ * @param set The set whose readers are waited for.
+ * **/
+static void ascSynchronize(AmountSetConcurrent set);
+
+/**
+ * ascFreeRetired: Frees all retired memory after waiting for readers.
+ *
+ * @param set The set whose retired memory is freed.
+ * **/
+static void ascFreeRetired(AmountSetConcurrent set);
+
+AmountSetConcurrent asConcurrentCreate()
+{
+    AmountSetConcurrent new_set = malloc(sizeof(*new_set));
+    if (!new_set)
+        return NULL;
+
+    new_set->table = calloc(1, sizeof(*new_set->table) + ASC_TABLE_INITIAL_CAPACITY * sizeof(AmountSetEntry));
+    new_set->ordered = asCreate();
+    if (!new_set->table || !new_set->ordered || pthread_mutex_init(&new_set->writer_lock, NULL) != 0)
+    {
+        free(new_set->table);
+        asDestroy(new_set->ordered);
+        free(new_set);
+        return NULL;
+    }
+
+    new_set->table->capacity = ASC_TABLE_INITIAL_CAPACITY;
+    new_set->size = 0;
+    new_set->epoch = 0;
+    memset(new_set->readers, 0, sizeof(new_set->readers));
+    new_set->table_used = 0;
+    new_set->retired = NULL;
+    new_set->retired_count = 0;
+    new_set->retired_capacity = 0;
+
+    return new_set;
+}
+
+void asConcurrentDestroy(AmountSetConcurrent set)
+{
+    if (!set)
+        return;
+
+    ascFreeRetired(set);
+    for (unsigned int i = 0; i < set->table->capacity; i++)
+    {
+        if (set->table->slots[i] != ASC_TOMBSTONE)
+            free(set->table->slots[i]);
+    }
+
+    free(set->table);
+    free(set->retired);
+    asDestroy(set->ordered);
+    pthread_mutex_destroy(&set->writer_lock);
+    free(set);
+}
+
+AmountSet asConcurrentCopy(AmountSetConcurrent set)
+{
+    if (!set)
+        return NULL;
+
+    pthread_mutex_lock(&set->writer_lock);
+    AmountSet copy = asCopy(set->ordered);
+    pthread_mutex_unlock(&set->writer_lock);
+
+    return copy;
+}
+
+int asConcurrentGetSize(AmountSetConcurrent set)
+{
+    if (!set)
+        return -1;
+
+    return __atomic_load_n(&set->size, __ATOMIC_RELAXED);
+}
+
+bool asConcurrentContains(AmountSetConcurrent set, const char *element)
+{
+    if (!set || !element)
+        return false;
+
+    size_t length;
+    unsigned int hash = ascHashElement(element, &length);
+
+    unsigned long *reader = ascReadBegin(set);
+    AmountSetTable table = __atomic_load_n(&set->table, __ATOMIC_ACQUIRE);
+    bool found = ascTableFind(table, element, hash, length, NULL) != NULL;
+    ascReadEnd(reader);
+
+    return found;
+}
+
+AmountSetResult asConcurrentGetAmount(AmountSetConcurrent set, const char *element, double *outAmount)
+{
+    if (!set || !element || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    size_t length;
+    unsigned int hash = ascHashElement(element, &length);
+    AmountSetResult operation_result = AS_ITEM_DOES_NOT_EXIST;
+
+    unsigned long *reader = ascReadBegin(set);
+    AmountSetTable table = __atomic_load_n(&set->table, __ATOMIC_ACQUIRE);
+    AmountSetEntry entry;
+    if (ascTableFind(table, element, hash, length, &entry))
+    {
+        __atomic_load(&entry->amount, outAmount, __ATOMIC_RELAXED);
+        operation_result = AS_SUCCESS;
+    }
+    ascReadEnd(reader);
+
+    return operation_result;
+}
+
+AmountSetResult asConcurrentRegister(AmountSetConcurrent set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    size_t length;
+    unsigned int hash = ascHashElement(element, &length);
+    AmountSetEntry entry = malloc(sizeof(*entry) + length + 1);
+    if (!entry)
+        return AS_OUT_OF_MEMORY;
+
+    entry->amount = 0;
+    entry->length = length;
+    entry->hash = hash;
+    memcpy(entry->element, element, length + 1);
+
+    pthread_mutex_lock(&set->writer_lock);
+    AmountSetResult operation_result = asRegister(set->ordered, element);
+    if (operation_result == AS_SUCCESS)
+    {
+        operation_result = ascTableInsert(set, entry);
+        if (operation_result == AS_SUCCESS)
+            __atomic_store_n(&set->size, set->size + 1, __ATOMIC_RELAXED);
+        else
+            asDelete(set->ordered, element);
+    }
+    pthread_mutex_unlock(&set->writer_lock);
+
+    if (operation_result != AS_SUCCESS)
+        free(entry);
+
+    return operation_result;
+}
+
+AmountSetResult asConcurrentChangeAmount(AmountSetConcurrent set, const char *element, const double amount)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    size_t length;
+    unsigned int hash = ascHashElement(element, &length);
+
+    pthread_mutex_lock(&set->writer_lock);
+    AmountSetResult operation_result = asChangeAmount(set->ordered, element, amount);
+    if (operation_result == AS_SUCCESS)
+    {
+        double new_amount;
+        asGetAmount(set->ordered, element, &new_amount);
+        AmountSetEntry *slot = ascTableFind(set->table, element, hash, length, NULL);
+        assert(slot);
+        __atomic_store(&(*slot)->amount, &new_amount, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&set->writer_lock);
+
+    return operation_result;
+}
+
+AmountSetResult asConcurrentDelete(AmountSetConcurrent set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    size_t length;
+    unsigned int hash = ascHashElement(element, &length);
+
+    pthread_mutex_lock(&set->writer_lock);
+    AmountSetResult operation_result = asDelete(set->ordered, element);
+    if (operation_result == AS_SUCCESS)
+    {
+        AmountSetEntry *slot = ascTableFind(set->table, element, hash, length, NULL);
+        assert(slot);
+        AmountSetEntry entry = *slot;
+        __atomic_store_n(slot, ASC_TOMBSTONE, __ATOMIC_RELEASE);
+        __atomic_store_n(&set->size, set->size - 1, __ATOMIC_RELAXED);
+        ascRetire(set, entry);
+    }
+    pthread_mutex_unlock(&set->writer_lock);
+
+    return operation_result;
+}
+
+static unsigned int ascHashElement(const char *element, size_t *out_length)
+{
+    unsigned int hash = ASC_FNV_OFFSET_BASIS;
+    const unsigned char *current = (const unsigned char *)element;
+    while (*current)
+    {
+        hash ^= *current++;
+        hash *= ASC_FNV_PRIME;
+    }
+
+    *out_length = current - (const unsigned char *)element;
+    return hash;
+}
+
+static unsigned long *ascReadBegin(AmountSetConcurrent set)
+{
+    // Threads have distinct stacks, so a stack address spreads them over the stripes
+    int stack_marker;
+    unsigned long long stripe = ((uintptr_t)&stack_marker >> 12) * ASC_GOLDEN_RATIO >> (64 - ASC_READER_STRIPE_BITS);
+
+    unsigned int parity = __atomic_load_n(&set->epoch, __ATOMIC_SEQ_CST) & 1;
+    unsigned long *count = &set->readers[parity][stripe].count;
+    __atomic_fetch_add(count, 1, __ATOMIC_SEQ_CST);
+    return count;
+}
+
+static void ascReadEnd(unsigned long *count)
+{
+    __atomic_fetch_sub(count, 1, __ATOMIC_RELEASE);
+}
+
+static AmountSetEntry *ascTableFind(AmountSetTable table, const char *element, unsigned int hash, size_t length,
+                                    AmountSetEntry *out_entry)
+{
+    unsigned int mask = table->capacity - 1;
+    unsigned int position = hash & mask;
+    for (unsigned int probes = 0; probes < table->capacity; probes++, position = (position + 1) & mask)
+    {
+        AmountSetEntry entry = __atomic_load_n(&table->slots[position], __ATOMIC_ACQUIRE);
+        if (entry == NULL)
+            return NULL;
+
+        if (entry != ASC_TOMBSTONE && entry->hash == hash && entry->length == length &&
+            memcmp(entry->element, element, length) == 0)
+        {
+            if (out_entry)
+                *out_entry = entry;
+            return &table->slots[position];
+        }
+    }
+
+    return NULL;
+}
+
+static AmountSetResult ascTableInsert(AmountSetConcurrent set, AmountSetEntry entry)
+{
+    AmountSetTable table = set->table;
+
+    // Keep the table at most half full (including tombstones), growing into a new table
+    // that is published in one store, as readers may be probing the old one
+    if ((set->table_used + 1) * 2 > table->capacity)
+    {
+        unsigned int capacity = table->capacity;
+        if ((set->size + 1) * 2 > (int)capacity / 2)
+            capacity *= 2;
+
+        AmountSetTable new_table = calloc(1, sizeof(*new_table) + capacity * sizeof(AmountSetEntry));
+        if (!new_table)
+            return AS_OUT_OF_MEMORY;
+
+        new_table->capacity = capacity;
+        for (unsigned int i = 0; i < table->capacity; i++)
+        {
+            AmountSetEntry current = table->slots[i];
+            if (current == NULL || current == ASC_TOMBSTONE)
+                continue;
+
+            unsigned int position = current->hash & (capacity - 1);
+            while (new_table->slots[position] != NULL)
+                position = (position + 1) & (capacity - 1);
+            new_table->slots[position] = current;
+        }
+
+        __atomic_store_n(&set->table, new_table, __ATOMIC_RELEASE);
+        set->table_used = set->size;
+        ascRetire(set, table);
+        table = new_table;
+    }
+
+    unsigned int mask = table->capacity - 1;
+    unsigned int position = entry->hash & mask;
+    while (table->slots[position] != NULL && table->slots[position] != ASC_TOMBSTONE)
+        position = (position + 1) & mask;
+
+    if (table->slots[position] == NULL)
+        set->table_used++;
+
+    __atomic_store_n(&table->slots[position], entry, __ATOMIC_RELEASE);
+    return AS_SUCCESS;
+}
+
+static void ascRetire(AmountSetConcurrent set, void *memory)
+{
+    if (set->retired_count == set->retired_capacity)
+    {
+        int capacity = set->retired_capacity ? set->retired_capacity * 2 : ASC_RETIRE_BATCH;
+        void **retired = realloc(set->retired, capacity * sizeof(*retired));
+        if (!retired)
+        {
+            // No room to defer, pay for the wait now
+            ascSynchronize(set);
+            for (int i = 0; i < set->retired_count; i++)
+                free(set->retired[i]);
+
+            set->retired_count = 0;
+            free(memory);
+            return;
+        }
+
+        set->retired = retired;
+        set->retired_capacity = capacity;
+    }
+
+    set->retired[set->retired_count++] = memory;
+    if (set->retired_count >= ASC_RETIRE_BATCH)
+        ascFreeRetired(set);
+}
+
+static void ascSynchronize(AmountSetConcurrent set)
+{
+    for (int phase = 0; phase < 2; phase++)
+    {
+        unsigned int parity = __atomic_fetch_add(&set->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+        for (int stripe = 0; stripe < ASC_READER_STRIPES; stripe++)
+        {
+            while (__atomic_load_n(&set->readers[parity][stripe].count, __ATOMIC_SEQ_CST) != 0)
+                sched_yield();
+        }
+    }
+}
+
+static void ascFreeRetired(AmountSetConcurrent set)
+{
+    if (set->retired_count == 0)
+        return;
+
+    ascSynchronize(set);
+    for (int i = 0; i < set->retired_count; i++)
+        free(set->retired[i]);
+
+    set->retired_count = 0;
+}
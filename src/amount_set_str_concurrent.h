@@ -0,0 +1,149 @@
+#ifndef AMOUNT_SET_STR_CONCURRENT_H_
+#define AMOUNT_SET_STR_CONCURRENT_H_
+
+#include <stdbool.h>
+#include "amount_set_str.h"
+
+/**
+ * Concurrent Amount Set Container
+ *
+ * A thread-safe amount set for char*, for many threads reading amounts while
+ * other threads apply updates.
+ * Readers (asConcurrentContains, asConcurrentGetAmount, asConcurrentGetSize)
+ * never take a lock and never wait for writers, they finish in a bounded
+ * number of steps. Writers serialize on a lock. Memory of deleted elements is
+ * reclaimed only after all readers that could still see it have finished.
+ * There is no internal iterator, ordered iteration is done on a snapshot
+ * taken with asConcurrentCopy.
+ *
+ * The following functions are available:
+ *   asConcurrentCreate      - Creates a new empty set
+ *   asConcurrentDestroy     - Deletes an existing set and frees all resources
+ *   asConcurrentCopy        - Copies the set's contents into a regular AmountSet
+ *   asConcurrentGetSize     - Returns the size of the set
+ *   asConcurrentContains    - Checks if an element exists in the set
+ *   asConcurrentGetAmount   - Returns the amount of an element in the set
+ *   asConcurrentRegister    - Add a new element into the set
+ *   asConcurrentChangeAmount - Increase or decrease the amount of an element
+ *   asConcurrentDelete      - Delete an element completely from the set
+ */
+
+/** Type for defining the concurrent set */
+typedef struct AmountSetConcurrent_t *AmountSetConcurrent;
+
+/**
+ * asConcurrentCreate: Allocates a new empty concurrent amount set.
+ *
+ * @return
+ *     NULL - if allocations failed.
+ *     A new concurrent amount set in case of success.
+ */
+AmountSetConcurrent asConcurrentCreate();
+
+/**
+ * asConcurrentDestroy: Deallocates an existing concurrent amount set.
+ *
+ * No other thread may be using the set while it is destroyed.
+ *
+ * @param set - Target set to be deallocated. If set is NULL nothing will be done.
+ */
+void asConcurrentDestroy(AmountSetConcurrent set);
+
+/**
+ * asConcurrentCopy: Creates a regular amount set with the same elements (and
+ * amounts) as the concurrent set, at a single point in time.
+ *
+ * Waits for writers, meant for ordered iteration over the set's contents.
+ *
+ * @param set - Target set.
+ * @return
+ *     NULL if a NULL was sent or a memory allocation failed.
+ *     An amount set containing the same elements (and amounts) as set, otherwise.
+ */
+AmountSet asConcurrentCopy(AmountSetConcurrent set);
+
+/**
+ * asConcurrentGetSize: Returns the number of elements in a set.
+ *
+ * Never waits for writers.
+ *
+ * @param set - The set which size is requested.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     Otherwise the number of elements in the set.
+ */
+int asConcurrentGetSize(AmountSetConcurrent set);
+
+/**
+ * asConcurrentContains: Checks if an element exists in the set.
+ *
+ * Never waits for writers.
+ *
+ * @param set - The set to search in.
+ * @param element - The element to look for.
+ * @return
+ *     false - if the input set is null, or if the element was not found.
+ *     true - if the element was found in the set.
+ */
+bool asConcurrentContains(AmountSetConcurrent set, const char* element);
+
+/**
+ * asConcurrentGetAmount: Returns the amount of an element in the set.
+ *
+ * Never waits for writers.
+ *
+ * @param set - The set which contains the element.
+ * @param element - The element whose amount is requested.
+ * @param outAmount - Pointer to the location where the amount is returned, in case
+ *     of success. In case of failure, the contents of outAmount are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_SUCCESS - if the amount was returned successfully.
+ */
+AmountSetResult asConcurrentGetAmount(AmountSetConcurrent set, const char* element, double* outAmount);
+
+/**
+ * asConcurrentRegister: Add a new element into the set.
+ *
+ * The element is added with an initial amount of 0.
+ *
+ * @param set - The target set to which the element is added.
+ * @param element - The element to add.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_ALREADY_EXISTS - if an equal element already exists in the set.
+ *     AS_SUCCESS - if the element was added successfully.
+ */
+AmountSetResult asConcurrentRegister(AmountSetConcurrent set, const char* element);
+
+/**
+ * asConcurrentChangeAmount: Increase or decrease the amount of an element in the set.
+ *
+ * @param set - The target set containing the element.
+ * @param element - The element whose amount is changed.
+ * @param amount - How much to change the element's amount.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_INSUFFICIENT_AMOUNT - if the change will result in a negative amount,
+ *         the amount is unchanged.
+ *     AS_SUCCESS - if the element's amount was changed successfully.
+ */
+AmountSetResult asConcurrentChangeAmount(AmountSetConcurrent set, const char* element, double amount);
+
+/**
+ * asConcurrentDelete: Delete an element completely from the set.
+ *
+ * @param set - The target set from which the element is deleted.
+ * @param element - The element to delete.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_SUCCESS - if the element was deleted successfully.
+ */
+AmountSetResult asConcurrentDelete(AmountSetConcurrent set, const char* element);
+
+#endif /* AMOUNT_SET_STR_CONCURRENT_H_ */
@@ -7,15 +7,38 @@ int main()
     RUN_TEST(testCreate);
     RUN_TEST(testDestroy);
     RUN_TEST(testCopy);
+    RUN_TEST(testCreateFromArrays);
     RUN_TEST(testGetSize);
     RUN_TEST(testContains);
     RUN_TEST(testGetAmount);
     RUN_TEST(testRegister);
     RUN_TEST(testChangeAmount);
+    RUN_TEST(testUpsertAmount);
     RUN_TEST(testDelete);
     RUN_TEST(testClear);
     RUN_TEST(testGetFirst);
     RUN_TEST(testGetNext);
     RUN_TEST(testOrdered);
+    RUN_TEST(testOrderedLarge);
+    RUN_TEST(testIterator);
+    RUN_TEST(testRange);
+    RUN_TEST(testCopyOnWrite);
+    RUN_TEST(testLongElementOrder);
+    RUN_TEST(testSetAlgebra);
+    RUN_TEST(testTopK);
+    RUN_TEST(testFreeze);
+    RUN_TEST(testFingerSearch);
+    RUN_TEST(testSaveBinary);
+    RUN_TEST(testJournal);
+    RUN_TEST(testStats);
+    RUN_TEST(testSmallSet);
+    RUN_TEST(testFilter);
+    RUN_TEST(testHandle);
+    RUN_TEST(testRadix);
+    RUN_TEST(testParallel);
+    RUN_TEST(testSharded);
+    RUN_TEST(testStream);
+    RUN_TEST(testAggregates);
+    RUN_TEST(testConcurrent);
     return 0;
 }
\ No newline at end of file
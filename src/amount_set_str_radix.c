@@ -0,0 +1,957 @@
+#include "amount_set_str_radix.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define ASR_NODE4_CAPACITY 4
+#define ASR_NODE16_CAPACITY 16
+#define ASR_NODE48_CAPACITY 48
+#define ASR_NODE256_CAPACITY 256
+#define ASR_NODE16_SHRINK 3 // Inner nodes move to the smaller type at this number of children
+#define ASR_NODE48_SHRINK 12
+#define ASR_NODE256_SHRINK 40
+#define ASR_BYTES 256
+
+/** Kinds of nodes, inner nodes are ordered by the number of children they have room for. **/
+typedef enum AmountSetRadixType_t
+{
+    ASR_LEAF,
+    ASR_NODE4,
+    ASR_NODE16,
+    ASR_NODE48,
+    ASR_NODE256
+} AmountSetRadixType;
+
+/**
+ * Common start of the nodes of the tree.
+ * Elements are walked as bytes including their terminator, so that no element
+ * is a prefix of another. An inner node's prefix (the bytes shared by all the
+ * elements below it) and a leaf's suffix follow its type specific fields.
+ **/
+typedef struct AmountSetRadixNode_t *AmountSetRadixNode;
+struct AmountSetRadixNode_t
+{
+    uint8_t type;
+    uint16_t count; // Children of an inner node, 0 for a leaf
+    uint32_t length; // Bytes of the prefix of an inner node, or of the suffix of a leaf
+};
+
+/** An element, with its bytes past the byte that led to it. **/
+typedef struct AmountSetRadixLeaf_t
+{
+    struct AmountSetRadixNode_t node;
+    double amount;
+    char suffix[];
+} AmountSetRadixLeaf;
+
+/** Inner node of up to 4 children, sorted by their bytes. **/
+typedef struct AmountSetRadixNode4_t
+{
+    struct AmountSetRadixNode_t node;
+    unsigned char bytes[ASR_NODE4_CAPACITY];
+    AmountSetRadixNode children[ASR_NODE4_CAPACITY];
+    char prefix[];
+} AmountSetRadixNode4;
+
+/** Inner node of up to 16 children, sorted by their bytes. **/
+typedef struct AmountSetRadixNode16_t
+{
+    struct AmountSetRadixNode_t node;
+    unsigned char bytes[ASR_NODE16_CAPACITY];
+    AmountSetRadixNode children[ASR_NODE16_CAPACITY];
+    char prefix[];
+} AmountSetRadixNode16;
+
+/** Inner node of up to 48 children, positions[byte] is 1 + the child's position, 0 if there is none. **/
+typedef struct AmountSetRadixNode48_t
+{
+    struct AmountSetRadixNode_t node;
+    unsigned char positions[ASR_BYTES];
+    AmountSetRadixNode children[ASR_NODE48_CAPACITY];
+    char prefix[];
+} AmountSetRadixNode48;
+
+/** Inner node with a child for every byte, NULL if there is none. **/
+typedef struct AmountSetRadixNode256_t
+{
+    struct AmountSetRadixNode_t node;
+    AmountSetRadixNode children[ASR_NODE256_CAPACITY];
+    char prefix[];
+} AmountSetRadixNode256;
+
+struct AmountSetRadix_t
+{
+    AmountSetRadixNode root; // NULL if the set is empty
+    int size;
+    size_t max_length; // Of the longest element ever added, including its terminator
+    char *current; // Internal iterator's element
+    size_t current_capacity;
+    bool iterating; // false if the internal iterator is undefined
+};
+
+/**
+ * asrNodeSize: Returns the number of bytes a node takes.
+ *
+ * @param type The node's type.
+ * @param length The length of the node's prefix or suffix.
+ * @return
+ *      The node's size.
+ * **/
+static size_t asrNodeSize(AmountSetRadixType type, size_t length);
+
+/**
+ * asrBytes: Returns the prefix of an inner node, or the suffix of a leaf.
+ *
+ * @param node The node.
+ * @return
+ *      The node's bytes, node->length of them.
+ * **/
+static char *asrBytes(AmountSetRadixNode node);
+
+/**
+ * asrNodeCreate: Allocates a node without children.
+ *
+ * @param type The node's type.
+ * @param bytes The node's prefix or suffix.
+ * @param length The number of bytes.
+ * @return
+ *      NULL - if the allocation failed.
+ *      The new node otherwise.
+ * **/
+static AmountSetRadixNode asrNodeCreate(AmountSetRadixType type, const char *bytes, size_t length);
+
+/**
+ * asrNodeFree: Frees a node and all the nodes below it.
+ *
+ * @param node The node to free. If node is NULL nothing will be done.
+ * **/
+static void asrNodeFree(AmountSetRadixNode node);
+
+/**
+ * asrNodeMemory: Returns the number of bytes a node and the nodes below it take.
+ *
+ * @param node The node.
+ * @return
+ *      The bytes taken.
+ * **/
+static size_t asrNodeMemory(AmountSetRadixNode node);
+
+/**
+ * asrFindChild: Finds the child of an inner node for a byte.
+ *
+ * @param node The inner node.
+ * @param byte The byte leading to the child.
+ * @return
+ *      NULL - if the node has no child for the byte.
+ *      The node's pointer to the child otherwise.
+ * **/
+static AmountSetRadixNode *asrFindChild(AmountSetRadixNode node, unsigned char byte);
+
+/**
+ * asrNextChild: Finds the child of an inner node with the smallest byte not
+ * smaller than a byte.
+ *
+ * @param node The inner node.
+ * @param byte The byte to start from, updated to the child's byte.
+ * @return
+ *      NULL - if no child has such a byte.
+ *      The child otherwise.
+ * **/
+static AmountSetRadixNode asrNextChild(AmountSetRadixNode node, int *byte);
+
+/**
+ * asrInsertChild: Adds a child to an inner node that has room for it.
+ *
+ * @param node The inner node, must not have a child for byte.
+ * @param byte The byte leading to the child.
+ * @param child The child to add.
+ * **/
+static void asrInsertChild(AmountSetRadixNode node, unsigned char byte, AmountSetRadixNode child);
+
+/**
+ * asrResize: Moves the children of an inner node to a new node of another type.
+ *
+ * @param slot The pointer to the inner node, changed to the new node.
+ * @param type The new node's type, must have room for the node's children.
+ * @return
+ *      AS_OUT_OF_MEMORY - if the allocation failed, the node is unchanged.
+ *      AS_SUCCESS - if the node was replaced.
+ * **/
+static AmountSetResult asrResize(AmountSetRadixNode *slot, AmountSetRadixType type);
+
+/**
+ * asrAddChild: Adds a child to an inner node, growing it if it is full.
+ *
+ * @param slot The pointer to the inner node, changed if the node grows.
+ * @param byte The byte leading to the child, the node must not have a child for it.
+ * @param child The child to add.
+ * @return
+ *      AS_OUT_OF_MEMORY - if growing the node failed, the node is unchanged.
+ *      AS_SUCCESS - if the child was added.
+ * **/
+static AmountSetResult asrAddChild(AmountSetRadixNode *slot, unsigned char byte, AmountSetRadixNode child);
+
+/**
+ * asrRemoveChild: Removes a child from an inner node, shrinking the node or
+ * merging it with its last child when possible.
+ *
+ * @param slot The pointer to the inner node, changed if the node shrinks or is merged.
+ * @param byte The byte leading to the child to remove.
+ * **/
+static void asrRemoveChild(AmountSetRadixNode *slot, unsigned char byte);
+
+/**
+ * asrSplit: Replaces a node by a new inner node branching where an element
+ * parts from the node's bytes, with the node and a new leaf for the element
+ * as children.
+ *
+ * @param slot The pointer to the node, changed to the new inner node.
+ * @param common The number of bytes of the node shared with the element, less than the node's length.
+ * @param element The element's bytes from the node on.
+ * @param length The number of those bytes, including the terminator.
+ * @return
+ *      AS_OUT_OF_MEMORY - if an allocation failed, the node is unchanged.
+ *      AS_SUCCESS - if the element was added.
+ * **/
+static AmountSetResult asrSplit(AmountSetRadixNode *slot, size_t common, const char *element, size_t length);
+
+/**
+ * asrFindLeaf: Finds the leaf of an element.
+ *
+ * @param set The set to search in.
+ * @param element The element to find.
+ * @param out_parent Where to return the pointer to the leaf's parent, NULL
+ *      if the leaf is the root. May be NULL.
+ * @param out_byte Where to return the byte leading from the parent to the leaf. May be NULL.
+ * @return
+ *      NULL - if the element is not in the set.
+ *      The element's leaf otherwise.
+ * **/
+static AmountSetRadixLeaf *asrFindLeaf(AmountSetRadix set, const char *element, AmountSetRadixNode **out_parent,
+                                       unsigned char *out_byte);
+
+/**
+ * asrMinimum: Finds the smallest element below a node.
+ *
+ * @param node The node to search below.
+ * @param buffer Where the element is written, the bytes leading to node are already there.
+ * @param depth The number of bytes leading to node.
+ * @return
+ *      NULL - if there are no elements below the node.
+ *      The smallest element's leaf otherwise.
+ * **/
+static AmountSetRadixLeaf *asrMinimum(AmountSetRadixNode node, char *buffer, size_t depth);
+
+/**
+ * asrUpperBound: Finds the smallest element below a node greater than an element.
+ *
+ * The element is replaced by the found one in place. Bytes are only written
+ * once the search moved past the element, so they are never read again.
+ *
+ * @param node The node to search below.
+ * @param buffer The element, whose first depth bytes led to node.
+ * @param depth The number of bytes leading to node.
+ * @return
+ *      NULL - if there are no greater elements below the node.
+ *      The found element's leaf otherwise.
+ * **/
+static AmountSetRadixLeaf *asrUpperBound(AmountSetRadixNode node, char *buffer, size_t depth);
+
+/**
+ * asrReserve: Makes room for the longest element of a set in a buffer.
+ *
+ * @param set The set whose elements are written to the buffer.
+ * @param buffer The buffer, reallocated if needed.
+ * @param capacity The buffer's capacity, updated if it is reallocated.
+ * @return
+ *      AS_OUT_OF_MEMORY - if reallocating the buffer failed, it is unchanged.
+ *      AS_SUCCESS - otherwise.
+ * **/
+static AmountSetResult asrReserve(AmountSetRadix set, char **buffer, size_t *capacity);
+
+AmountSetRadix asRadixCreate()
+{
+    AmountSetRadix new_set = malloc(sizeof(*new_set));
+    if (!new_set)
+        return NULL;
+
+    new_set->root = NULL;
+    new_set->size = 0;
+    new_set->max_length = 0;
+    new_set->current = NULL;
+    new_set->current_capacity = 0;
+    new_set->iterating = false;
+    return new_set;
+}
+
+void asRadixDestroy(AmountSetRadix set)
+{
+    if (!set)
+        return;
+
+    asrNodeFree(set->root);
+    free(set->current);
+    free(set);
+}
+
+AmountSet asRadixCopy(AmountSetRadix set)
+{
+    if (!set)
+        return NULL;
+
+    AmountSet copy = asCreate();
+    char *buffer = NULL;
+    size_t capacity = 0;
+    if (!copy || asrReserve(set, &buffer, &capacity) != AS_SUCCESS)
+    {
+        asDestroy(copy);
+        return NULL;
+    }
+
+    // Elements come in order, so every one is added right after the last one
+    AmountSetRadixLeaf *leaf = set->root ? asrMinimum(set->root, buffer, 0) : NULL;
+    while (leaf)
+    {
+        if (asUpsertAmount(copy, buffer, leaf->amount, NULL) != AS_SUCCESS)
+        {
+            asDestroy(copy);
+            copy = NULL;
+            break;
+        }
+
+        leaf = asrUpperBound(set->root, buffer, 0);
+    }
+
+    free(buffer);
+    return copy;
+}
+
+int asRadixGetSize(AmountSetRadix set)
+{
+    if (!set)
+        return -1;
+
+    return set->size;
+}
+
+bool asRadixContains(AmountSetRadix set, const char *element)
+{
+    if (!set || !element)
+        return false;
+
+    return asrFindLeaf(set, element, NULL, NULL) != NULL;
+}
+
+AmountSetResult asRadixGetAmount(AmountSetRadix set, const char *element, double *outAmount)
+{
+    if (!set || !element || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetRadixLeaf *leaf = asrFindLeaf(set, element, NULL, NULL);
+    if (!leaf)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    *outAmount = leaf->amount;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asRadixRegister(AmountSetRadix set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    size_t length = strlen(element) + 1;
+    if (length > UINT32_MAX)
+        return AS_OUT_OF_MEMORY;
+
+    AmountSetResult operation_result = AS_SUCCESS;
+    AmountSetRadixNode *slot = &set->root;
+    size_t depth = 0;
+    while (*slot)
+    {
+        AmountSetRadixNode node = *slot;
+        const char *bytes = asrBytes(node);
+        size_t common = 0;
+        while (common < node->length && depth + common < length && bytes[common] == element[depth + common])
+            common++;
+
+        if (node->type == ASR_LEAF && common == node->length && depth + common == length)
+            return AS_ITEM_ALREADY_EXISTS;
+
+        // Both end with a terminator, so a different leaf parts from the element before its end
+        if (common < node->length)
+        {
+            operation_result = asrSplit(slot, common, element + depth, length - depth);
+            break;
+        }
+
+        depth += node->length;
+        AmountSetRadixNode *child = asrFindChild(node, (unsigned char)element[depth]);
+        if (!child)
+        {
+            AmountSetRadixNode leaf = asrNodeCreate(ASR_LEAF, element + depth + 1, length - depth - 1);
+            operation_result = leaf ? asrAddChild(slot, (unsigned char)element[depth], leaf) : AS_OUT_OF_MEMORY;
+            if (operation_result != AS_SUCCESS)
+                free(leaf);
+
+            break;
+        }
+
+        slot = child;
+        depth++;
+    }
+
+    if (!*slot)
+    {
+        *slot = asrNodeCreate(ASR_LEAF, element, length);
+        if (!*slot)
+            operation_result = AS_OUT_OF_MEMORY;
+    }
+
+    if (operation_result != AS_SUCCESS)
+        return operation_result;
+
+    set->size++;
+    if (length > set->max_length)
+        set->max_length = length;
+
+    set->iterating = false;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asRadixChangeAmount(AmountSetRadix set, const char *element, double amount)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetRadixLeaf *leaf = asrFindLeaf(set, element, NULL, NULL);
+    if (!leaf)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    if (leaf->amount + amount < 0)
+        return AS_INSUFFICIENT_AMOUNT;
+
+    leaf->amount += amount;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asRadixDelete(AmountSetRadix set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetRadixNode *parent;
+    unsigned char byte;
+    AmountSetRadixLeaf *leaf = asrFindLeaf(set, element, &parent, &byte);
+    if (!leaf)
+        return AS_ITEM_DOES_NOT_EXIST;
+
+    if (parent)
+        asrRemoveChild(parent, byte);
+    else
+        set->root = NULL;
+
+    free(leaf);
+    set->size--;
+    set->iterating = false;
+    return AS_SUCCESS;
+}
+
+AmountSetResult asRadixClear(AmountSetRadix set)
+{
+    if (!set)
+        return AS_NULL_ARGUMENT;
+
+    asrNodeFree(set->root);
+    set->root = NULL;
+    set->size = 0;
+    set->iterating = false;
+    return AS_SUCCESS;
+}
+
+char *asRadixGetFirst(AmountSetRadix set)
+{
+    if (!set)
+        return NULL;
+
+    set->iterating = set->root && asrReserve(set, &set->current, &set->current_capacity) == AS_SUCCESS &&
+                     asrMinimum(set->root, set->current, 0) != NULL;
+    return set->iterating ? set->current : NULL;
+}
+
+char *asRadixGetNext(AmountSetRadix set)
+{
+    if (!set || !set->iterating)
+        return NULL;
+
+    set->iterating = asrUpperBound(set->root, set->current, 0) != NULL;
+    return set->iterating ? set->current : NULL;
+}
+
+size_t asRadixGetMemory(AmountSetRadix set)
+{
+    if (!set)
+        return 0;
+
+    return sizeof(*set) + set->current_capacity + (set->root ? asrNodeMemory(set->root) : 0);
+}
+
+static size_t asrNodeSize(AmountSetRadixType type, size_t length)
+{
+    switch (type)
+    {
+    case ASR_LEAF:
+        return sizeof(AmountSetRadixLeaf) + length;
+    case ASR_NODE4:
+        return sizeof(AmountSetRadixNode4) + length;
+    case ASR_NODE16:
+        return sizeof(AmountSetRadixNode16) + length;
+    case ASR_NODE48:
+        return sizeof(AmountSetRadixNode48) + length;
+    case ASR_NODE256:
+        break;
+    }
+
+    return sizeof(AmountSetRadixNode256) + length;
+}
+
+static char *asrBytes(AmountSetRadixNode node)
+{
+    switch ((AmountSetRadixType)node->type)
+    {
+    case ASR_LEAF:
+        return ((AmountSetRadixLeaf *)node)->suffix;
+    case ASR_NODE4:
+        return ((AmountSetRadixNode4 *)node)->prefix;
+    case ASR_NODE16:
+        return ((AmountSetRadixNode16 *)node)->prefix;
+    case ASR_NODE48:
+        return ((AmountSetRadixNode48 *)node)->prefix;
+    case ASR_NODE256:
+        return ((AmountSetRadixNode256 *)node)->prefix;
+    }
+
+    return NULL;
+}
+
+static AmountSetRadixNode asrNodeCreate(AmountSetRadixType type, const char *bytes, size_t length)
+{
+    // Zeroed, so that inner nodes start without children and leaves with an amount of 0
+    AmountSetRadixNode new_node = calloc(1, asrNodeSize(type, length));
+    if (!new_node)
+        return NULL;
+
+    new_node->type = type;
+    new_node->length = length;
+    memcpy(asrBytes(new_node), bytes, length);
+    return new_node;
+}
+
+static void asrNodeFree(AmountSetRadixNode node)
+{
+    if (!node)
+        return;
+
+    if (node->type != ASR_LEAF)
+    {
+        AmountSetRadixNode child;
+        for (int byte = 0; (child = asrNextChild(node, &byte)) != NULL; byte++)
+            asrNodeFree(child);
+    }
+
+    free(node);
+}
+
+static size_t asrNodeMemory(AmountSetRadixNode node)
+{
+    size_t memory = asrNodeSize(node->type, node->length);
+    if (node->type != ASR_LEAF)
+    {
+        AmountSetRadixNode child;
+        for (int byte = 0; (child = asrNextChild(node, &byte)) != NULL; byte++)
+            memory += asrNodeMemory(child);
+    }
+
+    return memory;
+}
+
+static AmountSetRadixNode *asrFindChild(AmountSetRadixNode node, unsigned char byte)
+{
+    unsigned char *bytes = NULL;
+    AmountSetRadixNode *children = NULL;
+    switch ((AmountSetRadixType)node->type)
+    {
+    case ASR_NODE4:
+        bytes = ((AmountSetRadixNode4 *)node)->bytes;
+        children = ((AmountSetRadixNode4 *)node)->children;
+        break;
+    case ASR_NODE16:
+        bytes = ((AmountSetRadixNode16 *)node)->bytes;
+        children = ((AmountSetRadixNode16 *)node)->children;
+        break;
+    case ASR_NODE48:
+    {
+        AmountSetRadixNode48 *node48 = (AmountSetRadixNode48 *)node;
+        return node48->positions[byte] ? &node48->children[node48->positions[byte] - 1] : NULL;
+    }
+    case ASR_NODE256:
+    {
+        AmountSetRadixNode256 *node256 = (AmountSetRadixNode256 *)node;
+        return node256->children[byte] ? &node256->children[byte] : NULL;
+    }
+    case ASR_LEAF:
+        return NULL;
+    }
+
+    // Bytes are sorted, the search stops at the first larger one
+    for (int i = 0; i < node->count && bytes[i] <= byte; i++)
+    {
+        if (bytes[i] == byte)
+            return &children[i];
+    }
+
+    return NULL;
+}
+
+static AmountSetRadixNode asrNextChild(AmountSetRadixNode node, int *byte)
+{
+    unsigned char *bytes = NULL;
+    AmountSetRadixNode *children = NULL;
+    switch ((AmountSetRadixType)node->type)
+    {
+    case ASR_NODE4:
+        bytes = ((AmountSetRadixNode4 *)node)->bytes;
+        children = ((AmountSetRadixNode4 *)node)->children;
+        break;
+    case ASR_NODE16:
+        bytes = ((AmountSetRadixNode16 *)node)->bytes;
+        children = ((AmountSetRadixNode16 *)node)->children;
+        break;
+    case ASR_NODE48:
+    {
+        AmountSetRadixNode48 *node48 = (AmountSetRadixNode48 *)node;
+        for (; *byte < ASR_BYTES; (*byte)++)
+        {
+            if (node48->positions[*byte])
+                return node48->children[node48->positions[*byte] - 1];
+        }
+        return NULL;
+    }
+    case ASR_NODE256:
+    {
+        AmountSetRadixNode256 *node256 = (AmountSetRadixNode256 *)node;
+        for (; *byte < ASR_BYTES; (*byte)++)
+        {
+            if (node256->children[*byte])
+                return node256->children[*byte];
+        }
+        return NULL;
+    }
+    case ASR_LEAF:
+        return NULL;
+    }
+
+    for (int i = 0; i < node->count; i++)
+    {
+        if (bytes[i] >= *byte)
+        {
+            *byte = bytes[i];
+            return children[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void asrInsertChild(AmountSetRadixNode node, unsigned char byte, AmountSetRadixNode child)
+{
+    unsigned char *bytes = NULL;
+    AmountSetRadixNode *children = NULL;
+    switch ((AmountSetRadixType)node->type)
+    {
+    case ASR_NODE4:
+        bytes = ((AmountSetRadixNode4 *)node)->bytes;
+        children = ((AmountSetRadixNode4 *)node)->children;
+        break;
+    case ASR_NODE16:
+        bytes = ((AmountSetRadixNode16 *)node)->bytes;
+        children = ((AmountSetRadixNode16 *)node)->children;
+        break;
+    case ASR_NODE48:
+    {
+        AmountSetRadixNode48 *node48 = (AmountSetRadixNode48 *)node;
+        assert(node->count < ASR_NODE48_CAPACITY && !node48->positions[byte]);
+        // Children are kept packed, see asrRemoveChild
+        node48->children[node->count] = child;
+        node48->positions[byte] = node->count + 1;
+        node->count++;
+        return;
+    }
+    case ASR_NODE256:
+        ((AmountSetRadixNode256 *)node)->children[byte] = child;
+        node->count++;
+        return;
+    case ASR_LEAF:
+        return;
+    }
+
+    int position = 0;
+    while (position < node->count && bytes[position] < byte)
+        position++;
+
+    memmove(bytes + position + 1, bytes + position, node->count - position);
+    memmove(children + position + 1, children + position, (node->count - position) * sizeof(*children));
+    bytes[position] = byte;
+    children[position] = child;
+    node->count++;
+}
+
+static AmountSetResult asrResize(AmountSetRadixNode *slot, AmountSetRadixType type)
+{
+    AmountSetRadixNode node = *slot;
+    AmountSetRadixNode new_node = asrNodeCreate(type, asrBytes(node), node->length);
+    if (!new_node)
+        return AS_OUT_OF_MEMORY;
+
+    AmountSetRadixNode child;
+    for (int byte = 0; (child = asrNextChild(node, &byte)) != NULL; byte++)
+        asrInsertChild(new_node, byte, child);
+
+    free(node);
+    *slot = new_node;
+    return AS_SUCCESS;
+}
+
+static AmountSetResult asrAddChild(AmountSetRadixNode *slot, unsigned char byte, AmountSetRadixNode child)
+{
+    AmountSetRadixNode node = *slot;
+    bool full = (node->type == ASR_NODE4 && node->count == ASR_NODE4_CAPACITY) ||
+                (node->type == ASR_NODE16 && node->count == ASR_NODE16_CAPACITY) ||
+                (node->type == ASR_NODE48 && node->count == ASR_NODE48_CAPACITY);
+    if (full && asrResize(slot, node->type + 1) != AS_SUCCESS)
+        return AS_OUT_OF_MEMORY;
+
+    asrInsertChild(*slot, byte, child);
+    return AS_SUCCESS;
+}
+
+static void asrRemoveChild(AmountSetRadixNode *slot, unsigned char byte)
+{
+    AmountSetRadixNode node = *slot;
+    unsigned char *bytes = NULL;
+    AmountSetRadixNode *children = NULL;
+    switch ((AmountSetRadixType)node->type)
+    {
+    case ASR_NODE4:
+        bytes = ((AmountSetRadixNode4 *)node)->bytes;
+        children = ((AmountSetRadixNode4 *)node)->children;
+        break;
+    case ASR_NODE16:
+        bytes = ((AmountSetRadixNode16 *)node)->bytes;
+        children = ((AmountSetRadixNode16 *)node)->children;
+        break;
+    case ASR_NODE48:
+    {
+        // The last child fills the hole, keeping the children packed
+        AmountSetRadixNode48 *node48 = (AmountSetRadixNode48 *)node;
+        int position = node48->positions[byte] - 1;
+        int last = node->count - 1;
+        if (position != last)
+        {
+            int last_byte = 0;
+            while (node48->positions[last_byte] != last + 1)
+                last_byte++;
+
+            node48->children[position] = node48->children[last];
+            node48->positions[last_byte] = position + 1;
+        }
+        node48->positions[byte] = 0;
+        node->count--;
+        break;
+    }
+    case ASR_NODE256:
+        ((AmountSetRadixNode256 *)node)->children[byte] = NULL;
+        node->count--;
+        break;
+    case ASR_LEAF:
+        return;
+    }
+
+    if (bytes)
+    {
+        int position = 0;
+        while (bytes[position] != byte)
+            position++;
+
+        memmove(bytes + position, bytes + position + 1, node->count - position - 1);
+        memmove(children + position, children + position + 1, (node->count - position - 1) * sizeof(*children));
+        node->count--;
+    }
+
+    // Shrinking and merging are only done if memory allows, the larger node stays correct
+    if (node->type == ASR_NODE4 && node->count == 1)
+    {
+        int child_byte = 0;
+        AmountSetRadixNode child = asrNextChild(node, &child_byte);
+        size_t length = node->length + 1 + child->length;
+        AmountSetRadixNode merged = length <= UINT32_MAX ? realloc(child, asrNodeSize(child->type, length)) : NULL;
+        if (!merged)
+            return;
+
+        // The node's prefix and the child's byte move to the front of the child's bytes
+        char *merged_bytes = asrBytes(merged);
+        memmove(merged_bytes + node->length + 1, merged_bytes, merged->length);
+        memcpy(merged_bytes, asrBytes(node), node->length);
+        merged_bytes[node->length] = (char)child_byte;
+        merged->length = length;
+        free(node);
+        *slot = merged;
+    }
+    else if ((node->type == ASR_NODE16 && node->count <= ASR_NODE16_SHRINK) ||
+             (node->type == ASR_NODE48 && node->count <= ASR_NODE48_SHRINK) ||
+             (node->type == ASR_NODE256 && node->count <= ASR_NODE256_SHRINK))
+    {
+        asrResize(slot, node->type - 1);
+    }
+}
+
+static AmountSetResult asrSplit(AmountSetRadixNode *slot, size_t common, const char *element, size_t length)
+{
+    AmountSetRadixNode node = *slot;
+    AmountSetRadixNode branch = asrNodeCreate(ASR_NODE4, element, common);
+    AmountSetRadixNode leaf = asrNodeCreate(ASR_LEAF, element + common + 1, length - common - 1);
+    if (!branch || !leaf)
+    {
+        free(branch);
+        free(leaf);
+        return AS_OUT_OF_MEMORY;
+    }
+
+    // The node keeps the bytes past the one it now branches on
+    char *bytes = asrBytes(node);
+    unsigned char node_byte = bytes[common];
+    memmove(bytes, bytes + common + 1, node->length - common - 1);
+    node->length -= common + 1;
+    AmountSetRadixNode shrunk = realloc(node, asrNodeSize(node->type, node->length));
+    if (shrunk)
+        node = shrunk;
+
+    asrInsertChild(branch, node_byte, node);
+    asrInsertChild(branch, (unsigned char)element[common], leaf);
+    *slot = branch;
+    return AS_SUCCESS;
+}
+
+static AmountSetRadixLeaf *asrFindLeaf(AmountSetRadix set, const char *element, AmountSetRadixNode **out_parent,
+                                       unsigned char *out_byte)
+{
+    size_t length = strlen(element) + 1;
+    AmountSetRadixNode *parent = NULL;
+    AmountSetRadixNode *slot = &set->root;
+    unsigned char byte = 0;
+    size_t depth = 0;
+    while (*slot && (*slot)->type != ASR_LEAF)
+    {
+        // A matching prefix doesn't contain the terminator, so a byte follows it
+        AmountSetRadixNode node = *slot;
+        if (node->length >= length - depth || memcmp(asrBytes(node), element + depth, node->length) != 0)
+            return NULL;
+
+        depth += node->length;
+        byte = (unsigned char)element[depth];
+        parent = slot;
+        slot = asrFindChild(node, byte);
+        if (!slot)
+            return NULL;
+
+        depth++;
+    }
+
+    AmountSetRadixNode node = *slot;
+    if (!node || node->length != length - depth || memcmp(asrBytes(node), element + depth, node->length) != 0)
+        return NULL;
+
+    if (out_parent)
+        *out_parent = parent;
+
+    if (out_byte)
+        *out_byte = byte;
+
+    return (AmountSetRadixLeaf *)node;
+}
+
+static AmountSetRadixLeaf *asrMinimum(AmountSetRadixNode node, char *buffer, size_t depth)
+{
+    memcpy(buffer + depth, asrBytes(node), node->length);
+    if (node->type == ASR_LEAF)
+        return (AmountSetRadixLeaf *)node;
+
+    depth += node->length;
+    AmountSetRadixNode child;
+    for (int byte = 0; (child = asrNextChild(node, &byte)) != NULL; byte++)
+    {
+        // Only an inner node left without children for lack of memory is empty
+        buffer[depth] = (char)byte;
+        AmountSetRadixLeaf *leaf = asrMinimum(child, buffer, depth + 1);
+        if (leaf)
+            return leaf;
+    }
+
+    return NULL;
+}
+
+static AmountSetRadixLeaf *asrUpperBound(AmountSetRadixNode node, char *buffer, size_t depth)
+{
+    const char *bytes = asrBytes(node);
+    size_t common = 0;
+    while (common < node->length && bytes[common] == buffer[depth + common])
+        common++;
+
+    // The element ends with a terminator, nothing follows it, so they differ before its end
+    if (common < node->length)
+    {
+        if ((unsigned char)bytes[common] < (unsigned char)buffer[depth + common])
+            return NULL;
+
+        return asrMinimum(node, buffer, depth);
+    }
+
+    if (node->type == ASR_LEAF)
+        return NULL;
+
+    depth += node->length;
+    int byte = (unsigned char)buffer[depth];
+    AmountSetRadixNode *slot = asrFindChild(node, byte);
+    if (slot)
+    {
+        AmountSetRadixLeaf *leaf = asrUpperBound(*slot, buffer, depth + 1);
+        if (leaf)
+            return leaf;
+    }
+
+    AmountSetRadixNode child;
+    for (byte++; (child = asrNextChild(node, &byte)) != NULL; byte++)
+    {
+        buffer[depth] = (char)byte;
+        AmountSetRadixLeaf *leaf = asrMinimum(child, buffer, depth + 1);
+        if (leaf)
+            return leaf;
+    }
+
+    return NULL;
+}
+
+static AmountSetResult asrReserve(AmountSetRadix set, char **buffer, size_t *capacity)
+{
+    if (*capacity >= set->max_length)
+        return AS_SUCCESS;
+
+    char *new_buffer = realloc(*buffer, set->max_length);
+    if (!new_buffer)
+        return AS_OUT_OF_MEMORY;
+
+    *buffer = new_buffer;
+    *capacity = set->max_length;
+    return AS_SUCCESS;
+}
@@ -0,0 +1,219 @@
+#ifndef AMOUNT_SET_STR_RADIX_H_
+#define AMOUNT_SET_STR_RADIX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "amount_set_str.h"
+
+/**
+ * Radix Amount Set Container
+ *
+ * An amount set for char* keeping its elements in a path-compressed radix
+ * tree with adaptive nodes (of up to 4, 16, 48 or 256 children), for sets of
+ * many elements sharing long prefixes, like "WH01-AISLE07-BIN0042".
+ * Characters shared by elements are kept once, in the node where the elements
+ * branch apart, so an element costs about the characters that tell it apart
+ * from its neighbours. Lookups and changes take time linear in the length of
+ * the element, whatever the size of the set.
+ * The set is sorted in ascending order (as by strcmp) - iterating over the
+ * set is done in the same order. Elements are not kept as whole strings, the
+ * internal iterator returns them in a buffer of the set. There is no order by
+ * amount, ordered and amount queries are done on a regular AmountSet made
+ * with asRadixCopy.
+ *
+ * The following functions are available:
+ *   asRadixCreate       - Creates a new empty set
+ *   asRadixDestroy      - Deletes an existing set and frees all resources
+ *   asRadixCopy         - Copies the set's contents into a regular AmountSet
+ *   asRadixGetSize      - Returns the size of the set
+ *   asRadixContains     - Checks if an element exists in the set
+ *   asRadixGetAmount    - Returns the amount of an element in the set
+ *   asRadixRegister     - Add a new element into the set
+ *   asRadixChangeAmount - Increase or decrease the amount of an element
+ *   asRadixDelete       - Delete an element completely from the set
+ *   asRadixClear        - Deletes all elements from the set
+ *   asRadixGetFirst     - Sets the internal iterator to the first element
+ *                         in the set, and returns it.
+ *   asRadixGetNext      - Advances the internal iterator to the next element
+ *                         and returns it.
+ *   asRadixGetMemory    - Returns the number of bytes the set holds
+ */
+
+/** Type for defining the radix set */
+typedef struct AmountSetRadix_t *AmountSetRadix;
+
+/**
+ * asRadixCreate: Allocates a new empty radix amount set.
+ *
+ * @return
+ *     NULL - if allocations failed.
+ *     A new radix amount set in case of success.
+ */
+AmountSetRadix asRadixCreate();
+
+/**
+ * asRadixDestroy: Deallocates an existing radix amount set.
+ *
+ * @param set - Target set to be deallocated. If set is NULL nothing will be done.
+ */
+void asRadixDestroy(AmountSetRadix set);
+
+/**
+ * asRadixCopy: Creates a regular amount set with the same elements (and
+ * amounts) as the radix set.
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - Target set.
+ * @return
+ *     NULL if a NULL was sent or a memory allocation failed.
+ *     An amount set containing the same elements (and amounts) as set, otherwise.
+ */
+AmountSet asRadixCopy(AmountSetRadix set);
+
+/**
+ * asRadixGetSize: Returns the number of elements in a set.
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set which size is requested.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     Otherwise the number of elements in the set.
+ */
+int asRadixGetSize(AmountSetRadix set);
+
+/**
+ * asRadixContains: Checks if an element exists in the set.
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to search in.
+ * @param element - The element to look for.
+ * @return
+ *     false - if the input set is null, or if the element was not found.
+ *     true - if the element was found in the set.
+ */
+bool asRadixContains(AmountSetRadix set, const char* element);
+
+/**
+ * asRadixGetAmount: Returns the amount of an element in the set.
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set which contains the element.
+ * @param element - The element whose amount is requested.
+ * @param outAmount - Pointer to the location where the amount is returned, in case
+ *     of success. In case of failure, the contents of outAmount are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_SUCCESS - if the amount was returned successfully.
+ */
+AmountSetResult asRadixGetAmount(AmountSetRadix set, const char* element, double* outAmount);
+
+/**
+ * asRadixRegister: Add a new element into the set.
+ *
+ * The element is added with an initial amount of 0.
+ * Iterator's value is undefined after this operation.
+ *
+ * @param set - The target set to which the element is added.
+ * @param element - The element to add.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_ALREADY_EXISTS - if an equal element already exists in the set.
+ *     AS_SUCCESS - if the element was added successfully.
+ */
+AmountSetResult asRadixRegister(AmountSetRadix set, const char* element);
+
+/**
+ * asRadixChangeAmount: Increase or decrease the amount of an element in the set.
+ *
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The target set containing the element.
+ * @param element - The element whose amount is changed.
+ * @param amount - How much to change the element's amount.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_INSUFFICIENT_AMOUNT - if the change will result in a negative amount,
+ *         the amount is unchanged.
+ *     AS_SUCCESS - if the element's amount was changed successfully.
+ */
+AmountSetResult asRadixChangeAmount(AmountSetRadix set, const char* element, double amount);
+
+/**
+ * asRadixDelete: Delete an element completely from the set.
+ *
+ * Never fails for lack of memory, nodes that can't be merged for lack of
+ * memory are kept as they are.
+ * Iterator's value is undefined after this operation.
+ *
+ * @param set - The target set from which the element is deleted.
+ * @param element - The element to delete.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_SUCCESS - if the element was deleted successfully.
+ */
+AmountSetResult asRadixDelete(AmountSetRadix set, const char* element);
+
+/**
+ * asRadixClear: Deletes all elements from target set.
+ *
+ * Iterator's value is undefined after this operation.
+ *
+ * @param set - Target set to delete all elements from.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL pointer was sent.
+ *     AS_SUCCESS - Otherwise.
+ */
+AmountSetResult asRadixClear(AmountSetRadix set);
+
+/**
+ * asRadixGetFirst: Sets the internal iterator (also called current element) to
+ * the first element in the set.
+ *
+ * The element is written to a buffer of the set, which is overwritten by the
+ * next call of asRadixGetFirst or asRadixGetNext. It must not be changed.
+ *
+ * @param set - The set for which to set the iterator and return the first element.
+ * @return
+ *     NULL if a NULL pointer was sent, the set is empty, or an allocation failed.
+ *     The first element of the set otherwise.
+ */
+char* asRadixGetFirst(AmountSetRadix set);
+
+/**
+ * asRadixGetNext: Advances the set iterator to the next element and returns it.
+ *
+ * Takes time linear in the length of the elements, the tree is searched from
+ * its root for the element following the current one.
+ *
+ * @param set - The set for which to advance the iterator.
+ * @return
+ *     NULL if reached the end of the set, or the iterator is at an invalid state,
+ *     or a NULL sent as argument.
+ *     The next element of the set in case of success, in the same buffer as
+ *     the one returned by asRadixGetFirst.
+ */
+char* asRadixGetNext(AmountSetRadix set);
+
+/**
+ * asRadixGetMemory: Returns the number of bytes of memory the set holds, to
+ * compare with the memory_bytes of asGetStats.
+ *
+ * Takes time linear in the number of nodes of the set.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - The set to query.
+ * @return
+ *     0 if a NULL pointer was sent.
+ *     Otherwise the bytes held by the set and its nodes.
+ */
+size_t asRadixGetMemory(AmountSetRadix set);
+
+#endif /* AMOUNT_SET_STR_RADIX_H_ */
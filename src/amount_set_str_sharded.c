@@ -0,0 +1,442 @@
+#define _POSIX_C_SOURCE 200809L
+#include "amount_set_str_sharded.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define ASH_MAX_SHARDS 1024
+#define ASH_CACHE_LINE 64
+#define ASH_FNV_OFFSET_BASIS 2166136261u
+#define ASH_FNV_PRIME 16777619u
+#define ASH_GOLDEN_RATIO 0x9E3779B97F4A7C15ull
+
+/** A part of the set with a lock of its own, aligned so that shards don't share cache lines. **/
+typedef struct AmountSetShard_t *AmountSetShard;
+struct AmountSetShard_t
+{
+    pthread_mutex_t lock;
+    AmountSet set;
+    int size; // Read without the lock by asShardedGetSize
+};
+
+#define ASH_SHARD_STRIDE \
+    ((sizeof(struct AmountSetShard_t) + ASH_CACHE_LINE - 1) / ASH_CACHE_LINE * ASH_CACHE_LINE)
+
+/**
+ * The next element of each of several ordered sets, kept in a binary heap of
+ * set indices, smallest element first, for merging the sets' orders.
+ **/
+typedef struct AmountSetMerge_t
+{
+    int *heap;
+    char **heads; // heads[i] is the next element of set i
+    int count;    // Sets in the heap, -1 for an invalid iterator
+} AmountSetMerge;
+
+struct AmountSetSharded_t
+{
+    int shard_count;
+    char *shards; // shard_count shards, ASH_SHARD_STRIDE bytes apart
+    AmountSetMerge iterator;
+};
+
+/**
+ * ashShard: Returns a shard of a set.
+ *
+ * @param set The set of the shard.
+ * @param index The index of the shard.
+ * @return
+ *      The shard.
+ * **/
+static AmountSetShard ashShard(AmountSetSharded set, int index);
+
+/**
+ * ashFindShard: Returns the shard an element belongs to.
+ *
+ * The FNV-1a hash of the element is mixed before choosing a shard, so that the
+ * shard doesn't depend on the same bits the shard's own hash index uses.
+ *
+ * @param set The set of the shard.
+ * @param element The element to look for.
+ * @return
+ *      The element's shard.
+ * **/
+static AmountSetShard ashFindShard(AmountSetSharded set, const char *element);
+
+/**
+ * ashMergeCreate: Allocates the heap and heads of a merge of several sets.
+ *
+ * @param merge The merge to initialize, with an invalid state.
+ * @param count The number of sets merged.
+ * @return
+ *      false - if an allocation failed, nothing is left allocated.
+ *      true - otherwise.
+ * **/
+static bool ashMergeCreate(AmountSetMerge *merge, int count);
+
+/**
+ * ashMergeDestroy: Frees the heap and heads of a merge.
+ *
+ * @param merge The merge to free.
+ * **/
+static void ashMergeDestroy(AmountSetMerge *merge);
+
+/**
+ * ashMergeBuild: Orders the heap of a merge, after all heads were set.
+ *
+ * Sets without elements are left out of the heap.
+ *
+ * @param merge The merge to order.
+ * @param count The number of sets merged.
+ * **/
+static void ashMergeBuild(AmountSetMerge *merge, int count);
+
+/**
+ * ashMergeReplace: Replaces the smallest head of a merge with the next
+ * element of its set.
+ *
+ * @param merge The merge to update.
+ * @param next The next element of the set whose head is the smallest, NULL
+ *      if it has no more elements.
+ * **/
+static void ashMergeReplace(AmountSetMerge *merge, char *next);
+
+/**
+ * ashMergeSiftDown: Moves a heap entry down until it is smaller than its children.
+ *
+ * @param merge The merge whose heap is ordered.
+ * @param position The position of the entry in the heap.
+ * **/
+static void ashMergeSiftDown(AmountSetMerge *merge, int position);
+
+AmountSetSharded asShardedCreate(int shards)
+{
+    if (shards < 1 || shards > ASH_MAX_SHARDS)
+        return NULL;
+
+    AmountSetSharded new_set = malloc(sizeof(*new_set));
+    if (!new_set)
+        return NULL;
+
+    void *memory = NULL;
+    if (posix_memalign(&memory, ASH_CACHE_LINE, shards * ASH_SHARD_STRIDE) != 0 ||
+        !ashMergeCreate(&new_set->iterator, shards))
+    {
+        free(memory);
+        free(new_set);
+        return NULL;
+    }
+
+    new_set->shard_count = shards;
+    new_set->shards = memory;
+    for (int i = 0; i < shards; i++)
+    {
+        AmountSetShard shard = ashShard(new_set, i);
+        shard->set = asCreate();
+        shard->size = 0;
+        if (!shard->set || pthread_mutex_init(&shard->lock, NULL) != 0)
+        {
+            asDestroy(shard->set);
+            new_set->shard_count = i;
+            asShardedDestroy(new_set);
+            return NULL;
+        }
+    }
+
+    return new_set;
+}
+
+void asShardedDestroy(AmountSetSharded set)
+{
+    if (!set)
+        return;
+
+    for (int i = 0; i < set->shard_count; i++)
+    {
+        AmountSetShard shard = ashShard(set, i);
+        asDestroy(shard->set);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    ashMergeDestroy(&set->iterator);
+    free(set->shards);
+    free(set);
+}
+
+AmountSet asShardedCopy(AmountSetSharded set)
+{
+    if (!set)
+        return NULL;
+
+    AmountSet *copies = calloc(set->shard_count, sizeof(*copies));
+    AmountSetMerge merge;
+    if (!copies || !ashMergeCreate(&merge, set->shard_count))
+    {
+        free(copies);
+        return NULL;
+    }
+
+    // All shards are locked together, so that the copy is of a single point in time
+    for (int i = 0; i < set->shard_count; i++)
+        pthread_mutex_lock(&ashShard(set, i)->lock);
+
+    int size = 0;
+    bool copied = true;
+    for (int i = 0; i < set->shard_count && copied; i++)
+    {
+        copies[i] = asCopy(ashShard(set, i)->set);
+        copied = copies[i] != NULL;
+        size += ashShard(set, i)->size;
+    }
+
+    for (int i = set->shard_count - 1; i >= 0; i--)
+        pthread_mutex_unlock(&ashShard(set, i)->lock);
+
+    const char **elements = copied ? malloc((size + 1) * sizeof(*elements)) : NULL;
+    double *amounts = copied ? malloc((size + 1) * sizeof(*amounts)) : NULL;
+    AmountSet new_set = NULL;
+    if (elements && amounts)
+    {
+        for (int i = 0; i < set->shard_count; i++)
+            merge.heads[i] = asGetFirst(copies[i]);
+
+        ashMergeBuild(&merge, set->shard_count);
+        for (int count = 0; merge.count > 0; count++)
+        {
+            int smallest = merge.heap[0];
+            elements[count] = merge.heads[smallest];
+            asGetAmount(copies[smallest], elements[count], &amounts[count]);
+            ashMergeReplace(&merge, asGetNext(copies[smallest]));
+        }
+
+        // The merged elements are sorted, and are linked without searching
+        asCreateFromArrays(elements, amounts, size, &new_set);
+    }
+
+    free(elements);
+    free(amounts);
+    for (int i = 0; i < set->shard_count; i++)
+        asDestroy(copies[i]);
+
+    free(copies);
+    ashMergeDestroy(&merge);
+    return new_set;
+}
+
+int asShardedGetSize(AmountSetSharded set)
+{
+    if (!set)
+        return -1;
+
+    int size = 0;
+    for (int i = 0; i < set->shard_count; i++)
+        size += __atomic_load_n(&ashShard(set, i)->size, __ATOMIC_RELAXED);
+
+    return size;
+}
+
+bool asShardedContains(AmountSetSharded set, const char *element)
+{
+    if (!set || !element)
+        return false;
+
+    AmountSetShard shard = ashFindShard(set, element);
+    pthread_mutex_lock(&shard->lock);
+    bool found = asContains(shard->set, element);
+    pthread_mutex_unlock(&shard->lock);
+
+    return found;
+}
+
+AmountSetResult asShardedGetAmount(AmountSetSharded set, const char *element, double *outAmount)
+{
+    if (!set || !element || !outAmount)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetShard shard = ashFindShard(set, element);
+    pthread_mutex_lock(&shard->lock);
+    AmountSetResult operation_result = asGetAmount(shard->set, element, outAmount);
+    pthread_mutex_unlock(&shard->lock);
+
+    return operation_result;
+}
+
+AmountSetResult asShardedRegister(AmountSetSharded set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetShard shard = ashFindShard(set, element);
+    pthread_mutex_lock(&shard->lock);
+    AmountSetResult operation_result = asRegister(shard->set, element);
+    if (operation_result == AS_SUCCESS)
+        __atomic_store_n(&shard->size, shard->size + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&shard->lock);
+
+    return operation_result;
+}
+
+AmountSetResult asShardedChangeAmount(AmountSetSharded set, const char *element, const double amount)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetShard shard = ashFindShard(set, element);
+    pthread_mutex_lock(&shard->lock);
+    AmountSetResult operation_result = asChangeAmount(shard->set, element, amount);
+    pthread_mutex_unlock(&shard->lock);
+
+    return operation_result;
+}
+
+AmountSetResult asShardedDelete(AmountSetSharded set, const char *element)
+{
+    if (!set || !element)
+        return AS_NULL_ARGUMENT;
+
+    AmountSetShard shard = ashFindShard(set, element);
+    pthread_mutex_lock(&shard->lock);
+    AmountSetResult operation_result = asDelete(shard->set, element);
+    if (operation_result == AS_SUCCESS)
+        __atomic_store_n(&shard->size, shard->size - 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&shard->lock);
+
+    return operation_result;
+}
+
+AmountSetResult asShardedClear(AmountSetSharded set)
+{
+    if (!set)
+        return AS_NULL_ARGUMENT;
+
+    for (int i = 0; i < set->shard_count; i++)
+    {
+        AmountSetShard shard = ashShard(set, i);
+        pthread_mutex_lock(&shard->lock);
+        asClear(shard->set);
+        __atomic_store_n(&shard->size, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return AS_SUCCESS;
+}
+
+char *asShardedGetFirst(AmountSetSharded set)
+{
+    if (!set)
+        return NULL;
+
+    for (int i = 0; i < set->shard_count; i++)
+    {
+        AmountSetShard shard = ashShard(set, i);
+        pthread_mutex_lock(&shard->lock);
+        set->iterator.heads[i] = asGetFirst(shard->set);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    ashMergeBuild(&set->iterator, set->shard_count);
+    return set->iterator.count > 0 ? set->iterator.heads[set->iterator.heap[0]] : NULL;
+}
+
+char *asShardedGetNext(AmountSetSharded set)
+{
+    if (!set || set->iterator.count <= 0)
+        return NULL;
+
+    // Only the shard of the current element moves, the other shards keep their next elements
+    AmountSetShard shard = ashShard(set, set->iterator.heap[0]);
+    pthread_mutex_lock(&shard->lock);
+    char *next = asGetNext(shard->set);
+    pthread_mutex_unlock(&shard->lock);
+
+    ashMergeReplace(&set->iterator, next);
+    return set->iterator.count > 0 ? set->iterator.heads[set->iterator.heap[0]] : NULL;
+}
+
+static AmountSetShard ashShard(AmountSetSharded set, int index)
+{
+    assert(index >= 0 && index < set->shard_count);
+    return (AmountSetShard)(set->shards + index * ASH_SHARD_STRIDE);
+}
+
+static AmountSetShard ashFindShard(AmountSetSharded set, const char *element)
+{
+    unsigned int hash = ASH_FNV_OFFSET_BASIS;
+    for (const unsigned char *current = (const unsigned char *)element; *current; current++)
+    {
+        hash ^= *current;
+        hash *= ASH_FNV_PRIME;
+    }
+
+    uint64_t mixed = hash * ASH_GOLDEN_RATIO;
+    return ashShard(set, (int)((mixed >> 32) % (uint64_t)set->shard_count));
+}
+
+static bool ashMergeCreate(AmountSetMerge *merge, int count)
+{
+    merge->heap = malloc(count * sizeof(*merge->heap));
+    merge->heads = malloc(count * sizeof(*merge->heads));
+    merge->count = -1;
+    if (!merge->heap || !merge->heads)
+    {
+        ashMergeDestroy(merge);
+        return false;
+    }
+
+    return true;
+}
+
+static void ashMergeDestroy(AmountSetMerge *merge)
+{
+    free(merge->heap);
+    free(merge->heads);
+    merge->heap = NULL;
+    merge->heads = NULL;
+    merge->count = -1;
+}
+
+static void ashMergeBuild(AmountSetMerge *merge, int count)
+{
+    merge->count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (merge->heads[i])
+            merge->heap[merge->count++] = i;
+    }
+
+    for (int position = merge->count / 2 - 1; position >= 0; position--)
+        ashMergeSiftDown(merge, position);
+}
+
+static void ashMergeReplace(AmountSetMerge *merge, char *next)
+{
+    assert(merge->count > 0);
+    merge->heads[merge->heap[0]] = next;
+    if (!next)
+        merge->heap[0] = merge->heap[--merge->count];
+
+    if (merge->count > 0)
+        ashMergeSiftDown(merge, 0);
+}
+
+static void ashMergeSiftDown(AmountSetMerge *merge, int position)
+{
+    int entry = merge->heap[position];
+    while (2 * position + 1 < merge->count)
+    {
+        int child = 2 * position + 1;
+        if (child + 1 < merge->count &&
+            strcmp(merge->heads[merge->heap[child + 1]], merge->heads[merge->heap[child]]) < 0)
+            child++;
+
+        if (strcmp(merge->heads[entry], merge->heads[merge->heap[child]]) <= 0)
+            break;
+
+        merge->heap[position] = merge->heap[child];
+        position = child;
+    }
+
+    merge->heap[position] = entry;
+}
@@ -0,0 +1,220 @@
+#ifndef AMOUNT_SET_STR_SHARDED_H_
+#define AMOUNT_SET_STR_SHARDED_H_
+
+#include <stdbool.h>
+#include "amount_set_str.h"
+
+/**
+ * Sharded Amount Set Container
+ *
+ * A thread-safe amount set for char*, for many threads changing different
+ * elements at the same time.
+ * Elements are spread by their hash over a fixed number of shards, each a
+ * regular AmountSet with a lock of its own, so that operations on elements of
+ * different shards don't wait for each other. Operations on a single element
+ * (asShardedContains, asShardedGetAmount, asShardedRegister,
+ * asShardedChangeAmount, asShardedDelete) lock only the element's shard.
+ * The set is sorted in ascending order (as by strcmp) - iterating over the
+ * set is done in the same order, by merging the shards' orders. The internal
+ * iterator must not be used while other threads change the set, ordered
+ * iteration concurrent with changes is done on a copy taken with
+ * asShardedCopy.
+ *
+ * The following functions are available:
+ *   asShardedCreate       - Creates a new empty set
+ *   asShardedDestroy      - Deletes an existing set and frees all resources
+ *   asShardedCopy         - Copies the set's contents into a regular AmountSet
+ *   asShardedGetSize      - Returns the size of the set
+ *   asShardedContains     - Checks if an element exists in the set
+ *   asShardedGetAmount    - Returns the amount of an element in the set
+ *   asShardedRegister     - Add a new element into the set
+ *   asShardedChangeAmount - Increase or decrease the amount of an element
+ *   asShardedDelete       - Delete an element completely from the set
+ *   asShardedClear        - Deletes all elements from the set
+ *   asShardedGetFirst     - Sets the internal iterator to the first element
+ *                           in the set, and returns it.
+ *   asShardedGetNext      - Advances the internal iterator to the next element
+ *                           and returns it.
+ *   AS_SHARDED_FOREACH    - A macro for iterating over the set's elements
+ */
+
+/** Type for defining the sharded set */
+typedef struct AmountSetSharded_t *AmountSetSharded;
+
+/**
+ * asShardedCreate: Allocates a new empty sharded amount set.
+ *
+ * @param shards - The number of shards, between 1 and 1024. More shards let
+ *     more threads change the set at once, but make iterating over the set
+ *     slower.
+ * @return
+ *     NULL - if shards is out of range or allocations failed.
+ *     A new sharded amount set in case of success.
+ */
+AmountSetSharded asShardedCreate(int shards);
+
+/**
+ * asShardedDestroy: Deallocates an existing sharded amount set.
+ *
+ * No other thread may be using the set while it is destroyed.
+ *
+ * @param set - Target set to be deallocated. If set is NULL nothing will be done.
+ */
+void asShardedDestroy(AmountSetSharded set);
+
+/**
+ * asShardedCopy: Creates a regular amount set with the same elements (and
+ * amounts) as the sharded set, at a single point in time.
+ *
+ * Locks all shards for as long as copying each shard takes (see asCopy), the
+ * shards' orders are then merged without holding the locks.
+ * Iterator's state is unchanged after this operation.
+ *
+ * @param set - Target set.
+ * @return
+ *     NULL if a NULL was sent or a memory allocation failed.
+ *     An amount set containing the same elements (and amounts) as set, otherwise.
+ */
+AmountSet asShardedCopy(AmountSetSharded set);
+
+/**
+ * asShardedGetSize: Returns the number of elements in a set.
+ *
+ * Never waits for other threads. While other threads change the set, the
+ * size returned may count some of their changes and miss others.
+ *
+ * @param set - The set which size is requested.
+ * @return
+ *     -1 if a NULL pointer was sent.
+ *     Otherwise the number of elements in the set.
+ */
+int asShardedGetSize(AmountSetSharded set);
+
+/**
+ * asShardedContains: Checks if an element exists in the set.
+ *
+ * Locks the element's shard.
+ *
+ * @param set - The set to search in.
+ * @param element - The element to look for.
+ * @return
+ *     false - if the input set is null, or if the element was not found.
+ *     true - if the element was found in the set.
+ */
+bool asShardedContains(AmountSetSharded set, const char* element);
+
+/**
+ * asShardedGetAmount: Returns the amount of an element in the set.
+ *
+ * Locks the element's shard.
+ *
+ * @param set - The set which contains the element.
+ * @param element - The element whose amount is requested.
+ * @param outAmount - Pointer to the location where the amount is returned, in case
+ *     of success. In case of failure, the contents of outAmount are unchanged.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_SUCCESS - if the amount was returned successfully.
+ */
+AmountSetResult asShardedGetAmount(AmountSetSharded set, const char* element, double* outAmount);
+
+/**
+ * asShardedRegister: Add a new element into the set.
+ *
+ * The element is added with an initial amount of 0.
+ * Locks the element's shard. Iterator's value is undefined after this operation.
+ *
+ * @param set - The target set to which the element is added.
+ * @param element - The element to add.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_ALREADY_EXISTS - if an equal element already exists in the set.
+ *     AS_SUCCESS - if the element was added successfully.
+ */
+AmountSetResult asShardedRegister(AmountSetSharded set, const char* element);
+
+/**
+ * asShardedChangeAmount: Increase or decrease the amount of an element in the set.
+ *
+ * Locks the element's shard. Iterator's state is unchanged after this operation.
+ *
+ * @param set - The target set containing the element.
+ * @param element - The element whose amount is changed.
+ * @param amount - How much to change the element's amount.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_INSUFFICIENT_AMOUNT - if the change will result in a negative amount,
+ *         the amount is unchanged.
+ *     AS_SUCCESS - if the element's amount was changed successfully.
+ */
+AmountSetResult asShardedChangeAmount(AmountSetSharded set, const char* element, double amount);
+
+/**
+ * asShardedDelete: Delete an element completely from the set.
+ *
+ * Locks the element's shard. Iterator's value is undefined after this operation.
+ *
+ * @param set - The target set from which the element is deleted.
+ * @param element - The element to delete.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL argument was passed.
+ *     AS_OUT_OF_MEMORY - if an allocation failed.
+ *     AS_ITEM_DOES_NOT_EXIST - if the element doesn't exist in the set.
+ *     AS_SUCCESS - if the element was deleted successfully.
+ */
+AmountSetResult asShardedDelete(AmountSetSharded set, const char* element);
+
+/**
+ * asShardedClear: Deletes all elements from target set.
+ *
+ * Clears the shards one at a time, elements other threads add meanwhile to
+ * shards already cleared are kept.
+ * Iterator's value is undefined after this operation.
+ *
+ * @param set - Target set to delete all elements from.
+ * @return
+ *     AS_NULL_ARGUMENT - if a NULL pointer was sent.
+ *     AS_SUCCESS - Otherwise.
+ */
+AmountSetResult asShardedClear(AmountSetSharded set);
+
+/**
+ * asShardedGetFirst: Sets the internal iterator (also called current element) to
+ * the first element in the set.
+ *
+ * Takes time linear in the number of shards. The returned element stays valid
+ * until it is deleted from the set.
+ *
+ * @param set - The set for which to set the iterator and return the first element.
+ * @return
+ *     NULL if a NULL pointer was sent or the set is empty.
+ *     The first element of the set otherwise.
+ */
+char* asShardedGetFirst(AmountSetSharded set);
+
+/**
+ * asShardedGetNext: Advances the set iterator to the next element and returns it.
+ *
+ * Takes time logarithmic in the number of shards.
+ *
+ * @param set - The set for which to advance the iterator.
+ * @return
+ *     NULL if reached the end of the set, or the iterator is at an invalid state,
+ *     or a NULL sent as argument.
+ *     The next element of the set in case of success.
+ */
+char* asShardedGetNext(AmountSetSharded set);
+
+/**
+ * Macro for iterating over a sharded set.
+ * Declares a new iterator for the loop.
+ */
+#define AS_SHARDED_FOREACH(type, iterator, set)          \
+    for(type iterator = (type) asShardedGetFirst(set) ; \
+        iterator ;                                      \
+        iterator = asShardedGetNext(set))
+
+#endif /* AMOUNT_SET_STR_SHARDED_H_ */
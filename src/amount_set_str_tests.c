@@ -1,10 +1,40 @@
 #include <stdio.h>
 #include "amount_set_str.h"
+#include "amount_set_str_concurrent.h"
+#include "amount_set_str_radix.h"
+#include "amount_set_str_sharded.h"
 #include "amount_set_str_tests.h"
 #include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include "string.h"
 
+#define CONCURRENT_READERS 4
+#define CONCURRENT_ROUNDS 5000
+#define SHARDED_WRITERS 4
+#define SHARDED_ROUNDS 2000
+
+typedef struct ConcurrentReader_t
+{
+    AmountSetConcurrent set;
+    int done;
+    bool passed;
+} ConcurrentReader;
+
+typedef struct ShardedWriter_t
+{
+    AmountSetSharded set;
+    int id;
+    bool passed;
+} ShardedWriter;
+
 static AmountSet CreateDummy(int items);
+static bool AppendElement(const char *element, double amount, void *context);
+static bool CheckAmountOrder(AmountSet set);
+static bool ApplyChange(const AmountSetChange *change, void *context);
+static bool SameSets(AmountSet first, AmountSet second);
+static bool SameRadixSet(AmountSetRadix radix, AmountSet set);
+static bool CheckAggregates(AmountSet set);
 
 bool testCreate()
 {
@@ -89,6 +119,69 @@ bool testCopy()
     return passed;
 }
 
+bool testCreateFromArrays()
+{
+    bool passed = true;
+    const char *sorted[] = {"Item 1", "Item 2", "Item 3", "Item 4"};
+    const char *unsorted[] = {"Item 3", "Item 1", "Item 4", "Item 2"};
+    const char *duplicates[] = {"Item 2", "Item 1", "Item 2"};
+    double amounts[] = {3, 1, 4, 2};
+    AmountSet set = NULL;
+
+    if (asCreateFromArrays(sorted, NULL, 4, &set) != AS_SUCCESS || asGetSize(set) != 4)
+    {
+        printf("Failed to create a set from sorted elements.\n");
+        passed = false;
+    }
+    asDestroy(set);
+    set = NULL;
+
+    if (asCreateFromArrays(unsorted, amounts, 4, &set) != AS_SUCCESS || asGetSize(set) != 4)
+    {
+        printf("Failed to create a set from unsorted elements.\n");
+        passed = false;
+    }
+
+    int i = 0;
+    AS_FOREACH(char *, element, set)
+    {
+        double amount = -1;
+        asGetAmount(set, element, &amount);
+        if (strcmp(element, sorted[i]) || amount != i + 1)
+        {
+            printf("Incorrect element or amount for %s.\n", element);
+            passed = false;
+        }
+        i++;
+    }
+    asDestroy(set);
+    set = NULL;
+
+    if (asCreateFromArrays(duplicates, NULL, 3, &set) != AS_ITEM_ALREADY_EXISTS || set != NULL)
+    {
+        printf("Duplicate elements were not detected.\n");
+        passed = false;
+    }
+
+    amounts[2] = -1;
+    if (asCreateFromArrays(unsorted, amounts, 4, &set) != AS_INSUFFICIENT_AMOUNT ||
+        asCreateFromArrays(NULL, NULL, 4, &set) != AS_NULL_ARGUMENT ||
+        asCreateFromArrays(sorted, NULL, -1, &set) != AS_NULL_ARGUMENT || set != NULL)
+    {
+        printf("Incorrect error on invalid arguments.\n");
+        passed = false;
+    }
+
+    if (asCreateFromArrays(NULL, NULL, 0, &set) != AS_SUCCESS || asGetSize(set) != 0)
+    {
+        printf("Failed to create an empty set.\n");
+        passed = false;
+    }
+
+    asDestroy(set);
+    return passed;
+}
+
 bool testGetSize()
 {
     bool passed = true;
@@ -212,7 +305,52 @@ bool testGetAmount()
 bool testRegister()
 {
     bool passed = true;
+    AmountSet set = CreateDummy(1000);
+
+    if (asRegister(set, "Item 500") != AS_ITEM_ALREADY_EXISTS)
+    {
+        printf("Duplicate element was registered.\n");
+        passed = false;
+    }
+
+    if (asRegister(set, NULL) != AS_NULL_ARGUMENT || asRegister(NULL, "Item 1") != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect error on NULL argument.\n");
+        passed = false;
+    }
+
+    for (int i = 1; i <= 1000; i += 2)
+    {
+        char item[16];
+        sprintf(item, "Item %d", i);
+        asDelete(set, item);
+    }
+
+    for (int i = 1; i <= 1000; i++)
+    {
+        char item[16];
+        sprintf(item, "Item %d", i);
+        if (asContains(set, item) != (i % 2 == 0))
+        {
+            printf("Incorrect contains result for %s after deletes.\n", item);
+            passed = false;
+            break;
+        }
+    }
+
+    if (asRegister(set, "Item 1") != AS_SUCCESS || !asContains(set, "Item 1"))
+    {
+        printf("Failed to register a previously deleted element.\n");
+        passed = false;
+    }
+
+    if (asGetSize(set) != 501)
+    {
+        printf("Incorrect size after register and delete, %d instead of 501.\n", asGetSize(set));
+        passed = false;
+    }
 
+    asDestroy(set);
     return passed;
 }
 
@@ -255,6 +393,52 @@ bool testChangeAmount()
     return passed;
 }
 
+bool testUpsertAmount()
+{
+    bool passed = true;
+    AmountSet set = CreateDummy(3);
+    bool created = true;
+    double amount = -1;
+
+    if (asUpsertAmount(set, "Item 2", 4, &created) != AS_SUCCESS || created ||
+        asGetAmount(set, "Item 2", &amount) != AS_SUCCESS || amount != 4)
+    {
+        printf("Incorrect upsert of an existing element.\n");
+        passed = false;
+    }
+
+    if (asUpsertAmount(set, "Item 0", 2.5, &created) != AS_SUCCESS || !created ||
+        asGetAmount(set, "Item 0", &amount) != AS_SUCCESS || amount != 2.5 ||
+        strcmp(asGetFirst(set), "Item 0"))
+    {
+        printf("Incorrect upsert of a new element.\n");
+        passed = false;
+    }
+
+    if (asUpsertAmount(set, "Item 9", -1, &created) != AS_INSUFFICIENT_AMOUNT || created ||
+        asContains(set, "Item 9"))
+    {
+        printf("New element registered despite insufficient amount.\n");
+        passed = false;
+    }
+
+    if (asUpsertAmount(set, "Item 2", -5, NULL) != AS_INSUFFICIENT_AMOUNT ||
+        asGetAmount(set, "Item 2", &amount) != AS_SUCCESS || amount != 4)
+    {
+        printf("Amount changed after insufficient amount.\n");
+        passed = false;
+    }
+
+    if (asUpsertAmount(NULL, "Item 1", 1, NULL) != AS_NULL_ARGUMENT || asGetSize(set) != 4)
+    {
+        printf("Incorrect error on NULL argument or incorrect size.\n");
+        passed = false;
+    }
+
+    asDestroy(set);
+    return passed;
+}
+
 bool testDelete()
 {
     bool passed = true;
@@ -306,6 +490,17 @@ bool testClear()
         passed = false;
     }
 
+    // The set should be fully usable after being cleared
+    asRegister(set, "Item 2");
+    asRegister(set, "Item 1");
+    asChangeAmount(set, "Item 1", 5);
+    double amount = 0;
+    if (asGetSize(set) != 2 || asGetAmount(set, "Item 1", &amount) != AS_SUCCESS || amount != 5)
+    {
+        printf("Set is not usable after clear.\n");
+        passed = false;
+    }
+
     asDestroy(set);
     return passed;
 }
@@ -394,15 +589,1648 @@ bool testOrdered()
     return passed;
 }
 
-static AmountSet CreateDummy(int items)
+bool testOrderedLarge()
 {
+    bool passed = true;
     AmountSet set = asCreate();
-    for (int i = 1; i <= items; i++)
+    char item[16];
+
+    // 7919 is coprime with 2003, so this registers every number below 2003 in scrambled order
+    for (int i = 0; i < 2003; i++)
     {
-        char item[10];
-        sprintf(item, "Item %d", i);
+        sprintf(item, "%05d", (i * 7919) % 2003);
         asRegister(set, item);
     }
 
-    return set;
-}
\ No newline at end of file
+    for (int i = 0; i < 2003; i += 3)
+    {
+        sprintf(item, "%05d", i);
+        asDelete(set, item);
+    }
+
+    if (asGetSize(set) != 2003 - 668)
+    {
+        printf("Incorrect size %d instead of %d.\n", asGetSize(set), 2003 - 668);
+        passed = false;
+    }
+
+    int expected = 1;
+    AS_FOREACH(char *, element, set)
+    {
+        sprintf(item, "%05d", expected);
+        if (strcmp(element, item))
+        {
+            printf("Incorrect order, %s instead of %s.\n", element, item);
+            passed = false;
+            break;
+        }
+        expected += (expected % 3 == 2) ? 2 : 1;
+    }
+
+    asDestroy(set);
+    return passed;
+}
+
+bool testIterator()
+{
+    bool passed = true;
+    AmountSet set = CreateDummy(5);
+    asChangeAmount(set, "Item 3", 3);
+
+    // Two external iterators and the internal one over the same set at once
+    int pairs = 0;
+    AmountSetIterator outer, inner;
+    char *internal = asGetFirst(set);
+    AS_FOREACH_ITERATOR(char *, first, outer, set)
+    {
+        AS_FOREACH_ITERATOR(char *, second, inner, set)
+        {
+            asContains(set, second);
+            pairs++;
+        }
+        double amount = -1;
+        if (asIteratorGetAmount(&outer, &amount) != AS_SUCCESS ||
+            amount != (strcmp(first, "Item 3") ? 0 : 3))
+        {
+            printf("Incorrect amount for %s through iterator.\n", first);
+            passed = false;
+        }
+    }
+
+    if (pairs != 25)
+    {
+        printf("Nested iterators visited %d pairs instead of 25.\n", pairs);
+        passed = false;
+    }
+
+    if (asGetNext(set) == NULL || strcmp(internal, "Item 1"))
+    {
+        printf("Internal iterator changed by external iterators.\n");
+        passed = false;
+    }
+
+    if (!asIteratorEnd(&outer) || asIteratorNext(&outer) != NULL ||
+        asIteratorGetAmount(&outer, &(double){0}) != AS_ITEM_DOES_NOT_EXIST)
+    {
+        printf("Finished iterator is not at the end.\n");
+        passed = false;
+    }
+
+    AmountSetIterator empty;
+    if (asIteratorBegin(NULL, &empty) != NULL || !asIteratorEnd(&empty))
+    {
+        printf("Iterator over NULL set is not at the end.\n");
+        passed = false;
+    }
+
+    asDestroy(set);
+    return passed;
+}
+
+static void *ConcurrentRead(void *argument)
+{
+    ConcurrentReader *reader = argument;
+    double last_amount = 0;
+    while (!__atomic_load_n(&reader->done, __ATOMIC_ACQUIRE))
+    {
+        double amount = -1;
+        if (asConcurrentGetAmount(reader->set, "Stable", &amount) != AS_SUCCESS ||
+            amount < last_amount || amount > CONCURRENT_ROUNDS)
+            reader->passed = false;
+
+        last_amount = amount;
+        asConcurrentContains(reader->set, "Temp 1");
+    }
+
+    return NULL;
+}
+
+bool testConcurrent()
+{
+    bool passed = true;
+    AmountSetConcurrent set = asConcurrentCreate();
+    asConcurrentRegister(set, "Stable");
+
+    pthread_t threads[CONCURRENT_READERS];
+    ConcurrentReader readers[CONCURRENT_READERS];
+    for (int i = 0; i < CONCURRENT_READERS; i++)
+    {
+        readers[i].set = set;
+        readers[i].done = 0;
+        readers[i].passed = true;
+        pthread_create(&threads[i], NULL, ConcurrentRead, &readers[i]);
+    }
+
+    char item[16];
+    for (int i = 1; i <= CONCURRENT_ROUNDS; i++)
+    {
+        asConcurrentChangeAmount(set, "Stable", 1);
+        sprintf(item, "Temp %d", i);
+        asConcurrentRegister(set, item);
+        sprintf(item, "Temp %d", i - 1);
+        asConcurrentDelete(set, item);
+    }
+
+    for (int i = 0; i < CONCURRENT_READERS; i++)
+    {
+        __atomic_store_n(&readers[i].done, 1, __ATOMIC_RELEASE);
+        pthread_join(threads[i], NULL);
+        if (!readers[i].passed)
+        {
+            printf("Reader %d saw an incorrect amount.\n", i);
+            passed = false;
+        }
+    }
+
+    if (asConcurrentChangeAmount(set, "Stable", -(CONCURRENT_ROUNDS + 1)) != AS_INSUFFICIENT_AMOUNT)
+    {
+        printf("Incorrect or no error on insufficient amount.\n");
+        passed = false;
+    }
+
+    AmountSet copy = asConcurrentCopy(set);
+    double amount = -1;
+    if (asConcurrentGetSize(set) != 2 || asGetSize(copy) != 2 ||
+        asGetAmount(copy, "Stable", &amount) != AS_SUCCESS || amount != CONCURRENT_ROUNDS)
+    {
+        printf("Incorrect contents after concurrent updates.\n");
+        passed = false;
+    }
+
+    asDestroy(copy);
+    asConcurrentDestroy(set);
+    return passed;
+}
+
+bool testRange()
+{
+    bool passed = true;
+    const char *elements[] = {"A-1", "A-2", "B-1", "B-10", "B-2", "C"};
+    AmountSet set = NULL;
+    asCreateFromArrays(elements, NULL, 6, &set);
+    char visited[64] = "";
+
+    asGetPrefix(set, "B-", AppendElement, visited);
+    if (strcmp(visited, "B-1,B-10,B-2,"))
+    {
+        printf("Incorrect prefix query result: %s\n", visited);
+        passed = false;
+    }
+
+    visited[0] = '\0';
+    asGetRange(set, "A-2", "B-10", AppendElement, visited);
+    if (strcmp(visited, "A-2,B-1,B-10,"))
+    {
+        printf("Incorrect range query result: %s\n", visited);
+        passed = false;
+    }
+
+    visited[0] = '\0';
+    asGetRange(set, "B-3", NULL, AppendElement, visited);
+    if (strcmp(visited, "C,"))
+    {
+        printf("Incorrect open range query result: %s\n", visited);
+        passed = false;
+    }
+
+    if (asCountRange(set, "A", "B") != 2 || asCountRange(set, NULL, NULL) != 6 ||
+        asCountRange(set, "D", NULL) != 0 || asCountRange(NULL, NULL, NULL) != -1)
+    {
+        printf("Incorrect range count.\n");
+        passed = false;
+    }
+
+    if (asGetPrefix(set, NULL, AppendElement, visited) != AS_NULL_ARGUMENT ||
+        asGetRange(set, NULL, NULL, NULL, NULL) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect error on NULL argument.\n");
+        passed = false;
+    }
+
+    asDestroy(set);
+    return passed;
+}
+
+bool testCopyOnWrite()
+{
+    AmountSet source_set = CreateDummy(100);
+    asChangeAmount(source_set, "Item 1", 5);
+    bool passed = true;
+
+    AmountSet first_copy = asCopy(source_set);
+    AmountSet second_copy = asCopy(first_copy);
+    asGetFirst(source_set);
+    char *current = asGetNext(source_set);
+
+    // Changing the source must leave the copies and the source's iterator intact
+    if (asChangeAmount(source_set, "Item 1", 1) != AS_SUCCESS ||
+        asDelete(first_copy, "Item 2") != AS_SUCCESS ||
+        asRegister(second_copy, "New item") != AS_SUCCESS)
+    {
+        printf("Failed to change the copies.\n");
+        passed = false;
+    }
+
+    double amount = -1;
+    asGetAmount(first_copy, "Item 1", &amount);
+    if (amount != 5 || asGetSize(source_set) != 100 || asGetSize(first_copy) != 99 ||
+        asGetSize(second_copy) != 101 || !asContains(second_copy, "Item 2") ||
+        asContains(source_set, "New item"))
+    {
+        printf("Copies are not independent.\n");
+        passed = false;
+    }
+
+    if (current == NULL || asGetNext(source_set) == NULL || strcmp(current, "Item 10"))
+    {
+        printf("Iterator was not kept across copying.\n");
+        passed = false;
+    }
+
+    // The copies must outlive the set they were made from
+    asDestroy(source_set);
+    if (asClear(first_copy) != AS_SUCCESS || asGetSize(first_copy) != 0 ||
+        asGetSize(second_copy) != 101 || asGetAmount(second_copy, "Item 1", &amount) != AS_SUCCESS ||
+        amount != 5)
+    {
+        printf("Copies changed after destroying the source.\n");
+        passed = false;
+    }
+
+    asDestroy(first_copy);
+    asDestroy(second_copy);
+    return passed;
+}
+
+bool testLongElementOrder()
+{
+    // Elements around the cached prefix length, sharing long prefixes
+    const char *elements[] = {"ACME-SKU-0000001", "ACME-SKU-000000", "ACME-SKU-00000010",
+                              "ACME-SKU-0000000", "ACME-SKU-00000001", "ACME-SK", "ACME-SKU",
+                              "ACME-SKU-0000002", "ACME-SKU-00000001-B", "\xc3\xa9", "ACME-SKU-00000001-A"};
+    int count = sizeof(elements) / sizeof(*elements);
+    bool passed = true;
+    AmountSet set = asCreate();
+
+    for (int i = 0; i < count; i++)
+        asRegister(set, elements[i]);
+
+    int visited = 0;
+    char *previous = NULL;
+    AS_FOREACH(char *, element, set)
+    {
+        if (previous && strcmp(previous, element) >= 0)
+        {
+            printf("Incorrect order, %s before %s.\n", previous, element);
+            passed = false;
+        }
+        previous = element;
+        visited++;
+    }
+
+    if (visited != count || asCountRange(set, "ACME-SKU-0000000", "ACME-SKU-00000010") != 6)
+    {
+        printf("Incorrect elements visited.\n");
+        passed = false;
+    }
+
+    for (int i = 0; i < count; i += 2)
+    {
+        if (asDelete(set, elements[i]) != AS_SUCCESS)
+        {
+            printf("Failed to delete %s.\n", elements[i]);
+            passed = false;
+        }
+    }
+
+    if (asGetSize(set) != count / 2)
+    {
+        printf("Incorrect size after deleting.\n");
+        passed = false;
+    }
+
+    asDestroy(set);
+    return passed;
+}
+
+static double SubtractAmounts(double firstAmount, double secondAmount)
+{
+    return firstAmount - secondAmount;
+}
+
+bool testSetAlgebra()
+{
+    const char *first_elements[] = {"A", "B", "C", "E"};
+    const char *second_elements[] = {"B", "D", "E", "F"};
+    double first_amounts[] = {1, 2, 3, 4};
+    double second_amounts[] = {10, 20, 1, 30};
+    AmountSet first, second, result = NULL;
+    bool passed = true;
+
+    asCreateFromArrays(first_elements, first_amounts, 4, &first);
+    asCreateFromArrays(second_elements, second_amounts, 4, &second);
+
+    char visited[64] = "";
+    double amount;
+    if (asMerge(first, second, asCombineSum, &result) != AS_SUCCESS || asGetSize(result) != 6 ||
+        asGetAmount(result, "B", &amount) != AS_SUCCESS || amount != 12 ||
+        asGetAmount(result, "F", &amount) != AS_SUCCESS || amount != 30 ||
+        asGetRange(result, NULL, NULL, AppendElement, visited) != AS_SUCCESS || strcmp(visited, "A,B,C,D,E,F,"))
+    {
+        printf("Incorrect merge.\n");
+        passed = false;
+    }
+    asDestroy(result);
+
+    visited[0] = '\0';
+    if (asIntersect(first, second, asCombineMin, &result) != AS_SUCCESS || asGetSize(result) != 2 ||
+        asGetAmount(result, "E", &amount) != AS_SUCCESS || amount != 1 ||
+        asGetRange(result, NULL, NULL, AppendElement, visited) != AS_SUCCESS || strcmp(visited, "B,E,"))
+    {
+        printf("Incorrect intersection.\n");
+        passed = false;
+    }
+    asDestroy(result);
+
+    if (asIntersect(first, second, SubtractAmounts, &result) != AS_INSUFFICIENT_AMOUNT ||
+        asMerge(first, second, NULL, &result) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect error on invalid combination.\n");
+        passed = false;
+    }
+
+    // Subtracting in place replaces the first set's contents
+    visited[0] = '\0';
+    if (asSubtract(first, second, NULL) != AS_SUCCESS || asGetSize(first) != 2 ||
+        asGetRange(first, NULL, NULL, AppendElement, visited) != AS_SUCCESS || strcmp(visited, "A,C,") ||
+        asSubtract(second, second, NULL) != AS_SUCCESS || asGetSize(second) != 0)
+    {
+        printf("Incorrect subtraction.\n");
+        passed = false;
+    }
+
+    asDestroy(first);
+    asDestroy(second);
+    return passed;
+}
+
+bool testTopK()
+{
+    AmountSet set = asCreate();
+    char item[16];
+    bool passed = true;
+
+    // Scrambled amounts with many ties, changed up and down
+    for (int i = 0; i < 500; i++)
+    {
+        sprintf(item, "%05d", (i * 7919) % 503);
+        asUpsertAmount(set, item, i % 17, NULL);
+    }
+    for (int i = 0; i < 500; i += 3)
+    {
+        sprintf(item, "%05d", i);
+        asChangeAmount(set, item, (i % 5) * 3);
+        sprintf(item, "%05d", i + 1);
+        asDelete(set, item);
+    }
+
+    AmountSet copy = asCopy(set);
+    asChangeAmount(copy, "00002", 100);
+    AmountSet merged = NULL;
+    asMerge(set, copy, asCombineMax, &merged);
+    if (!CheckAmountOrder(set) || !CheckAmountOrder(copy) || !CheckAmountOrder(merged))
+    {
+        printf("Incorrect amount order.\n");
+        passed = false;
+    }
+
+    const char *top[2];
+    double top_amounts[2];
+    if (asTopK(copy, 2, top, top_amounts) != 2 || strcmp(top[0], "00002") || top_amounts[0] != 100 ||
+        asRankOf(copy, "00002") != 1 || asRankOf(copy, "00001") != 0 || asRankOf(NULL, "00002") != -1 ||
+        asTopK(copy, 0, top, NULL) != 0 || asTopK(copy, -1, top, NULL) != -1)
+    {
+        printf("Incorrect top elements.\n");
+        passed = false;
+    }
+
+    asClear(set);
+    if (asTopK(set, 2, top, NULL) != 0)
+    {
+        printf("Incorrect top elements of an empty set.\n");
+        passed = false;
+    }
+
+    asDestroy(set);
+    asDestroy(copy);
+    asDestroy(merged);
+    return passed;
+}
+
+bool testFreeze()
+{
+    AmountSet set = asCreate();
+    char item[16];
+    bool passed = true;
+
+    // 7919 is coprime with 307, so this registers every number below 307 in scrambled order
+    for (int i = 0; i < 307; i++)
+    {
+        sprintf(item, "%05d", (i * 7919) % 307);
+        asUpsertAmount(set, item, i % 23, NULL);
+    }
+
+    AmountSet reference = asCopy(set);
+    double sum = asSumAmounts(set);
+    int below = asCountBelow(set, 10);
+    if (asFreeze(set) != AS_SUCCESS || !asIsFrozen(set) || asIsFrozen(reference) ||
+        asGetSize(set) != 307 || asSumAmounts(set) != sum || asCountBelow(set, 10) != below)
+    {
+        printf("Incorrect frozen aggregates.\n");
+        passed = false;
+    }
+
+    AmountSetIterator iterator;
+    char *expected = asGetFirst(reference);
+    AS_FOREACH_ITERATOR(char *, element, iterator, set)
+    {
+        double amount, expected_amount;
+        asIteratorGetAmount(&iterator, &amount);
+        asGetAmount(reference, element, &expected_amount);
+        if (!expected || strcmp(element, expected) || amount != expected_amount ||
+            asRankOf(set, element) != asRankOf(reference, element))
+        {
+            printf("Incorrect frozen element %s.\n", element);
+            passed = false;
+            break;
+        }
+        expected = asGetNext(reference);
+    }
+
+    const char *top[5], *expected_top[5];
+    asTopK(set, 5, top, NULL);
+    asTopK(reference, 5, expected_top, NULL);
+    for (int i = 0; i < 5; i++)
+    {
+        if (strcmp(top[i], expected_top[i]))
+            passed = false;
+    }
+
+    char visited[64] = "";
+    asGetPrefix(set, "0001", AppendElement, visited);
+    if (strcmp(visited, "00010,00011,00012,00013,00014,00015,00016,00017,00018,00019,") ||
+        asCountRange(set, "00100", "00199") != 100 || asCountRange(set, "0", "00000") != 1 ||
+        asContains(set, "00307") || !asContains(set, "00306"))
+    {
+        printf("Incorrect frozen queries.\n");
+        passed = false;
+    }
+
+    AmountSet merged = NULL;
+    if (asMerge(set, reference, asCombineMax, &merged) != AS_SUCCESS || asGetSize(merged) != 307 ||
+        asSumAmounts(merged) != sum || asIsFrozen(merged))
+    {
+        printf("Incorrect merge of a frozen set.\n");
+        passed = false;
+    }
+    asDestroy(merged);
+
+    // Changes that fail leave the set frozen
+    bool created = true;
+    if (asRegister(set, "00001") != AS_ITEM_ALREADY_EXISTS || asDelete(set, "00307") != AS_ITEM_DOES_NOT_EXIST ||
+        asChangeAmount(set, "00307", 1) != AS_ITEM_DOES_NOT_EXIST ||
+        asChangeAmount(set, "00001", -1000) != AS_INSUFFICIENT_AMOUNT ||
+        asUpsertAmount(set, "00307", -1, &created) != AS_INSUFFICIENT_AMOUNT || created ||
+        asHandleChangeAmount(asFindHandle(set, "00001"), -1000) != AS_INSUFFICIENT_AMOUNT || !asIsFrozen(set))
+    {
+        printf("Incorrect failing change of a frozen set.\n");
+        passed = false;
+    }
+
+    // A copy is frozen too, and changing a frozen set thaws it keeping its iterator
+    AmountSet copy = asCopy(set);
+    asGetFirst(set);
+    asGetNext(set);
+    double amount;
+    if (!asIsFrozen(copy) || asChangeAmount(set, "00001", 1000) != AS_SUCCESS || asIsFrozen(set) ||
+        strcmp(asGetNext(set), "00002") || asGetAmount(copy, "00001", &amount) != AS_SUCCESS ||
+        amount == 1000 || asRankOf(set, "00001") != 1 || asThaw(copy) != AS_SUCCESS || asIsFrozen(copy))
+    {
+        printf("Incorrect thawing.\n");
+        passed = false;
+    }
+
+    asDestroy(set);
+    asDestroy(copy);
+    asDestroy(reference);
+    return passed;
+}
+
+bool testFingerSearch()
+{
+    AmountSet set = asCreate();
+    char item[16];
+    bool passed = true;
+    long hits, misses;
+
+    // An ascending feed searches from the previous position, except for the
+    // first 16 elements, which are kept in a small array, and the first search
+    // of the nodes they are moved into
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(item, "%05d", i * 2);
+        asRegister(set, item);
+    }
+    if (asGetFingerStats(set, &hits, &misses) != AS_SUCCESS || hits != 1000 - 17 || misses != 1)
+    {
+        printf("Incorrect finger stats %ld/%ld.\n", hits, misses);
+        passed = false;
+    }
+
+    // Descending and interleaved changes must still land in order
+    for (int i = 999; i >= 0; i -= 2)
+    {
+        sprintf(item, "%05d", i * 2 + 1);
+        asRegister(set, item);
+        sprintf(item, "%05d", i * 2);
+        asDelete(set, item);
+    }
+    for (int i = 0; i < 1000; i += 4)
+    {
+        sprintf(item, "%05d", i * 2 + 1);
+        asDelete(set, item);
+        sprintf(item, "%05d", i * 2 + 2);
+        asRegister(set, item);
+    }
+
+    char *previous = NULL;
+    int count = 0;
+    AS_FOREACH(char *, element, set)
+    {
+        if (previous && strcmp(previous, element) >= 0)
+        {
+            printf("Incorrect order, %s before %s.\n", previous, element);
+            passed = false;
+            break;
+        }
+        previous = element;
+        count++;
+    }
+
+    asGetFingerStats(set, &hits, &misses);
+    if (count != asGetSize(set) || count != 1250 || hits <= misses ||
+        asGetFingerStats(set, NULL, &misses) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect elements after finger searches.\n");
+        passed = false;
+    }
+
+    // Every new smallest element is searched for from the first element
+    long previous_hits = hits, previous_misses = misses;
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(item, "-%05d", 99 - i);
+        asRegister(set, item);
+    }
+    asGetFingerStats(set, &hits, &misses);
+    if (hits != previous_hits || misses != previous_misses + 100)
+    {
+        printf("Incorrect finger stats %ld/%ld for new smallest elements.\n", hits - previous_hits,
+               misses - previous_misses);
+        passed = false;
+    }
+
+    asDestroy(set);
+    return passed;
+}
+
+bool testSaveBinary()
+{
+    const char *path = "amount_set_str_test.bin";
+    AmountSet set = CreateDummy(50);
+    bool passed = true;
+    int i = 0;
+    AS_FOREACH(char *, item, set)
+    {
+        asChangeAmount(set, item, (i++ % 7) + 0.5);
+    }
+
+    AmountSet mapped = NULL;
+    if (asSaveBinary(set, path) != AS_SUCCESS || asOpenMapped(path, &mapped) != AS_SUCCESS ||
+        !asIsFrozen(mapped) || asGetSize(mapped) != 50 || asSumAmounts(mapped) != asSumAmounts(set))
+    {
+        printf("Failed to reopen the saved set.\n");
+        passed = false;
+    }
+
+    char *expected = asGetFirst(set);
+    AS_FOREACH(char *, item, mapped)
+    {
+        double amount = -1, expected_amount;
+        asGetAmount(mapped, item, &amount);
+        asGetAmount(set, item, &expected_amount);
+        if (!expected || strcmp(item, expected) || amount != expected_amount ||
+            asRankOf(mapped, item) != asRankOf(set, item))
+        {
+            printf("Incorrect element %s in the saved set.\n", item);
+            passed = false;
+            break;
+        }
+        expected = asGetNext(set);
+    }
+
+    // Changing the mapped set copies it into memory, the file is left as it was
+    AmountSet reopened = NULL;
+    if (asDelete(mapped, "Item 1") != AS_SUCCESS || asIsFrozen(mapped) || asGetSize(mapped) != 49 ||
+        asOpenMapped(path, &reopened) != AS_SUCCESS || !asContains(reopened, "Item 1"))
+    {
+        printf("Incorrect change of the mapped set.\n");
+        passed = false;
+    }
+    asDestroy(reopened);
+
+    // Any damage to the file must be detected
+    FILE *file = fopen(path, "r+b");
+    fseek(file, -1, SEEK_END);
+    fputc('x', file);
+    fclose(file);
+    reopened = NULL;
+    if (asOpenMapped(path, &reopened) != AS_INVALID_FILE || reopened != NULL ||
+        asOpenMapped("amount_set_str_missing.bin", &reopened) != AS_IO_ERROR ||
+        asSaveBinary(NULL, path) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect error on an invalid file.\n");
+        passed = false;
+    }
+
+    remove(path);
+    asDestroy(set);
+    asDestroy(mapped);
+    return passed;
+}
+
+bool testJournal()
+{
+    AmountSet set = CreateDummy(10);
+    bool passed = true;
+    if (asGetSequence(set) != 0 || asEnableJournal(set, 8) != AS_SUCCESS ||
+        asReadChangesSince(set, 0, ApplyChange, NULL) != AS_SUCCESS)
+    {
+        printf("Incorrect empty journal.\n");
+        passed = false;
+    }
+
+    AmountSet replica = asCopy(set);
+    long sequence = asGetSequence(set);
+    asRegister(set, "Item 20");
+    asChangeAmount(set, "Item 20", 2.5);
+    asDelete(set, "Item 3");
+    asUpsertAmount(set, "Item 21", 4, NULL);
+    asChangeAmount(set, "Item 4", -100); // Fails and isn't recorded
+    if (asGetSequence(set) != 5 || asReadChangesSince(set, sequence, ApplyChange, replica) != AS_SUCCESS ||
+        !SameSets(set, replica))
+    {
+        printf("Incorrect replica after reading the journal.\n");
+        passed = false;
+    }
+
+    // Only the last 8 changes are kept
+    sequence = asGetSequence(set);
+    for (int i = 0; i < 9; i++)
+        asChangeAmount(set, "Item 5", 1);
+
+    if (asReadChangesSince(set, sequence, ApplyChange, replica) != AS_JOURNAL_OVERFLOW)
+    {
+        printf("Overwritten changes were read from the journal.\n");
+        passed = false;
+    }
+
+    // Make the overwritten change by hand, the rest are still in the journal
+    asChangeAmount(replica, "Item 5", 1);
+    if (asReadChangesSince(set, sequence + 1, ApplyChange, replica) != AS_SUCCESS || !SameSets(set, replica) ||
+        asReadChangesSince(set, asGetSequence(set) + 1, ApplyChange, replica) != AS_JOURNAL_OVERFLOW)
+    {
+        printf("Incorrect journal overflow.\n");
+        passed = false;
+    }
+
+    // Changes that aren't recorded one element at a time drop the journal
+    sequence = asGetSequence(set);
+    AmountSet other = CreateDummy(12);
+    asClear(replica);
+    asMerge(set, other, asCombineSum, NULL);
+    if (asReadChangesSince(set, sequence, ApplyChange, NULL) != AS_JOURNAL_OVERFLOW)
+    {
+        printf("Incorrect journal after merging into the set.\n");
+        passed = false;
+    }
+
+    sequence = asGetSequence(set);
+    asClear(set);
+    asRegister(set, "Item 1");
+    if (asReadChangesSince(set, sequence, ApplyChange, replica) != AS_SUCCESS || !SameSets(set, replica) ||
+        asEnableJournal(set, 0) != AS_SUCCESS || asGetSequence(set) != 0 ||
+        asReadChangesSince(set, 0, ApplyChange, NULL) != AS_JOURNAL_OVERFLOW ||
+        asReadChangesSince(NULL, 0, ApplyChange, NULL) != AS_NULL_ARGUMENT ||
+        asEnableJournal(set, -1) != AS_NULL_ARGUMENT || asApplyChanges(replica, NULL, 1) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect journal after clearing the set.\n");
+        passed = false;
+    }
+
+    asDestroy(other);
+    asDestroy(replica);
+    asDestroy(set);
+    return passed;
+}
+
+bool testStats()
+{
+    AmountSet set = CreateDummy(100);
+    AmountSetStats stats;
+    bool passed = true;
+    if (asGetStats(set, &stats) != AS_SUCCESS || stats.memory_bytes == 0 || stats.blocks == 0 ||
+        stats.mapped_bytes != 0 || asGetStats(set, NULL) != AS_NULL_ARGUMENT || asGetStats(NULL, &stats) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect memory footprint.\n");
+        passed = false;
+    }
+
+    size_t memory_bytes = stats.memory_bytes;
+    double amount;
+    asContains(set, "Item 5");
+    asGetAmount(set, "Item 6", &amount);
+    asChangeAmount(set, "Item 7", 1);
+    asDelete(set, "Item 8");
+    asCountRange(set, NULL, NULL);
+    asGetStats(set, &stats);
+    // Without AS_STATS nothing is counted
+    bool counted = stats.counting ?
+        stats.registers == 100 && stats.lookups == 2 && stats.changes == 1 && stats.deletes == 1 &&
+        stats.range_queries == 1 && stats.node_allocations == 100 && stats.node_frees == 1 &&
+        stats.searches > 0 && stats.max_nodes_visited >= stats.average_nodes_visited &&
+        stats.average_nodes_visited > 0 && stats.index_searches > 0 && stats.max_index_probes > 0 :
+        stats.registers == 0 && stats.searches == 0 && stats.node_allocations == 0;
+    if (!counted || stats.memory_bytes != memory_bytes)
+    {
+        printf("Incorrect counters.\n");
+        passed = false;
+    }
+
+    // A copy continues from the counters of its source
+    AmountSet copy = asCopy(set);
+    for (int i = 0; i < 1000; i++)
+    {
+        char item[16];
+        sprintf(item, "Other %d", i);
+        asRegister(copy, item);
+    }
+
+    asGetStats(copy, &stats);
+    if (stats.memory_bytes <= memory_bytes || (stats.counting && stats.registers != 1100))
+    {
+        printf("Incorrect counters of a copy.\n");
+        passed = false;
+    }
+
+    asDestroy(copy);
+    asDestroy(set);
+    return passed;
+}
+
+bool testSmallSet()
+{
+    AmountSet set = asCreate();
+    AmountSetStats stats;
+    char item[32];
+    bool passed = true;
+
+    // Up to 16 elements are kept in a single array, without memory blocks for nodes
+    for (int i = 16; i > 0; i--)
+    {
+        sprintf(item, "Item %02d", i);
+        asUpsertAmount(set, item, i % 5, NULL);
+    }
+    asGetStats(set, &stats);
+    if (stats.blocks != 0 || asIsFrozen(set) || asGetSize(set) != 16 || !CheckAmountOrder(set) ||
+        asRankOf(set, "Item 04") != 1 || asChangeAmount(set, "Item 05", -1) != AS_INSUFFICIENT_AMOUNT ||
+        asRegister(set, "Item 01") != AS_ITEM_ALREADY_EXISTS || asDelete(set, "Item 00") != AS_ITEM_DOES_NOT_EXIST)
+    {
+        printf("Incorrect small set.\n");
+        passed = false;
+    }
+
+    // A copy shares the array until either of them changes
+    AmountSet copy = asCopy(set);
+    int i = 1;
+    AS_FOREACH(char *, element, set)
+    {
+        sprintf(item, "Item %02d", i++);
+        if (strcmp(element, item) != 0 || asChangeAmount(set, element, 10) != AS_SUCCESS)
+        {
+            printf("Incorrect element %s of a small set.\n", element);
+            passed = false;
+            break;
+        }
+    }
+
+    double amount = -1;
+    if (i != 17 || asGetAmount(copy, "Item 03", &amount) != AS_SUCCESS || amount != 3 ||
+        asGetAmount(set, "Item 03", &amount) != AS_SUCCESS || amount != 13 || !CheckAmountOrder(set))
+    {
+        printf("Incorrect change of a shared small set.\n");
+        passed = false;
+    }
+
+    // The 17th element moves them to nodes, and deleting back to 8 returns to an array
+    asRegister(set, "Item 17");
+    asGetStats(set, &stats);
+    if (stats.blocks == 0 || asGetSize(set) != 17 || !CheckAmountOrder(set))
+    {
+        printf("Incorrect set after growing past the small size.\n");
+        passed = false;
+    }
+
+    for (i = 1; i <= 9; i++)
+    {
+        sprintf(item, "Item %02d", i * 2 - 1);
+        asDelete(set, item);
+    }
+    asGetStats(set, &stats);
+    if (stats.blocks != 0 || asGetSize(set) != 8 || !CheckAmountOrder(set) || asContains(set, "Item 03") ||
+        !asContains(set, "Item 16") || asCountRange(set, "Item 02", "Item 08") != 4)
+    {
+        printf("Incorrect set after shrinking to the small size.\n");
+        passed = false;
+    }
+
+    asDestroy(copy);
+    asDestroy(set);
+    return passed;
+}
+
+bool testFilter()
+{
+    AmountSet set = CreateDummy(1000);
+    AmountSetStats stats;
+    char item[32];
+    bool passed = true;
+
+    if (asEnableFilter(NULL, 0.01) != AS_NULL_ARGUMENT || asEnableFilter(set, -0.5) != AS_NULL_ARGUMENT ||
+        asEnableFilter(set, 1) != AS_NULL_ARGUMENT || asEnableFilter(set, 0.01) != AS_SUCCESS)
+    {
+        printf("Incorrect arguments of asEnableFilter.\n");
+        passed = false;
+    }
+
+    // Elements of the set are never rejected, while most missing ones are
+    int false_positives = 0;
+    double amount = -1;
+    for (int i = 1; i <= 1000; i++)
+    {
+        sprintf(item, "Item %d", i);
+        if (!asContains(set, item) || asGetAmount(set, item, &amount) != AS_SUCCESS)
+        {
+            printf("Filter rejected %s.\n", item);
+            passed = false;
+            break;
+        }
+
+        sprintf(item, "Missing %d", i);
+        false_positives += asContains(set, item);
+    }
+    asGetStats(set, &stats);
+    if (false_positives > 50 || (stats.counting && stats.filter_rejects != 1000 - false_positives))
+    {
+        printf("Filter let through %d missing elements.\n", false_positives);
+        passed = false;
+    }
+
+    // Registered elements are added, deleted ones are found missing, also after a rebuild
+    for (int i = 1001; i <= 3000; i++)
+    {
+        sprintf(item, "Item %d", i);
+        asRegister(set, item);
+    }
+    for (int i = 1; i <= 800; i++)
+    {
+        sprintf(item, "Item %d", i);
+        asDelete(set, item);
+    }
+    for (int i = 1; i <= 3000 && passed; i++)
+    {
+        sprintf(item, "Item %d", i);
+        if (asContains(set, item) != (i > 800))
+        {
+            printf("Incorrect lookup of %s after changes.\n", item);
+            passed = false;
+        }
+    }
+
+    // Merging into the set rebuilds the filter, copies are not filtered
+    AmountSet other = asCreate();
+    asRegister(other, "Merged");
+    asMerge(set, other, asCombineSum, NULL);
+    AmountSet copy = asCopy(set);
+    asFreeze(copy);
+    AmountSetStats copy_stats;
+    asGetStats(copy, &copy_stats);
+    asGetStats(set, &stats);
+    if (!asContains(set, "Merged") || !asContains(copy, "Merged") || asContains(copy, "Missing") ||
+        copy_stats.memory_bytes >= stats.memory_bytes)
+    {
+        printf("Incorrect filter after merging.\n");
+        passed = false;
+    }
+
+    // A frozen set is filtered too, and clearing empties the filter
+    asFreeze(set);
+    if (!asContains(set, "Item 2000") || asContains(set, "Item 200") || asGetAmount(set, "Item 1", &amount) !=
+        AS_ITEM_DOES_NOT_EXIST)
+    {
+        printf("Incorrect filter of a frozen set.\n");
+        passed = false;
+    }
+
+    asClear(set);
+    asRegister(set, "Item 1");
+    if (asContains(set, "Item 2000") || !asContains(set, "Item 1") || asEnableFilter(set, 0) != AS_SUCCESS ||
+        !asContains(set, "Item 1"))
+    {
+        printf("Incorrect filter after clearing.\n");
+        passed = false;
+    }
+
+    asDestroy(copy);
+    asDestroy(other);
+    asDestroy(set);
+    return passed;
+}
+
+bool testHandle()
+{
+    AmountSet set = CreateDummy(10);
+    asEnableJournal(set, 10);
+    bool passed = true;
+
+    AmountSetHandle handle = asFindHandle(set, "Item 5");
+    double amount = -1;
+    if (!handle || asFindHandle(set, "Item 5") != handle || asFindHandle(set, "Item 11") != NULL ||
+        asFindHandle(NULL, "Item 5") != NULL || asHandleGetAmount(NULL, &amount) != AS_NULL_ARGUMENT ||
+        asHandleGetAmount(handle, NULL) != AS_NULL_ARGUMENT || asHandleChangeAmount(NULL, 1) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect arguments of handle functions.\n");
+        return false;
+    }
+
+    if (asHandleChangeAmount(handle, 5) != AS_SUCCESS || asHandleChangeAmount(handle, -6) != AS_INSUFFICIENT_AMOUNT ||
+        asGetAmount(set, "Item 5", &amount) != AS_SUCCESS || amount != 5 || !CheckAmountOrder(set) ||
+        asGetSequence(set) != 1)
+    {
+        printf("Incorrect change through a handle.\n");
+        passed = false;
+    }
+
+    // The handle follows its element when the set grows past the small size, is copied and is frozen
+    AmountSet grown = CreateDummy(100);
+    asMerge(set, grown, NULL, NULL);
+    AmountSet copy = asCopy(set);
+    for (int i = 0; i < 100; i++)
+        asHandleChangeAmount(handle, 1);
+
+    asFreeze(set);
+    asHandleChangeAmount(handle, 0.5);
+    if (asGetAmount(set, "Item 5", &amount) != AS_SUCCESS || amount != 105.5 || asIsFrozen(set) ||
+        asHandleGetAmount(handle, &amount) != AS_SUCCESS || amount != 105.5 ||
+        asGetAmount(copy, "Item 5", &amount) != AS_SUCCESS || amount != 5 || !CheckAmountOrder(set))
+    {
+        printf("Incorrect handle after the set changed representation.\n");
+        passed = false;
+    }
+
+    // Deleting other elements moves the element, deleting it invalidates the handle until it is registered
+    asDelete(set, "Item 4");
+    if (asHandleGetAmount(handle, &amount) != AS_SUCCESS || amount != 105.5)
+    {
+        printf("Incorrect handle after deleting another element.\n");
+        passed = false;
+    }
+
+    // A new element may take the memory of the deleted one
+    asDelete(set, "Item 5");
+    asRegister(set, "Item 0");
+    if (asHandleGetAmount(handle, &amount) != AS_ITEM_DOES_NOT_EXIST ||
+        asHandleChangeAmount(handle, 1) != AS_ITEM_DOES_NOT_EXIST)
+    {
+        printf("Incorrect handle of a deleted element.\n");
+        passed = false;
+    }
+
+    asRegister(set, "Item 5");
+    if (asHandleChangeAmount(handle, 2) != AS_SUCCESS || asGetAmount(set, "Item 5", &amount) != AS_SUCCESS ||
+        amount != 2 || asFindHandle(set, "Item 5") != handle)
+    {
+        printf("Incorrect handle of a registered again element.\n");
+        passed = false;
+    }
+
+    // Many handles are found again by their element, a released one is replaced by a new handle
+    AmountSet large = CreateDummy(100);
+    AmountSetHandle many[100];
+    char item[16];
+    double expected;
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(item, "Item %d", i + 1);
+        asChangeAmount(large, item, i);
+        many[i] = asFindHandle(large, item);
+    }
+    asHandleRelease(many[49]);
+    asHandleRelease(NULL);
+    for (int i = 0; i < 100 && passed; i++)
+    {
+        sprintf(item, "Item %d", i + 1);
+        AmountSetHandle found = asFindHandle(large, item);
+        if (!found || (i != 49 && found != many[i]) || asHandleGetAmount(found, &amount) != AS_SUCCESS ||
+            asGetAmount(large, item, &expected) != AS_SUCCESS || amount != expected || amount != i)
+        {
+            printf("Incorrect handle of %s among many.\n", item);
+            passed = false;
+        }
+    }
+
+    asDestroy(large);
+    asDestroy(copy);
+    asDestroy(grown);
+    asDestroy(set);
+    return passed;
+}
+
+bool testRadix()
+{
+    AmountSetRadix radix = asRadixCreate();
+    AmountSet set = asCreate();
+    char item[32];
+    bool passed = true;
+
+    // Elements that are prefixes of others, the empty element and bytes past 127 split every kind of node
+    const char *special[] = {"", "A", "AB", "ABC", "ABD", "B", "\xff", "\xff\x01"};
+    for (unsigned int i = 0; i < sizeof(special) / sizeof(*special); i++)
+    {
+        asRadixRegister(radix, special[i]);
+        asRegister(set, special[i]);
+    }
+
+    // Random changes of elements sharing prefixes, compared with a regular set
+    unsigned int random_state = 7;
+    for (int round = 0; round < 20000 && passed; round++)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        unsigned int random = random_state >> 8;
+        sprintf(item, "WH%d-BIN%d%c", random % 3, (random >> 2) % 300, 'a' + (random >> 12) % 60);
+        AmountSetResult expected;
+        AmountSetResult result;
+        switch ((random >> 20) % 4)
+        {
+        case 0:
+        case 1:
+            expected = asRegister(set, item);
+            result = asRadixRegister(radix, item);
+            break;
+        case 2:
+            expected = asChangeAmount(set, item, (random >> 24) % 5);
+            result = asRadixChangeAmount(radix, item, (random >> 24) % 5);
+            break;
+        default:
+            expected = asDelete(set, item);
+            result = asRadixDelete(radix, item);
+            break;
+        }
+
+        if (result != expected || (round % 1000 == 0 && !SameRadixSet(radix, set)))
+        {
+            printf("Radix set differs after changing %s.\n", item);
+            passed = false;
+        }
+    }
+
+    double amount = -1;
+    AmountSet copy = asRadixCopy(radix);
+    if (!SameRadixSet(radix, set) || !SameSets(copy, set) || asRadixGetAmount(radix, "ABC", &amount) != AS_SUCCESS ||
+        amount != 0 || asRadixChangeAmount(radix, "ABC", -1) != AS_INSUFFICIENT_AMOUNT ||
+        asRadixContains(radix, "AB\xff") || asRadixRegister(radix, "") != AS_ITEM_ALREADY_EXISTS ||
+        asRadixDelete(radix, "ABE") != AS_ITEM_DOES_NOT_EXIST)
+    {
+        printf("Incorrect radix set.\n");
+        passed = false;
+    }
+
+    size_t memory = asRadixGetMemory(radix);
+    AS_FOREACH(char *, element, copy)
+    {
+        asRadixDelete(radix, element);
+    }
+    if (asRadixGetSize(radix) != 0 || asRadixGetFirst(radix) != NULL || asRadixGetMemory(radix) >= memory ||
+        asRadixGetSize(NULL) != -1 || asRadixRegister(NULL, "A") != AS_NULL_ARGUMENT ||
+        asRadixClear(radix) != AS_SUCCESS)
+    {
+        printf("Incorrect radix set after deleting everything.\n");
+        passed = false;
+    }
+
+    asDestroy(copy);
+    asDestroy(set);
+    asRadixDestroy(radix);
+    return passed;
+}
+
+bool testParallel()
+{
+    // Enough unsorted elements for every thread to sort a run of its own
+    const int size = 40000;
+    char *elements = malloc(size * 16);
+    const char **pointers = malloc(size * sizeof(*pointers));
+    double *amounts = malloc(size * sizeof(*amounts));
+    if (!elements || !pointers || !amounts)
+    {
+        free(elements);
+        free(pointers);
+        free(amounts);
+        return false;
+    }
+
+    for (int i = 0; i < size; i++)
+    {
+        sprintf(elements + i * 16, "item%d", (int)((i * 7919L) % size));
+        pointers[i] = elements + i * 16;
+        amounts[i] = i % 97;
+    }
+
+    bool passed = true;
+    AmountSet expected = NULL;
+    AmountSet set = NULL;
+    asCreateFromArrays(pointers, amounts, size, &expected);
+    if (asCreateFromArraysParallel(pointers, amounts, size, 4, &set) != AS_SUCCESS || !SameSets(set, expected) ||
+        !CheckAmountOrder(set))
+    {
+        printf("Incorrect set created by several threads.\n");
+        passed = false;
+    }
+
+    // Too few elements for 16 runs are sorted by as many threads as have a full run
+    AmountSet fewer = NULL;
+    if (asCreateFromArraysParallel(pointers, amounts, size, 16, &fewer) != AS_SUCCESS || !SameSets(fewer, expected) ||
+        !CheckAmountOrder(fewer))
+    {
+        printf("Incorrect set created by fewer threads than requested.\n");
+        passed = false;
+    }
+    asDestroy(fewer);
+
+    // Frozen elements are copied in parts, the copy keeps its elements when the source is gone
+    AmountSet copy = NULL;
+    if (set && asFreeze(set) == AS_SUCCESS)
+    {
+        copy = asCopyParallel(set, 3);
+        asDestroy(set);
+        set = NULL;
+    }
+    if (!copy || !SameSets(copy, expected) || !CheckAmountOrder(copy) ||
+        asChangeAmount(copy, "item5", 1) != AS_SUCCESS)
+    {
+        printf("Incorrect copy made by several threads.\n");
+        passed = false;
+    }
+
+    pointers[size - 1] = pointers[0];
+    AmountSet duplicates = NULL;
+    if (asCreateFromArraysParallel(pointers, amounts, size, 4, &duplicates) != AS_ITEM_ALREADY_EXISTS ||
+        asCreateFromArraysParallel(pointers, amounts, size, 0, &duplicates) != AS_NULL_ARGUMENT ||
+        asCreateFromArraysParallel(pointers, amounts, -1, 4, &duplicates) != AS_NULL_ARGUMENT ||
+        asCopyParallel(expected, 0) != NULL)
+    {
+        printf("Incorrect result for invalid arguments.\n");
+        passed = false;
+    }
+
+    asDestroy(duplicates);
+    asDestroy(copy);
+    asDestroy(set);
+    asDestroy(expected);
+    free(elements);
+    free(pointers);
+    free(amounts);
+    return passed;
+}
+
+static void *ShardedWrite(void *argument)
+{
+    ShardedWriter *writer = argument;
+    char item[32];
+    for (int i = 0; i < SHARDED_ROUNDS; i++)
+    {
+        // Every writer changes elements of its own, spread over all shards
+        sprintf(item, "w%d-%d", writer->id, i);
+        if (asShardedRegister(writer->set, item) != AS_SUCCESS ||
+            asShardedChangeAmount(writer->set, item, i % 10) != AS_SUCCESS)
+            writer->passed = false;
+
+        sprintf(item, "w%d-%d", writer->id, i / 2);
+        if (i % 2 == 1 && asShardedDelete(writer->set, item) != AS_SUCCESS)
+            writer->passed = false;
+    }
+
+    return NULL;
+}
+
+bool testSharded()
+{
+    bool passed = true;
+    AmountSetSharded set = asShardedCreate(8);
+    pthread_t threads[SHARDED_WRITERS];
+    ShardedWriter writers[SHARDED_WRITERS];
+    for (int i = 0; i < SHARDED_WRITERS; i++)
+    {
+        writers[i].set = set;
+        writers[i].id = i;
+        writers[i].passed = true;
+        pthread_create(&threads[i], NULL, ShardedWrite, &writers[i]);
+    }
+
+    // The same changes applied by a single thread
+    AmountSet expected = asCreate();
+    char item[32];
+    for (int id = 0; id < SHARDED_WRITERS; id++)
+    {
+        for (int i = 0; i < SHARDED_ROUNDS; i++)
+        {
+            sprintf(item, "w%d-%d", id, i);
+            asRegister(expected, item);
+            asChangeAmount(expected, item, i % 10);
+            sprintf(item, "w%d-%d", id, i / 2);
+            if (i % 2 == 1)
+                asDelete(expected, item);
+        }
+    }
+
+    for (int i = 0; i < SHARDED_WRITERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        if (!writers[i].passed)
+        {
+            printf("Writer %d failed to change the set.\n", i);
+            passed = false;
+        }
+    }
+
+    // The merged iteration visits the shards' elements in a single ascending order
+    int count = 0;
+    char *expected_element = asGetFirst(expected);
+    AS_SHARDED_FOREACH(char *, element, set)
+    {
+        double amount = -1;
+        double expected_amount = -2;
+        asGetAmount(expected, element, &expected_amount);
+        if (!expected_element || strcmp(element, expected_element) != 0 ||
+            asShardedGetAmount(set, element, &amount) != AS_SUCCESS || amount != expected_amount)
+        {
+            printf("Incorrect element %s in the sharded set.\n", element);
+            passed = false;
+            break;
+        }
+
+        count++;
+        expected_element = asGetNext(expected);
+    }
+
+    AmountSet copy = asShardedCopy(set);
+    if (count != asGetSize(expected) || asShardedGetSize(set) != count || !SameSets(copy, expected) ||
+        !asShardedContains(set, "w1-1999") || asShardedContains(set, "w1-0") ||
+        asShardedRegister(set, "w1-1999") != AS_ITEM_ALREADY_EXISTS ||
+        asShardedChangeAmount(set, "w1-1999", -10) != AS_INSUFFICIENT_AMOUNT ||
+        asShardedDelete(set, "w1-0") != AS_ITEM_DOES_NOT_EXIST)
+    {
+        printf("Incorrect sharded set.\n");
+        passed = false;
+    }
+
+    if (asShardedClear(set) != AS_SUCCESS || asShardedGetSize(set) != 0 || asShardedGetFirst(set) != NULL ||
+        asShardedCreate(0) != NULL || asShardedRegister(NULL, "A") != AS_NULL_ARGUMENT ||
+        asShardedGetAmount(set, "A", NULL) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect cleared sharded set.\n");
+        passed = false;
+    }
+
+    asDestroy(copy);
+    asDestroy(expected);
+    asShardedDestroy(set);
+    return passed;
+}
+
+bool testStream()
+{
+    bool passed = true;
+    FILE *stream = tmpfile();
+    if (!stream)
+        return false;
+
+    // Sorted lines are appended, from "Apple" on elements are searched for
+    fputs("Banana 2\nCherry pie\t0.25\r\n\nDate 1e3\nApple 1.5\nBanana   3\n Fig 7", stream);
+    rewind(stream);
+    AmountSet set = asCreate();
+    double amount = -1;
+    if (asLoadStream(set, stream) != AS_SUCCESS || asGetSize(set) != 5 ||
+        asGetAmount(set, "Banana", &amount) != AS_SUCCESS || amount != 5 ||
+        asGetAmount(set, "Cherry pie", &amount) != AS_SUCCESS || amount != 0.25 ||
+        asGetAmount(set, "Date", &amount) != AS_SUCCESS || amount != 1000 ||
+        asGetAmount(set, " Fig", &amount) != AS_SUCCESS || amount != 7 || !CheckAmountOrder(set))
+    {
+        printf("Incorrect set loaded from a stream.\n");
+        passed = false;
+    }
+
+    // Into a set with elements, amounts are added
+    rewind(stream);
+    if (asLoadStream(set, stream) != AS_SUCCESS || asGetSize(set) != 5 ||
+        asGetAmount(set, "Banana", &amount) != AS_SUCCESS || amount != 10)
+    {
+        printf("Incorrect amounts loaded into a set with elements.\n");
+        passed = false;
+    }
+    fclose(stream);
+
+    // Enough elements to cross the blocks the stream is read in, with amounts needing all their digits
+    AmountSet large = asCreate();
+    char item[32];
+    for (int i = 0; i < 60000; i++)
+    {
+        sprintf(item, "Item %05d", i);
+        asRegister(large, item);
+        asChangeAmount(large, item, i % 3 == 0 ? i / 7.0 : i * 0.25);
+    }
+    asChangeAmount(large, "Item 00001", 1e300);
+
+    AmountSet loaded = asCreate();
+    stream = tmpfile();
+    AmountSetResult dump_result = stream ? asDumpStream(large, stream) : AS_IO_ERROR;
+    if (stream)
+        rewind(stream);
+    if (dump_result != AS_SUCCESS || asLoadStream(loaded, stream) != AS_SUCCESS || !SameSets(large, loaded) ||
+        !CheckAmountOrder(loaded))
+    {
+        printf("Incorrect set read back from a dumped stream.\n");
+        passed = false;
+    }
+    if (stream)
+        fclose(stream);
+
+    AmountSet partial = asCreate();
+    stream = tmpfile();
+    if (stream)
+    {
+        fputs("A 1\nB -1\nC 1\n", stream);
+        rewind(stream);
+    }
+    if (!stream || asLoadStream(partial, stream) != AS_INSUFFICIENT_AMOUNT || asGetSize(partial) != 1)
+    {
+        printf("Incorrect result for a negative amount.\n");
+        passed = false;
+    }
+    if (stream)
+        fclose(stream);
+
+    stream = tmpfile();
+    if (stream)
+    {
+        fputs("D 1\nE\n", stream);
+        rewind(stream);
+    }
+    if (!stream || asLoadStream(partial, stream) != AS_INVALID_FILE || asGetSize(partial) != 2 ||
+        asLoadStream(NULL, stream) != AS_NULL_ARGUMENT || asDumpStream(partial, NULL) != AS_NULL_ARGUMENT)
+    {
+        printf("Incorrect result for a line without an amount.\n");
+        passed = false;
+    }
+    if (stream)
+        fclose(stream);
+
+    asDestroy(partial);
+    asDestroy(loaded);
+    asDestroy(large);
+    asDestroy(set);
+    return passed;
+}
+
+bool testAggregates()
+{
+    bool passed = true;
+    AmountSet set = asCreate();
+    char item[16];
+    double amount = -1;
+
+    // Ten additions of 0.1 don't add up to 1 when summed naively
+    for (int i = 0; i < 10; i++)
+    {
+        sprintf(item, "Tenth %d", i);
+        asUpsertAmount(set, item, 0.1, NULL);
+    }
+    if (asGetTotalAmount(set) != 1 || asCountPositive(set) != 10 || !CheckAggregates(set))
+    {
+        printf("Incorrect total of a small set.\n");
+        passed = false;
+    }
+
+    // Random changes across the small and the larger representations
+    unsigned int random_state = 11;
+    for (int round = 0; round < 5000 && passed; round++)
+    {
+        random_state = random_state * 1103515245 + 12345;
+        unsigned int random = random_state >> 8;
+        sprintf(item, "Item %d", random % 40);
+        switch ((random >> 8) % 4)
+        {
+        case 0:
+            asRegister(set, item);
+            break;
+        case 1:
+            asDelete(set, item);
+            break;
+        default:
+            asChangeAmount(set, item, (double)((random >> 12) % 7) - 3);
+            break;
+        }
+
+        if (round % 100 == 0 && !CheckAggregates(set))
+        {
+            printf("Incorrect aggregates after changing %s.\n", item);
+            passed = false;
+        }
+    }
+
+    // A large amount doesn't absorb a small one for good
+    asClear(set);
+    asUpsertAmount(set, "Large", 1e16, NULL);
+    asUpsertAmount(set, "Small", 1, NULL);
+    asDelete(set, "Large");
+    if (asGetTotalAmount(set) != 1 || asGetMinAmount(set, &amount) != AS_SUCCESS || amount != 1)
+    {
+        printf("Incorrect total after deleting a large amount.\n");
+        passed = false;
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(item, "Bulk %d", i);
+        asUpsertAmount(set, item, i % 10, NULL);
+    }
+
+    AmountSet copy = asCopy(set);
+    asFreeze(copy);
+    asChangeAmount(set, "Bulk 5", 100);
+    if (!CheckAggregates(set) || !CheckAggregates(copy) || asGetMaxAmount(set, &amount) != AS_SUCCESS ||
+        amount != 105 || asGetMaxAmount(copy, &amount) != AS_SUCCESS || amount != 9 ||
+        asGetTotalAmount(copy) != 451 || asCountPositive(copy) != 91)
+    {
+        printf("Incorrect aggregates of a set and its frozen copy.\n");
+        passed = false;
+    }
+
+    asClear(set);
+    if (asGetTotalAmount(set) != 0 || asCountPositive(set) != 0 ||
+        asGetMinAmount(set, &amount) != AS_ITEM_DOES_NOT_EXIST || asGetMaxAmount(NULL, &amount) != AS_NULL_ARGUMENT ||
+        asGetMinAmount(set, NULL) != AS_NULL_ARGUMENT || asGetTotalAmount(NULL) != -1)
+    {
+        printf("Incorrect aggregates of an empty set.\n");
+        passed = false;
+    }
+
+    asDestroy(copy);
+    asDestroy(set);
+    return passed;
+}
+
+static bool AppendElement(const char *element, double amount, void *context)
+{
+    (void)amount;
+    strcat(context, element);
+    strcat(context, ",");
+    return true;
+}
+
+static AmountSet CreateDummy(int items)
+{
+    AmountSet set = asCreate();
+    for (int i = 1; i <= items; i++)
+    {
+        char item[16];
+        sprintf(item, "Item %d", i);
+        asRegister(set, item);
+    }
+
+    return set;
+}
+
+static bool CheckAmountOrder(AmountSet set)
+{
+    int size = asGetSize(set);
+    const char **elements = malloc((size + 1) * sizeof(*elements));
+    double *amounts = malloc((size + 1) * sizeof(*amounts));
+    bool passed = elements && amounts && asTopK(set, size + 1, elements, amounts) == size;
+
+    for (int i = 0; passed && i < size; i++)
+    {
+        if (i > 0 && (amounts[i - 1] < amounts[i] ||
+                      (amounts[i - 1] == amounts[i] && strcmp(elements[i - 1], elements[i]) >= 0)))
+            passed = false;
+
+        if (asRankOf(set, elements[i]) != i + 1)
+            passed = false;
+    }
+
+    free(elements);
+    free(amounts);
+    return passed;
+}
+
+static bool ApplyChange(const AmountSetChange *change, void *context)
+{
+    if (context)
+        asApplyChanges(context, change, 1);
+
+    return true;
+}
+
+static bool SameSets(AmountSet first, AmountSet second)
+{
+    if (asGetSize(first) != asGetSize(second))
+        return false;
+
+    AmountSetIterator first_iterator, second_iterator;
+    char *first_element = asIteratorBegin(first, &first_iterator);
+    char *second_element = asIteratorBegin(second, &second_iterator);
+    for (; !asIteratorEnd(&first_iterator); first_element = asIteratorNext(&first_iterator),
+                                            second_element = asIteratorNext(&second_iterator))
+    {
+        double first_amount, second_amount;
+        asIteratorGetAmount(&first_iterator, &first_amount);
+        asIteratorGetAmount(&second_iterator, &second_amount);
+        if (strcmp(first_element, second_element) != 0 || first_amount != second_amount)
+            return false;
+    }
+
+    return true;
+}
+
+static bool SameRadixSet(AmountSetRadix radix, AmountSet set)
+{
+    if (asRadixGetSize(radix) != asGetSize(set))
+        return false;
+
+    char *radix_element = asRadixGetFirst(radix);
+    AS_FOREACH(char *, element, set)
+    {
+        double amount = -1;
+        double radix_amount = -2;
+        asGetAmount(set, element, &amount);
+        if (!radix_element || strcmp(radix_element, element) != 0 ||
+            asRadixGetAmount(radix, element, &radix_amount) != AS_SUCCESS || radix_amount != amount)
+            return false;
+
+        radix_element = asRadixGetNext(radix);
+    }
+
+    return radix_element == NULL;
+}
+
+static bool CheckAggregates(AmountSet set)
+{
+    double total = 0;
+    double min = 0;
+    double max = 0;
+    int positive = 0;
+    bool first = true;
+    AS_FOREACH(char *, element, set)
+    {
+        double amount;
+        asGetAmount(set, element, &amount);
+        total += amount;
+        positive += amount > 0;
+        if (first || amount < min)
+            min = amount;
+        if (first || amount > max)
+            max = amount;
+        first = false;
+    }
+
+    // The amounts checked add up exactly, or are tenths
+    double difference = asGetTotalAmount(set) - total;
+    double min_amount = -1;
+    double max_amount = -1;
+    AmountSetResult expected = first ? AS_ITEM_DOES_NOT_EXIST : AS_SUCCESS;
+    if (difference > 1e-9 || difference < -1e-9 || asCountPositive(set) != positive ||
+        asGetMinAmount(set, &min_amount) != expected || asGetMaxAmount(set, &max_amount) != expected)
+        return false;
+
+    return first || (min_amount == min && max_amount == max);
+}
@@ -23,15 +23,38 @@
 bool testCreate();
 bool testDestroy();
 bool testCopy();
+bool testCreateFromArrays();
 bool testGetSize();
 bool testContains();
 bool testGetAmount();
 bool testRegister();
 bool testChangeAmount();
+bool testUpsertAmount();
 bool testDelete();
 bool testClear();
 bool testGetFirst();
 bool testGetNext();
 bool testOrdered();
+bool testOrderedLarge();
+bool testIterator();
+bool testRange();
+bool testCopyOnWrite();
+bool testLongElementOrder();
+bool testSetAlgebra();
+bool testTopK();
+bool testFreeze();
+bool testFingerSearch();
+bool testSaveBinary();
+bool testJournal();
+bool testStats();
+bool testSmallSet();
+bool testFilter();
+bool testHandle();
+bool testRadix();
+bool testParallel();
+bool testSharded();
+bool testStream();
+bool testAggregates();
+bool testConcurrent();
 
 #endif //AMOUNT_SET_STR_TESTS_H_
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Cost of polling the total, smallest and largest amounts versus set size.
+ *
+ * Compares the running aggregates (asGetTotalAmount, asGetMinAmount,
+ * asGetMaxAmount) with scanning the set (asSumAmounts, and a walk over the
+ * elements for the smallest amount), and times asChangeAmount, which keeps
+ * the aggregates up to date.
+ */
+
+#define KEY_LENGTH 32
+#define POLLS 1000
+#define CHANGES 1000000
+
+static double secondsSince(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double scanMin(AmountSet set)
+{
+    double min = -1;
+    AS_FOREACH(char *, element, set)
+    {
+        double amount;
+        asGetAmount(set, element, &amount);
+        if (min < 0 || amount < min)
+            min = amount;
+    }
+
+    return min;
+}
+
+int main()
+{
+    int sizes[] = {1000, 10000, 100000, 1000000};
+    srand(1);
+
+    printf("%10s %14s %14s %14s %14s %14s\n", "size", "scan sum ns", "scan min ns", "running ns", "min+max ns",
+           "change ns");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        char **keys = malloc(size * sizeof(*keys));
+        double *amounts = malloc(size * sizeof(*amounts));
+        for (int i = 0; i < size; i++)
+        {
+            keys[i] = malloc(KEY_LENGTH);
+            sprintf(keys[i], "SKU-%08d", i);
+            amounts[i] = rand() % 1000;
+        }
+
+        AmountSet set = NULL;
+        asCreateFromArrays((const char *const *)keys, amounts, size, &set);
+
+        // Scans are polled fewer times on large sets
+        int scans = POLLS * 1000 / size + 1;
+        double checksum = 0;
+        clock_t start = clock();
+        for (int i = 0; i < scans; i++)
+            checksum += asSumAmounts(set);
+        double scan_sum = secondsSince(start) / scans;
+
+        start = clock();
+        for (int i = 0; i < scans; i++)
+            checksum += scanMin(set);
+        double scan_min = secondsSince(start) / scans;
+
+        start = clock();
+        for (int i = 0; i < POLLS * 1000; i++)
+            checksum += asGetTotalAmount(set);
+        double running = secondsSince(start) / (POLLS * 1000);
+
+        start = clock();
+        for (int i = 0; i < POLLS * 1000; i++)
+        {
+            double min, max;
+            asGetMinAmount(set, &min);
+            asGetMaxAmount(set, &max);
+            checksum += min + max;
+        }
+        double min_max = secondsSince(start) / (POLLS * 1000);
+
+        start = clock();
+        for (int i = 0; i < CHANGES; i++)
+            asChangeAmount(set, keys[rand() % size], i % 2 ? -1 : 1);
+        double change = secondsSince(start) / CHANGES;
+
+        printf("%10d %14.0f %14.0f %14.1f %14.1f %14.0f\n", size, scan_sum * 1e9, scan_min * 1e9, running * 1e9,
+               min_max * 1e9, change * 1e9);
+        if (checksum < 0)
+            printf("unexpected checksum\n");
+
+        asDestroy(set);
+        for (int i = 0; i < size; i++)
+            free(keys[i]);
+        free(keys);
+        free(amounts);
+    }
+
+    return 0;
+}
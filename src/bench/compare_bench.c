@@ -0,0 +1,69 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Ordered search cost versus key shape.
+ *
+ * Range counts and delete/register churn walk the skip list comparing keys,
+ * unlike point lookups which go through the hash index. Keys are SKU-like
+ * strings whose shared prefix grows from none to longer than the cached
+ * prefix of a node.
+ */
+
+#define KEY_LENGTH 64
+#define SET_SIZE 100000
+#define OPERATIONS 200000
+
+static const char *formats[] = {
+    "%08d-A",
+    "SKU-%08d",
+    "ACME-SKU-%08d",
+    "ACME-WAREHOUSE-EU-SKU-%08d",
+};
+
+static double elapsedNs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+int main()
+{
+    static char keys[SET_SIZE * 2 + 32][KEY_LENGTH];
+    srand(1);
+
+    printf("%-28s %18s %18s\n", "key format", "range ns/query", "churn ns/op");
+    for (unsigned int f = 0; f < sizeof(formats) / sizeof(*formats); f++)
+    {
+        // Keys are formatted up front so only the set operations are timed
+        for (int i = 0; i < SET_SIZE * 2 + 32; i++)
+            sprintf(keys[i], formats[f], i);
+
+        AmountSet set = asCreate();
+        for (int i = 0; i < SET_SIZE; i++)
+            asRegister(set, keys[i * 2]);
+
+        long checksum = 0;
+        clock_t start = clock();
+        for (int i = 0; i < OPERATIONS; i++)
+        {
+            int low = rand() % (SET_SIZE * 2);
+            checksum += asCountRange(set, keys[low], keys[low + 20]);
+        }
+        double range = elapsedNs(start, clock(), OPERATIONS);
+
+        start = clock();
+        for (int i = 0; i < OPERATIONS; i++)
+        {
+            char *key = keys[(rand() % SET_SIZE) * 2];
+            checksum += asDelete(set, key) + asRegister(set, key);
+        }
+        double churn = elapsedNs(start, clock(), OPERATIONS);
+
+        printf("%-28s %18.1f %18.1f   (checksum %ld)\n", formats[f], range, churn, checksum);
+        asDestroy(set);
+    }
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../amount_set_str_concurrent.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Read throughput of the concurrent set versus the number of reader threads.
+ *
+ * One writer keeps changing amounts and registering/deleting elements while
+ * the readers look up random elements for a fixed wall clock duration.
+ */
+
+#define SET_SIZE 100000
+#define KEY_LENGTH 32
+#define DURATION_SECONDS 1.0
+#define MAX_READERS 16
+
+typedef struct Worker_t
+{
+    AmountSetConcurrent set;
+    int done;
+    unsigned int seed;
+    unsigned long operations;
+} Worker;
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static unsigned int nextRandom(unsigned int *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void *readLoop(void *argument)
+{
+    Worker *worker = argument;
+    char key[KEY_LENGTH];
+    double amount, checksum = 0;
+    while (!__atomic_load_n(&worker->done, __ATOMIC_RELAXED))
+    {
+        sprintf(key, "SKU-%08u", nextRandom(&worker->seed) % SET_SIZE);
+        if (asConcurrentGetAmount(worker->set, key, &amount) == AS_SUCCESS)
+            checksum += amount;
+        worker->operations++;
+    }
+
+    return checksum < 0 ? worker : NULL;
+}
+
+static void *writeLoop(void *argument)
+{
+    Worker *worker = argument;
+    char key[KEY_LENGTH];
+    while (!__atomic_load_n(&worker->done, __ATOMIC_RELAXED))
+    {
+        unsigned int i = nextRandom(&worker->seed) % SET_SIZE;
+        sprintf(key, "SKU-%08u", i);
+        asConcurrentChangeAmount(worker->set, key, 1);
+        sprintf(key, "NEW-%08u", i);
+        if (asConcurrentRegister(worker->set, key) == AS_ITEM_ALREADY_EXISTS)
+            asConcurrentDelete(worker->set, key);
+        worker->operations++;
+    }
+
+    return NULL;
+}
+
+int main()
+{
+    AmountSetConcurrent set = asConcurrentCreate();
+    char key[KEY_LENGTH];
+    for (int i = 0; i < SET_SIZE; i++)
+    {
+        sprintf(key, "SKU-%08d", i);
+        asConcurrentRegister(set, key);
+    }
+
+    printf("%8s %16s %16s %16s\n", "readers", "reads/s", "reads/s/thread", "writes/s");
+    for (int readers = 1; readers <= MAX_READERS; readers *= 2)
+    {
+        pthread_t threads[MAX_READERS + 1];
+        Worker workers[MAX_READERS + 1];
+        for (int i = 0; i <= readers; i++)
+        {
+            workers[i].set = set;
+            workers[i].done = 0;
+            workers[i].seed = 2463534242u + i;
+            workers[i].operations = 0;
+        }
+
+        double start = now();
+        pthread_create(&threads[0], NULL, writeLoop, &workers[0]);
+        for (int i = 1; i <= readers; i++)
+            pthread_create(&threads[i], NULL, readLoop, &workers[i]);
+
+        struct timespec duration = {(time_t)DURATION_SECONDS, 0};
+        nanosleep(&duration, NULL);
+
+        unsigned long reads = 0;
+        for (int i = 0; i <= readers; i++)
+        {
+            __atomic_store_n(&workers[i].done, 1, __ATOMIC_RELAXED);
+            pthread_join(threads[i], NULL);
+            if (i > 0)
+                reads += workers[i].operations;
+        }
+        double elapsed = now() - start;
+
+        printf("%8d %16.0f %16.0f %16.0f\n", readers, reads / elapsed, reads / elapsed / readers,
+               workers[0].operations / elapsed);
+    }
+
+    asConcurrentDestroy(set);
+    return 0;
+}
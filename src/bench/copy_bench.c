@@ -0,0 +1,63 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Snapshot cost versus set size.
+ *
+ * Measures asCopy followed by reading the copy, which shares the source's
+ * elements, and the first change of the source after copying, which pays for
+ * copying the elements once.
+ */
+
+#define KEY_LENGTH 32
+#define SNAPSHOTS 100000
+
+static double elapsedNs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+int main()
+{
+    int sizes[] = {1000, 10000, 100000};
+    char key[KEY_LENGTH];
+
+    printf("%10s %18s %18s\n", "size", "copy ns", "first write ns");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet set = asCreate();
+        for (int i = 0; i < size; i++)
+        {
+            sprintf(key, "SKU-%08d", i);
+            asUpsertAmount(set, key, i, NULL);
+        }
+
+        long checksum = 0;
+        clock_t start = clock();
+        for (int i = 0; i < SNAPSHOTS; i++)
+        {
+            AmountSet snapshot = asCopy(set);
+            checksum += asGetSize(snapshot);
+            asDestroy(snapshot);
+        }
+        double copy = elapsedNs(start, clock(), SNAPSHOTS);
+
+        int writes = 2000000 / size;
+        start = clock();
+        for (int i = 0; i < writes; i++)
+        {
+            AmountSet snapshot = asCopy(set);
+            asChangeAmount(set, "SKU-00000000", 1);
+            checksum += asGetSize(snapshot);
+            asDestroy(snapshot);
+        }
+        double first_write = elapsedNs(start, clock(), writes);
+
+        printf("%10d %18.1f %18.1f   (checksum %ld)\n", size, copy, first_write, checksum);
+        asDestroy(set);
+    }
+
+    return 0;
+}
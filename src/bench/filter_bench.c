@@ -0,0 +1,91 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Lookup latency when most lookups miss.
+ *
+ * Runs asContains with a high share of missing elements, with and without a
+ * Bloom filter (asEnableFilter), on a changeable set and on the same set
+ * frozen, and reports the memory the filter takes.
+ */
+
+#define KEY_LENGTH 32
+#define LOOKUPS 1000000
+#define MISS_PERCENT 90
+#define FALSE_POSITIVE_RATE 0.01
+
+static double elapsedNs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+static void makeKey(char *key, int i, int size)
+{
+    // Missing keys share the prefix of present ones, they differ past the first characters
+    if (rand() % 100 < MISS_PERCENT)
+        sprintf(key, "SKU-%08d-X", rand() % size);
+    else
+        sprintf(key, "SKU-%08d", i);
+}
+
+static double lookups(AmountSet set, int size, long *found)
+{
+    char key[KEY_LENGTH];
+    srand(2);
+    *found = 0;
+    clock_t start = clock();
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        makeKey(key, rand() % size, size);
+        *found += asContains(set, key);
+    }
+    return elapsedNs(start, clock(), LOOKUPS);
+}
+
+int main()
+{
+    int sizes[] = {10000, 100000, 1000000};
+    char key[KEY_LENGTH];
+
+    printf("%d%% of lookups miss, filter false positive rate %.2f\n", MISS_PERCENT, FALSE_POSITIVE_RATE);
+    printf("%10s %8s %12s %12s %12s\n", "size", "frozen", "plain ns", "filtered ns", "filter MB");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet set = asCreate();
+        for (int i = 0; i < size; i++)
+        {
+            sprintf(key, "SKU-%08d", i);
+            asRegister(set, key);
+        }
+
+        for (int frozen = 0; frozen <= 1; frozen++)
+        {
+            if (frozen)
+                asFreeze(set);
+
+            AmountSetStats before;
+            AmountSetStats after;
+            long plain_found;
+            long filtered_found;
+            double plain = lookups(set, size, &plain_found);
+            asGetStats(set, &before);
+            asEnableFilter(set, FALSE_POSITIVE_RATE);
+            asGetStats(set, &after);
+            double filtered = lookups(set, size, &filtered_found);
+            asEnableFilter(set, 0);
+
+            if (plain_found != filtered_found)
+                printf("Filtered lookups found %ld elements instead of %ld\n", filtered_found, plain_found);
+
+            printf("%10d %8s %12.1f %12.1f %12.2f\n", size, frozen ? "yes" : "no", plain, filtered,
+                   (after.memory_bytes - before.memory_bytes) / 1e6);
+        }
+
+        asDestroy(set);
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Sorted feed replay versus random order.
+ *
+ * Registers and then deletes the same keys in ascending and in random order,
+ * and reports how many searches started from the finger.
+ */
+
+#define KEY_LENGTH 32
+
+static double elapsedNs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+static double replay(char (*keys)[KEY_LENGTH], int size, long *hits, long *misses)
+{
+    AmountSet set = asCreate();
+    clock_t start = clock();
+    for (int i = 0; i < size; i++)
+        asRegister(set, keys[i]);
+    for (int i = 0; i < size; i++)
+        asDelete(set, keys[i]);
+    double elapsed = elapsedNs(start, clock(), 2 * size);
+
+    asGetFingerStats(set, hits, misses);
+    asDestroy(set);
+    return elapsed;
+}
+
+int main()
+{
+    int sizes[] = {10000, 100000, 1000000};
+    srand(1);
+
+    printf("%10s %16s %12s %16s %12s\n", "size", "sorted ns/op", "hit rate", "random ns/op", "hit rate");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        char (*keys)[KEY_LENGTH] = malloc(size * sizeof(*keys));
+        for (int i = 0; i < size; i++)
+            sprintf(keys[i], "WH01-AISLE07-BIN-%08d", i);
+
+        long hits, misses;
+        double sorted = replay(keys, size, &hits, &misses);
+        double sorted_rate = (double)hits / (hits + misses);
+
+        for (int i = size - 1; i > 0; i--)
+        {
+            int other = rand() % (i + 1);
+            char temporary[KEY_LENGTH];
+            sprintf(temporary, "%s", keys[i]);
+            sprintf(keys[i], "%s", keys[other]);
+            sprintf(keys[other], "%s", temporary);
+        }
+
+        double random = replay(keys, size, &hits, &misses);
+        printf("%10d %16.1f %12.3f %16.1f %12.3f\n", size, sorted, sorted_rate, random,
+               (double)hits / (hits + misses));
+        free(keys);
+    }
+
+    return 0;
+}
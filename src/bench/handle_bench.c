@@ -0,0 +1,70 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Repeated amount changes of a few hot elements.
+ *
+ * Compares asChangeAmount, which hashes and searches for the element on every
+ * call, with asHandleChangeAmount through handles found once.
+ */
+
+#define KEY_LENGTH 64
+#define HOT_ELEMENTS 16
+#define CHANGES 5000000
+
+static double elapsedNs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+int main()
+{
+    int sizes[] = {1000, 100000};
+    char key[KEY_LENGTH];
+    char hot_keys[HOT_ELEMENTS][KEY_LENGTH];
+
+    printf("%10s %18s %18s\n", "size", "by element ns", "by handle ns");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet set = asCreate();
+        for (int i = 0; i < size; i++)
+        {
+            // Long elements sharing a prefix, like catalogue paths
+            sprintf(key, "warehouse/north/aisle-%04d/shelf-%06d", i % 100, i);
+            asRegister(set, key);
+        }
+
+        AmountSetHandle handles[HOT_ELEMENTS];
+        for (int i = 0; i < HOT_ELEMENTS; i++)
+        {
+            int hot = i * (size / HOT_ELEMENTS);
+            sprintf(hot_keys[i], "warehouse/north/aisle-%04d/shelf-%06d", hot % 100, hot);
+            handles[i] = asFindHandle(set, hot_keys[i]);
+        }
+
+        clock_t start = clock();
+        for (int i = 0; i < CHANGES; i++)
+            asChangeAmount(set, hot_keys[i % HOT_ELEMENTS], 1);
+        double by_element = elapsedNs(start, clock(), CHANGES);
+
+        start = clock();
+        for (int i = 0; i < CHANGES; i++)
+            asHandleChangeAmount(handles[i % HOT_ELEMENTS], 1);
+        double by_handle = elapsedNs(start, clock(), CHANGES);
+
+        double checksum = 0;
+        for (int i = 0; i < HOT_ELEMENTS; i++)
+        {
+            double amount;
+            asHandleGetAmount(handles[i], &amount);
+            checksum += amount;
+        }
+
+        printf("%10d %18.1f %18.1f   (checksum %.0f)\n", size, by_element, by_handle, checksum);
+        asDestroy(set);
+    }
+
+    return 0;
+}
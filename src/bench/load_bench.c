@@ -0,0 +1,81 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Bulk loading time versus set size.
+ *
+ * Compares registering keys one by one in random order (the skip list keeps
+ * the cost per key logarithmic, where the sorted list grew linearly) with
+ * asCreateFromArrays on the same keys, sorted and unsorted.
+ */
+
+#define KEY_LENGTH 32
+
+static void shuffle(int *values, int count)
+{
+    for (int i = count - 1; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        int temp = values[i];
+        values[i] = values[j];
+        values[j] = temp;
+    }
+}
+
+static double secondsSince(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+    int sizes[] = {50000, 100000, 200000, 400000};
+    srand(1);
+
+    printf("%10s %16s %16s %16s\n", "size", "register ns/key", "sorted ns/key", "unsorted ns/key");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        int *order = malloc(size * sizeof(*order));
+        char *storage = malloc(size * KEY_LENGTH);
+        const char **sorted_keys = malloc(size * sizeof(*sorted_keys));
+        const char **shuffled_keys = malloc(size * sizeof(*shuffled_keys));
+        for (int i = 0; i < size; i++)
+        {
+            order[i] = i;
+            sprintf(storage + i * KEY_LENGTH, "WH01-AISLE%02d-BIN%08d", i * 64 / size, i);
+            sorted_keys[i] = storage + i * KEY_LENGTH;
+        }
+        shuffle(order, size);
+        for (int i = 0; i < size; i++)
+            shuffled_keys[i] = sorted_keys[order[i]];
+
+        AmountSet set = asCreate();
+        clock_t start = clock();
+        for (int i = 0; i < size; i++)
+            asRegister(set, shuffled_keys[i]);
+        double registered = secondsSince(start);
+        asDestroy(set);
+
+        start = clock();
+        asCreateFromArrays(sorted_keys, NULL, size, &set);
+        double sorted = secondsSince(start);
+        asDestroy(set);
+
+        start = clock();
+        asCreateFromArrays(shuffled_keys, NULL, size, &set);
+        double unsorted = secondsSince(start);
+
+        printf("%10d %16.1f %16.1f %16.1f\n", asGetSize(set), registered * 1e9 / size,
+               sorted * 1e9 / size, unsorted * 1e9 / size);
+        asDestroy(set);
+        free(order);
+        free(storage);
+        free(sorted_keys);
+        free(shuffled_keys);
+    }
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Lookup latency versus set size.
+ *
+ * Compares asGetAmount (hash index) with a linear scan of the sorted chain
+ * through asGetFirst/asGetNext and strcmp, which is what every point
+ * operation cost before the index was added.
+ */
+
+#define KEY_LENGTH 32
+#define LOOKUPS 200000
+#define LINEAR_LOOKUPS 2000
+
+static double elapsedNs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+static void makeKey(char *key, int i)
+{
+    sprintf(key, "SKU-%08d", i);
+}
+
+static double linearGetAmount(AmountSet set, const char *element)
+{
+    double amount = -1;
+    AS_FOREACH(char *, current, set)
+    {
+        int compare_result = strcmp(current, element);
+        if (compare_result == 0)
+        {
+            asGetAmount(set, current, &amount);
+            break;
+        }
+        if (compare_result > 0)
+            break;
+    }
+    return amount;
+}
+
+int main()
+{
+    int sizes[] = {1000, 10000, 100000};
+    char key[KEY_LENGTH];
+    srand(1);
+
+    printf("%10s %18s %18s\n", "size", "index ns/lookup", "linear ns/lookup");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet set = asCreate();
+        // Descending order keeps the reference list insertion cheap
+        for (int i = size - 1; i >= 0; i--)
+        {
+            makeKey(key, i);
+            asRegister(set, key);
+            asChangeAmount(set, key, i);
+        }
+
+        double checksum = 0;
+        clock_t start = clock();
+        for (int i = 0; i < LOOKUPS; i++)
+        {
+            double amount;
+            makeKey(key, rand() % size);
+            asGetAmount(set, key, &amount);
+            checksum += amount;
+        }
+        double indexed = elapsedNs(start, clock(), LOOKUPS);
+
+        start = clock();
+        for (int i = 0; i < LINEAR_LOOKUPS; i++)
+        {
+            makeKey(key, rand() % size);
+            checksum += linearGetAmount(set, key);
+        }
+        double linear = elapsedNs(start, clock(), LINEAR_LOOKUPS);
+
+        printf("%10d %18.1f %18.1f   (checksum %.0f)\n", size, indexed, linear, checksum);
+        asDestroy(set);
+    }
+
+    return 0;
+}
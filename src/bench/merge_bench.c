@@ -0,0 +1,73 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Reconciling two stock snapshots versus set size.
+ *
+ * Compares asMerge with summing the second snapshot into a copy of the first
+ * element by element through asUpsertAmount.
+ */
+
+#define KEY_LENGTH 32
+#define ROUNDS 10
+
+static double elapsedMs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e3 / operations;
+}
+
+int main()
+{
+    int sizes[] = {10000, 100000, 400000};
+    char key[KEY_LENGTH];
+
+    printf("%10s %18s %18s\n", "size", "merge ms", "upsert ms");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet first = asCreate();
+        AmountSet second = asCreate();
+        // Half of the elements are in both snapshots
+        for (int i = 0; i < size; i++)
+        {
+            sprintf(key, "SKU-%08d", i);
+            asUpsertAmount(first, key, 1, NULL);
+            sprintf(key, "SKU-%08d", i + size / 2);
+            asUpsertAmount(second, key, 2, NULL);
+        }
+
+        double checksum = 0;
+        clock_t start = clock();
+        for (int i = 0; i < ROUNDS; i++)
+        {
+            AmountSet merged;
+            asMerge(first, second, asCombineSum, &merged);
+            checksum += asGetSize(merged);
+            asDestroy(merged);
+        }
+        double merge = elapsedMs(start, clock(), ROUNDS);
+
+        start = clock();
+        for (int i = 0; i < ROUNDS; i++)
+        {
+            AmountSet merged = asCopy(first);
+            AmountSetIterator iterator;
+            AS_FOREACH_ITERATOR(char *, element, iterator, second)
+            {
+                double amount;
+                asIteratorGetAmount(&iterator, &amount);
+                asUpsertAmount(merged, element, amount, NULL);
+            }
+            checksum += asGetSize(merged);
+            asDestroy(merged);
+        }
+        double upsert = elapsedMs(start, clock(), ROUNDS);
+
+        printf("%10d %18.1f %18.1f   (checksum %.0f)\n", size, merge, upsert, checksum);
+        asDestroy(first);
+        asDestroy(second);
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Bulk construction and copying time versus the number of threads.
+ *
+ * Builds a set from unsorted arrays with asCreateFromArraysParallel, and
+ * copies a mapped snapshot of it into memory with asCopyParallel, timing both
+ * by wall clock for each number of threads.
+ */
+
+#define SET_SIZE 1000000
+#define KEY_LENGTH 32
+#define ROUNDS 3
+#define SNAPSHOT_PATH "parallel_bench.snapshot"
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+int main()
+{
+    int thread_counts[] = {1, 2, 4, 8, 16};
+    char *keys = malloc((size_t)SET_SIZE * KEY_LENGTH);
+    const char **elements = malloc(SET_SIZE * sizeof(*elements));
+    double *amounts = malloc(SET_SIZE * sizeof(*amounts));
+    if (!keys || !elements || !amounts)
+        return 1;
+
+    srand(1);
+    for (int i = 0; i < SET_SIZE; i++)
+    {
+        char *key = keys + (size_t)i * KEY_LENGTH;
+        snprintf(key, KEY_LENGTH, "item%08d-%d", rand() % 100000000, i);
+        elements[i] = key;
+        amounts[i] = rand() % 1000;
+    }
+
+    AmountSet set = NULL;
+    AmountSet mapped = NULL;
+    if (asCreateFromArrays(elements, amounts, SET_SIZE, &set) != AS_SUCCESS ||
+        asSaveBinary(set, SNAPSHOT_PATH) != AS_SUCCESS || asOpenMapped(SNAPSHOT_PATH, &mapped) != AS_SUCCESS)
+        return 1;
+
+    asDestroy(set);
+    printf("%8s %14s %14s\n", "threads", "create ms", "copy ms");
+    for (unsigned int t = 0; t < sizeof(thread_counts) / sizeof(*thread_counts); t++)
+    {
+        int threads = thread_counts[t];
+        double create_time = 0;
+        double copy_time = 0;
+        for (int round = 0; round < ROUNDS; round++)
+        {
+            double start = now();
+            AmountSet created = NULL;
+            asCreateFromArraysParallel(elements, amounts, SET_SIZE, threads, &created);
+            create_time += now() - start;
+
+            start = now();
+            AmountSet copy = asCopyParallel(mapped, threads);
+            copy_time += now() - start;
+
+            if (!created || !copy)
+                return 1;
+
+            asDestroy(created);
+            asDestroy(copy);
+        }
+
+        printf("%8d %14.1f %14.1f\n", threads, create_time * 1e3 / ROUNDS, copy_time * 1e3 / ROUNDS);
+    }
+
+    asDestroy(mapped);
+    remove(SNAPSHOT_PATH);
+    free(keys);
+    free(elements);
+    free(amounts);
+    return 0;
+}
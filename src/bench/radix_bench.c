@@ -0,0 +1,101 @@
+#include "../amount_set_str.h"
+#include "../amount_set_str_radix.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Memory per element and lookup latency for warehouse SKUs sharing long prefixes.
+ *
+ * Compares the regular set (skip list nodes with a full copy of every
+ * element, and the same set frozen into arrays) with the radix set, which
+ * keeps shared prefixes once.
+ */
+
+#define KEY_LENGTH 64
+#define LOOKUPS 1000000
+
+static double elapsedNs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+static void makeKey(char *key, int i)
+{
+    sprintf(key, "WH%02d-AISLE%02d-BIN%04d-SKU%06d", i % 4, i / 4 % 24, i / 96 % 2000, i);
+}
+
+static double lookupSet(AmountSet set, int size)
+{
+    char key[KEY_LENGTH];
+    double checksum = 0;
+    srand(3);
+    clock_t start = clock();
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        double amount = 0;
+        makeKey(key, rand() % size);
+        asGetAmount(set, key, &amount);
+        checksum += amount;
+    }
+    double result = elapsedNs(start, clock(), LOOKUPS);
+    return checksum == LOOKUPS ? result : -result;
+}
+
+static double lookupRadix(AmountSetRadix set, int size)
+{
+    char key[KEY_LENGTH];
+    double checksum = 0;
+    srand(3);
+    clock_t start = clock();
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        double amount = 0;
+        makeKey(key, rand() % size);
+        asRadixGetAmount(set, key, &amount);
+        checksum += amount;
+    }
+    double result = elapsedNs(start, clock(), LOOKUPS);
+    return checksum == LOOKUPS ? result : -result;
+}
+
+int main()
+{
+    int sizes[] = {10000, 100000, 1000000};
+    char key[KEY_LENGTH];
+    makeKey(key, 123456);
+    printf("Elements like %s\n", key);
+    printf("%10s %14s %14s %14s %12s %12s %12s\n", "size", "nodes B/key", "frozen B/key", "radix B/key",
+           "nodes ns", "frozen ns", "radix ns");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet set = asCreate();
+        AmountSetRadix radix = asRadixCreate();
+        for (int i = 0; i < size; i++)
+        {
+            makeKey(key, i);
+            asUpsertAmount(set, key, 1, NULL);
+            asRadixRegister(radix, key);
+            asRadixChangeAmount(radix, key, 1);
+        }
+
+        AmountSetStats stats;
+        asGetStats(set, &stats);
+        double nodes_bytes = (double)stats.memory_bytes / size;
+        double nodes_ns = lookupSet(set, size);
+        asFreeze(set);
+        asGetStats(set, &stats);
+        double frozen_bytes = (double)stats.memory_bytes / size;
+        double frozen_ns = lookupSet(set, size);
+        double radix_bytes = (double)asRadixGetMemory(radix) / size;
+        double radix_ns = lookupRadix(radix, size);
+
+        printf("%10d %14.1f %14.1f %14.1f %12.1f %12.1f %12.1f\n", size, nodes_bytes, frozen_bytes, radix_bytes,
+               nodes_ns, frozen_ns, radix_ns);
+        asRadixDestroy(radix);
+        asDestroy(set);
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Aggregate scan cost of a changeable set versus a frozen one.
+ *
+ * Runs asSumAmounts and asCountBelow over both representations of the same
+ * elements, and reports the cost of freezing.
+ */
+
+#define KEY_LENGTH 32
+#define SCANNED_ELEMENTS 20000000
+
+static double elapsedNs(clock_t start, clock_t end, long operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+static void scan(AmountSet set, int rounds, double *sum_ns, double *count_ns, double *checksum)
+{
+    clock_t start = clock();
+    for (int i = 0; i < rounds; i++)
+        *checksum += asSumAmounts(set);
+    *sum_ns = elapsedNs(start, clock(), (long)rounds * asGetSize(set));
+
+    start = clock();
+    for (int i = 0; i < rounds; i++)
+        *checksum += asCountBelow(set, 500);
+    *count_ns = elapsedNs(start, clock(), (long)rounds * asGetSize(set));
+}
+
+int main()
+{
+    int sizes[] = {10000, 100000, 1000000};
+    char key[KEY_LENGTH];
+    srand(1);
+
+    printf("%10s %12s %12s %12s %12s %12s\n", "size", "sum ns/el", "frozen", "below ns/el", "frozen",
+           "freeze ms");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet set = asCreate();
+        for (int i = 0; i < size; i++)
+        {
+            sprintf(key, "SKU-%08d", rand());
+            asUpsertAmount(set, key, rand() % 1000, NULL);
+        }
+
+        int rounds = SCANNED_ELEMENTS / size;
+        double sum_ns, count_ns, frozen_sum_ns, frozen_count_ns, checksum = 0;
+        scan(set, rounds, &sum_ns, &count_ns, &checksum);
+
+        clock_t start = clock();
+        asFreeze(set);
+        double freeze = elapsedNs(start, clock(), 1) / 1e6;
+        scan(set, rounds, &frozen_sum_ns, &frozen_count_ns, &checksum);
+
+        printf("%10d %12.2f %12.2f %12.2f %12.2f %12.1f   (checksum %.0f)\n", size, sum_ns, frozen_sum_ns,
+               count_ns, frozen_count_ns, freeze, checksum);
+        asDestroy(set);
+    }
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../amount_set_str_concurrent.h"
+#include "../amount_set_str_sharded.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Write throughput under contention versus the number of writer threads.
+ *
+ * Every writer changes amounts of, and registers/deletes, keys of its own for
+ * a fixed wall clock duration, on the concurrent set (a single writer lock)
+ * and on sharded sets of 16 and 64 shards.
+ */
+
+#define SET_SIZE 100000
+#define KEY_LENGTH 32
+#define DURATION_SECONDS 1.0
+#define MAX_WRITERS 16
+
+typedef struct Worker_t
+{
+    AmountSetConcurrent concurrent; // NULL when writing to the sharded set
+    AmountSetSharded sharded;
+    int id;
+    int done;
+    unsigned int seed;
+    unsigned long operations;
+} Worker;
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static unsigned int nextRandom(unsigned int *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void *writeLoop(void *argument)
+{
+    Worker *worker = argument;
+    char key[KEY_LENGTH];
+    while (!__atomic_load_n(&worker->done, __ATOMIC_RELAXED))
+    {
+        // Writers take disjoint keys, so that they only contend for locks
+        unsigned int i = nextRandom(&worker->seed) % (SET_SIZE / MAX_WRITERS) * MAX_WRITERS + worker->id;
+        sprintf(key, "SKU-%08u", i);
+        if (worker->concurrent)
+        {
+            asConcurrentChangeAmount(worker->concurrent, key, 1);
+            sprintf(key, "NEW-%08u", i);
+            if (asConcurrentRegister(worker->concurrent, key) == AS_ITEM_ALREADY_EXISTS)
+                asConcurrentDelete(worker->concurrent, key);
+        }
+        else
+        {
+            asShardedChangeAmount(worker->sharded, key, 1);
+            sprintf(key, "NEW-%08u", i);
+            if (asShardedRegister(worker->sharded, key) == AS_ITEM_ALREADY_EXISTS)
+                asShardedDelete(worker->sharded, key);
+        }
+        worker->operations++;
+    }
+
+    return NULL;
+}
+
+static double measure(AmountSetConcurrent concurrent, AmountSetSharded sharded, int writers)
+{
+    pthread_t threads[MAX_WRITERS];
+    Worker workers[MAX_WRITERS];
+    for (int i = 0; i < writers; i++)
+    {
+        workers[i].concurrent = concurrent;
+        workers[i].sharded = sharded;
+        workers[i].id = i;
+        workers[i].done = 0;
+        workers[i].seed = 2463534242u + i;
+        workers[i].operations = 0;
+    }
+
+    double start = now();
+    for (int i = 0; i < writers; i++)
+        pthread_create(&threads[i], NULL, writeLoop, &workers[i]);
+
+    struct timespec duration = {(time_t)DURATION_SECONDS, 0};
+    nanosleep(&duration, NULL);
+
+    unsigned long operations = 0;
+    for (int i = 0; i < writers; i++)
+    {
+        __atomic_store_n(&workers[i].done, 1, __ATOMIC_RELAXED);
+        pthread_join(threads[i], NULL);
+        operations += workers[i].operations;
+    }
+
+    return operations / (now() - start);
+}
+
+int main()
+{
+    int writer_counts[] = {1, 4, 16};
+    AmountSetConcurrent concurrent = asConcurrentCreate();
+    AmountSetSharded sharded16 = asShardedCreate(16);
+    AmountSetSharded sharded64 = asShardedCreate(64);
+    if (!concurrent || !sharded16 || !sharded64)
+        return 1;
+
+    char key[KEY_LENGTH];
+    for (int i = 0; i < SET_SIZE; i++)
+    {
+        sprintf(key, "SKU-%08d", i);
+        asConcurrentRegister(concurrent, key);
+        asShardedRegister(sharded16, key);
+        asShardedRegister(sharded64, key);
+    }
+
+    printf("%8s %16s %16s %16s\n", "writers", "single lock/s", "16 shards/s", "64 shards/s");
+    for (unsigned int w = 0; w < sizeof(writer_counts) / sizeof(*writer_counts); w++)
+    {
+        int writers = writer_counts[w];
+        double single = measure(concurrent, NULL, writers);
+        double shards16 = measure(NULL, sharded16, writers);
+        double shards64 = measure(NULL, sharded64, writers);
+        printf("%8d %16.0f %16.0f %16.0f\n", writers, single, shards16, shards64);
+    }
+
+    asConcurrentDestroy(concurrent);
+    asShardedDestroy(sharded16);
+    asShardedDestroy(sharded64);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Many tiny sets, as kept per order.
+ *
+ * Fills SETS sets with a few elements each, then looks up and changes every
+ * element, and reports the memory held per set (from asGetStats) and the time
+ * per operation.
+ */
+
+#define SETS 100000
+#define KEY_LENGTH 32
+
+static double elapsedNs(clock_t start, clock_t end, long operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e9 / operations;
+}
+
+int main()
+{
+    int sizes[] = {1, 4, 8, 16, 32};
+    char key[KEY_LENGTH];
+    AmountSet *sets = malloc(SETS * sizeof(*sets));
+
+    printf("%6s %14s %14s %14s\n", "size", "bytes/set", "fill ns/op", "update ns/op");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        clock_t start = clock();
+        for (int i = 0; i < SETS; i++)
+        {
+            sets[i] = asCreate();
+            for (int j = 0; j < size; j++)
+            {
+                sprintf(key, "SKU-%06d", (j * 7919 + i) % 1000000);
+                asRegister(sets[i], key);
+            }
+        }
+        double fill = elapsedNs(start, clock(), (long)SETS * size);
+
+        start = clock();
+        double checksum = 0;
+        for (int i = 0; i < SETS; i++)
+        {
+            for (int j = 0; j < size; j++)
+            {
+                double amount = 0;
+                sprintf(key, "SKU-%06d", (j * 7919 + i) % 1000000);
+                asChangeAmount(sets[i], key, j);
+                asGetAmount(sets[i], key, &amount);
+                checksum += amount;
+            }
+        }
+        double update = elapsedNs(start, clock(), 2L * SETS * size);
+
+        size_t memory = 0;
+        for (int i = 0; i < SETS; i++)
+        {
+            AmountSetStats stats;
+            asGetStats(sets[i], &stats);
+            memory += stats.memory_bytes;
+            asDestroy(sets[i]);
+        }
+
+        printf("%6d %14.0f %14.1f %14.1f   (checksum %.0f)\n", size, (double)memory / SETS, fill, update, checksum);
+    }
+
+    free(sets);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Cold start from a snapshot versus rebuilding the set.
+ *
+ * Saves a set with asSaveBinary, then compares asOpenMapped followed by a
+ * lookup pass with rebuilding the set from arrays (what a loader of a text
+ * dump would do) followed by the same lookups.
+ */
+
+#define KEY_LENGTH 32
+#define LOOKUPS 100000
+#define SNAPSHOT_PATH "snapshot_bench.bin"
+
+static double elapsedMs(clock_t start, clock_t end)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e3;
+}
+
+static double lookups(AmountSet set, char (*keys)[KEY_LENGTH], int size)
+{
+    double checksum = 0;
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        double amount = 0;
+        asGetAmount(set, keys[rand() % size], &amount);
+        checksum += amount;
+    }
+    return checksum;
+}
+
+int main()
+{
+    int sizes[] = {10000, 100000, 1000000};
+    srand(1);
+
+    printf("%10s %14s %14s %14s\n", "size", "save ms", "open+get ms", "build+get ms");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        char (*keys)[KEY_LENGTH] = malloc(sizeof(*keys) * size);
+        const char **elements = malloc(sizeof(*elements) * size);
+        double *amounts = malloc(sizeof(*amounts) * size);
+        for (int i = 0; i < size; i++)
+        {
+            sprintf(keys[i], "SKU-%08d", i);
+            elements[i] = keys[i];
+            amounts[i] = rand() % 1000;
+        }
+
+        AmountSet set = NULL;
+        asCreateFromArrays(elements, amounts, size, &set);
+        clock_t start = clock();
+        asSaveBinary(set, SNAPSHOT_PATH);
+        double save = elapsedMs(start, clock());
+        asDestroy(set);
+
+        AmountSet mapped = NULL;
+        start = clock();
+        asOpenMapped(SNAPSHOT_PATH, &mapped);
+        double checksum = lookups(mapped, keys, size);
+        double open = elapsedMs(start, clock());
+        asDestroy(mapped);
+
+        AmountSet rebuilt = NULL;
+        start = clock();
+        asCreateFromArrays(elements, amounts, size, &rebuilt);
+        checksum += lookups(rebuilt, keys, size);
+        double build = elapsedMs(start, clock());
+        asDestroy(rebuilt);
+
+        printf("%10d %14.1f %14.1f %14.1f   (checksum %.0f)\n", size, save, open, build, checksum);
+        remove(SNAPSHOT_PATH);
+        free(keys);
+        free(elements);
+        free(amounts);
+    }
+
+    return 0;
+}
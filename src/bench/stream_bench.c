@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Text import/export throughput.
+ *
+ * Dumps a set of "element amount" lines with asDumpStream and with a
+ * fprintf loop, then loads the sorted dump and a shuffled copy of it with
+ * asLoadStream and with a fscanf/asUpsertAmount loop, in MB/s of text.
+ */
+
+#define SET_SIZE 1000000
+#define KEY_LENGTH 32
+#define SORTED_PATH "stream_bench_sorted.txt"
+#define SHUFFLED_PATH "stream_bench_shuffled.txt"
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static long fileSize(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static double dumpPrintf(AmountSet set, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    double start = now();
+    AS_FOREACH(char *, element, set)
+    {
+        double amount;
+        asGetAmount(set, element, &amount);
+        fprintf(file, "%s %.17g\n", element, amount);
+    }
+    fclose(file);
+    return now() - start;
+}
+
+static double dumpStream(AmountSet set, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    double start = now();
+    asDumpStream(set, file);
+    fclose(file);
+    return now() - start;
+}
+
+static double loadScanf(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    AmountSet set = asCreate();
+    char key[KEY_LENGTH];
+    double amount;
+    double start = now();
+    while (fscanf(file, "%31s %lf", key, &amount) == 2)
+        asUpsertAmount(set, key, amount, NULL);
+    double elapsed = now() - start;
+    fclose(file);
+    asDestroy(set);
+    return elapsed;
+}
+
+static double loadStream(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    AmountSet set = asCreate();
+    double start = now();
+    asLoadStream(set, file);
+    double elapsed = now() - start;
+    fclose(file);
+    asDestroy(set);
+    return elapsed;
+}
+
+int main()
+{
+    char **keys = malloc(SET_SIZE * sizeof(*keys));
+    double *amounts = malloc(SET_SIZE * sizeof(*amounts));
+    if (!keys || !amounts)
+        return 1;
+
+    srand(1);
+    for (int i = 0; i < SET_SIZE; i++)
+    {
+        keys[i] = malloc(KEY_LENGTH);
+        snprintf(keys[i], KEY_LENGTH, "WH%02d-SKU-%08d", rand() % 100, i);
+        amounts[i] = rand() % 4 == 0 ? (rand() % 100000) * 0.01 : rand() % 10000;
+    }
+
+    AmountSet set = NULL;
+    if (asCreateFromArrays((const char *const *)keys, amounts, SET_SIZE, &set) != AS_SUCCESS)
+        return 1;
+
+    double printf_time = dumpPrintf(set, SORTED_PATH);
+    double dump_time = dumpStream(set, SORTED_PATH);
+    double megabytes = fileSize(SORTED_PATH) / 1e6;
+
+    // The same lines in random order
+    FILE *shuffled = fopen(SHUFFLED_PATH, "w");
+    for (int i = SET_SIZE - 1; i >= 0; i--)
+    {
+        int j = rand() % (i + 1);
+        char *key = keys[i];
+        keys[i] = keys[j];
+        keys[j] = key;
+        double amount;
+        asGetAmount(set, keys[i], &amount);
+        fprintf(shuffled, "%s %.17g\n", keys[i], amount);
+    }
+    fclose(shuffled);
+
+    printf("%d lines, %.1f MB\n", SET_SIZE, megabytes);
+    printf("%-24s %12s %12s\n", "", "fprintf/scanf", "stream");
+    printf("%-24s %12.1f %12.1f\n", "dump MB/s", megabytes / printf_time, megabytes / dump_time);
+    printf("%-24s %12.1f %12.1f\n", "load sorted MB/s", megabytes / loadScanf(SORTED_PATH),
+           megabytes / loadStream(SORTED_PATH));
+    printf("%-24s %12.1f %12.1f\n", "load shuffled MB/s", megabytes / loadScanf(SHUFFLED_PATH),
+           megabytes / loadStream(SHUFFLED_PATH));
+
+    remove(SORTED_PATH);
+    remove(SHUFFLED_PATH);
+    asDestroy(set);
+    for (int i = 0; i < SET_SIZE; i++)
+        free(keys[i]);
+    free(keys);
+    free(amounts);
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "../amount_set_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Top-50 query latency versus set size.
+ *
+ * Compares asTopK with collecting every amount through an iterator and
+ * sorting, and reports the cost of asChangeAmount which keeps the amount
+ * order up to date.
+ */
+
+#define KEY_LENGTH 32
+#define TOP 50
+#define QUERIES 1000
+#define SCAN_QUERIES 10
+#define CHANGES 200000
+
+typedef struct
+{
+    const char *element;
+    double amount;
+} Entry;
+
+static double elapsedUs(clock_t start, clock_t end, int operations)
+{
+    return (double)(end - start) / CLOCKS_PER_SEC * 1e6 / operations;
+}
+
+static int compareEntries(const void *first, const void *second)
+{
+    double difference = ((const Entry *)second)->amount - ((const Entry *)first)->amount;
+    return (difference > 0) - (difference < 0);
+}
+
+int main()
+{
+    int sizes[] = {10000, 100000, 1000000};
+    char key[KEY_LENGTH];
+    const char *top[TOP];
+    srand(1);
+
+    printf("%10s %14s %14s %16s\n", "size", "topk us", "scan us", "change us");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+    {
+        int size = sizes[s];
+        AmountSet set = asCreate();
+        for (int i = 0; i < size; i++)
+        {
+            sprintf(key, "SKU-%08d", i);
+            asUpsertAmount(set, key, rand() % 1000, NULL);
+        }
+
+        long checksum = 0;
+        clock_t start = clock();
+        for (int i = 0; i < QUERIES; i++)
+            checksum += asTopK(set, TOP, top, NULL);
+        double topk = elapsedUs(start, clock(), QUERIES);
+
+        Entry *entries = malloc(size * sizeof(*entries));
+        start = clock();
+        for (int i = 0; i < SCAN_QUERIES; i++)
+        {
+            int count = 0;
+            AmountSetIterator iterator;
+            AS_FOREACH_ITERATOR(char *, element, iterator, set)
+            {
+                entries[count].element = element;
+                asIteratorGetAmount(&iterator, &entries[count].amount);
+                count++;
+            }
+            qsort(entries, count, sizeof(*entries), compareEntries);
+            checksum += count;
+        }
+        double scan = elapsedUs(start, clock(), SCAN_QUERIES);
+        free(entries);
+
+        start = clock();
+        for (int i = 0; i < CHANGES; i++)
+        {
+            sprintf(key, "SKU-%08d", rand() % size);
+            checksum += asChangeAmount(set, key, (rand() % 3) - 1);
+        }
+        double change = elapsedUs(start, clock(), CHANGES);
+
+        printf("%10d %14.2f %14.1f %16.3f   (checksum %ld)\n", size, topk, scan, change, checksum);
+        asDestroy(set);
+    }
+
+    return 0;
+}